@@ -0,0 +1,517 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <string.h>
+
+#include "Framer.h"
+
+using namespace std;
+
+#define dSizeBufRecvMin			1024
+#define dLenVarintMax			10
+
+static bool formatOk(const FrameFormat &fmt)
+{
+	if (fmt.mode == FrameLenFixed &&
+			fmt.lenPrefix != 1 && fmt.lenPrefix != 2 &&
+			fmt.lenPrefix != 4 && fmt.lenPrefix != 8)
+	{
+		errLog(-1, "invalid length prefix size: %u", (unsigned)fmt.lenPrefix);
+		return false;
+	}
+
+	if (fmt.mode == FrameDelimiter && !fmt.delimiter.size())
+	{
+		errLog(-1, "delimiter not set");
+		return false;
+	}
+
+	if (fmt.mode == FrameSizeFixed && !fmt.sizeFixed)
+	{
+		errLog(-1, "frame size not set");
+		return false;
+	}
+
+	return true;
+}
+
+// Framer
+
+Framer::Framer()
+	: mFmt()
+	, mpTrans(NULL)
+	, mBufSend()
+	, mIdxSend(0)
+{
+}
+
+void Framer::formatSet(const FrameFormat &fmt)
+{
+	mFmt = fmt;
+}
+
+void Framer::transferSet(Transfering *pTrans)
+{
+	mpTrans = pTrans;
+	mBufSend.clear();
+	mIdxSend = 0;
+}
+
+/*
+ * Appends the frame of the payload to buf
+ */
+bool Framer::frameCreate(const void *pData, size_t len, VecByte &buf) const
+{
+	if (!formatOk(mFmt))
+		return false;
+
+	if (len && !pData)
+		return false;
+
+	if (len > mFmt.sizeMax)
+		return false;
+
+	const uint8_t *pPayload = (const uint8_t *)pData;
+	uint64_t lenPayload = len;
+	size_t i;
+
+	if (mFmt.mode == FrameLenFixed)
+	{
+		if (mFmt.lenPrefix < 8 && lenPayload >> (8 * mFmt.lenPrefix))
+			return false;
+
+		for (i = 0; i < mFmt.lenPrefix; ++i)
+		{
+			if (mFmt.bigEndian)
+				buf.push_back((uint8_t)(lenPayload >> (8 * (mFmt.lenPrefix - 1 - i))));
+			else
+				buf.push_back((uint8_t)(lenPayload >> (8 * i)));
+		}
+	}
+	else
+	if (mFmt.mode == FrameLenVarint)
+	{
+		while (lenPayload >= 0x80)
+		{
+			buf.push_back((uint8_t)(lenPayload | 0x80));
+			lenPayload >>= 7;
+		}
+
+		buf.push_back((uint8_t)lenPayload);
+	}
+	else
+	if (mFmt.mode == FrameDelimiter)
+	{
+		const uint8_t *pDelim = (const uint8_t *)mFmt.delimiter.data();
+		const uint8_t *pEnd = pPayload + len;
+
+		// Payload would be split by the receiver
+		if (search(pPayload, pEnd, pDelim, pDelim + mFmt.delimiter.size()) != pEnd)
+			return false;
+	}
+	else
+	if (len != mFmt.sizeFixed)
+		return false;
+
+	buf.insert(buf.end(), pPayload, pPayload + len);
+
+	if (mFmt.mode == FrameDelimiter)
+		buf.insert(buf.end(), mFmt.delimiter.begin(), mFmt.delimiter.end());
+
+	return true;
+}
+
+Success Framer::frameSend(const void *pData, size_t len)
+{
+	if (!mpTrans)
+		return errLog(-1, "transfer not set");
+
+	Success success = flush();
+	if (success != Positive)
+		return success;
+
+	if (!frameCreate(pData, len, mBufSend))
+		return errLog(-2, "payload does not match frame format");
+
+	success = flush();
+	if (success < 0)
+		return success;
+
+	return Positive;
+}
+
+Success Framer::flush()
+{
+	if (!mpTrans)
+		return errLog(-1, "transfer not set");
+
+	ssize_t res;
+
+	while (mIdxSend < mBufSend.size())
+	{
+		res = mpTrans->send(&mBufSend[mIdxSend], mBufSend.size() - mIdxSend);
+		if (!res)
+			return Pending;
+
+		// Reported by the transfer already
+		if (res < 0)
+			return -3;
+
+		mIdxSend += res;
+	}
+
+	mBufSend.clear();
+	mIdxSend = 0;
+
+	return Positive;
+}
+
+// Deframer
+
+Deframer::Deframer()
+	: mFmt()
+	, mpTrans(NULL)
+	, mLenNeed(0)
+	, mLenFrameDone(0)
+	, mIdxSearch(0)
+	, mBufRecv()
+	, mIdxRecvStart(0)
+	, mIdxRecvEnd(0)
+{
+	stateReset();
+}
+
+void Deframer::formatSet(const FrameFormat &fmt)
+{
+	mFmt = fmt;
+	stateReset();
+}
+
+void Deframer::transferSet(Transfering *pTrans)
+{
+	mpTrans = pTrans;
+
+	mBufRecv.clear();
+	mIdxRecvStart = 0;
+	mIdxRecvEnd = 0;
+
+	stateReset();
+}
+
+Success Deframer::frameGet(const uint8_t *&pFrame, size_t &lenFrame)
+{
+	pFrame = NULL;
+	lenFrame = 0;
+
+	if (!mpTrans)
+		return errLog(-1, "transfer not set");
+
+	if (!formatOk(mFmt))
+		return -2;
+
+	const uint8_t *pData;
+	size_t lenNeed = mLenNeed;
+	size_t idxFrame;
+	ssize_t lenView;
+	Success success;
+
+	while (1)
+	{
+		lenView = viewGet(pData, lenNeed);
+		if (lenView < 0)
+			break;
+
+		if (!lenView)
+			return Pending;
+
+		success = frameParse(pData, lenView, idxFrame, lenFrame);
+		if (success == Positive)
+		{
+			pFrame = pData + idxFrame;
+			return Positive;
+		}
+
+		if (success < 0)
+			return success;
+
+		// Transfer has nothing more for now
+		if ((size_t)lenView < lenNeed)
+			return Pending;
+
+		lenNeed = mLenNeed;
+	}
+
+	// Frames received before the end are still delivered
+	lenView = viewGet(pData, 0);
+	if (lenView <= 0)
+		return -1;
+
+	success = frameParse(pData, lenView, idxFrame, lenFrame);
+	if (success != Positive)
+		return -1;
+
+	pFrame = pData + idxFrame;
+
+	return Positive;
+}
+
+void Deframer::frameDone()
+{
+	if (!mpTrans || !mLenFrameDone)
+		return;
+
+	if (mpTrans->peekSupported())
+		mpTrans->consume(mLenFrameDone);
+	else
+		mIdxRecvStart += mLenFrameDone;
+
+	stateReset();
+}
+
+ssize_t Deframer::framesCommit(Pipe<VecByte> &pp)
+{
+	const uint8_t *pFrame;
+	size_t lenFrame;
+	ssize_t numFrames = 0;
+	ssize_t res;
+	Success success;
+
+	while (!pp.isFull())
+	{
+		success = frameGet(pFrame, lenFrame);
+		if (success == Pending)
+			break;
+
+		if (success < 0)
+			return numFrames ? numFrames : success;
+
+		res = pp.commit(VecByte(pFrame, pFrame + lenFrame));
+		if (res < 0)
+			return numFrames ? numFrames : -3;
+
+		// Filled by another thread. Frame is kept
+		if (!res)
+			break;
+
+		frameDone();
+		++numFrames;
+	}
+
+	return numFrames;
+}
+
+/*
+ * Frames are parsed from the front of the view.
+ * Incomplete frames set the number of bytes needed
+ */
+Success Deframer::frameParse(const uint8_t *pData, size_t len,
+					size_t &idxFrame, size_t &lenFrame)
+{
+	uint64_t lenPayload = 0;
+	size_t lenHdr = 0;
+	size_t i;
+
+	if (mFmt.mode == FrameSizeFixed)
+	{
+		if (len < mFmt.sizeFixed)
+		{
+			mLenNeed = mFmt.sizeFixed;
+			return Pending;
+		}
+
+		idxFrame = 0;
+		lenFrame = mFmt.sizeFixed;
+		mLenFrameDone = lenFrame;
+
+		return Positive;
+	}
+
+	if (mFmt.mode == FrameDelimiter)
+	{
+		const uint8_t *pDelim = (const uint8_t *)mFmt.delimiter.data();
+		size_t lenDelim = mFmt.delimiter.size();
+		const uint8_t *pEnd = pData + len;
+		const uint8_t *pFound;
+
+		// Bytes searched already are skipped
+		pFound = search(pData + mIdxSearch, pEnd, pDelim, pDelim + lenDelim);
+		if (pFound == pEnd)
+		{
+			if (len >= mFmt.sizeMax + lenDelim)
+				return errLog(-3, "delimiter not found within %u bytes", (unsigned)len);
+
+			if (len >= lenDelim)
+				mIdxSearch = len - lenDelim + 1;
+
+			// Grow geometrically. Avoids one receive per byte
+			mLenNeed = len + len / 2 + 1;
+
+			if (mLenNeed > mFmt.sizeMax + lenDelim)
+				mLenNeed = mFmt.sizeMax + lenDelim;
+
+			return Pending;
+		}
+
+		idxFrame = 0;
+		lenFrame = pFound - pData;
+		mLenFrameDone = lenFrame + lenDelim;
+
+		if (lenFrame > mFmt.sizeMax)
+			return errLog(-4, "frame too large: %u bytes", (unsigned)lenFrame);
+
+		return Positive;
+	}
+
+	if (mFmt.mode == FrameLenFixed)
+	{
+		if (len < mFmt.lenPrefix)
+		{
+			mLenNeed = mFmt.lenPrefix;
+			return Pending;
+		}
+
+		for (i = 0; i < mFmt.lenPrefix; ++i)
+		{
+			if (mFmt.bigEndian)
+				lenPayload = (lenPayload << 8) | pData[i];
+			else
+				lenPayload |= (uint64_t)pData[i] << (8 * i);
+		}
+
+		lenHdr = mFmt.lenPrefix;
+	}
+	else
+	{
+		for (i = 0; i < len && i < dLenVarintMax; ++i)
+		{
+			lenPayload |= (uint64_t)(pData[i] & 0x7F) << (7 * i);
+
+			if (!(pData[i] & 0x80))
+				break;
+		}
+
+		if (i == dLenVarintMax)
+			return errLog(-5, "invalid length prefix");
+
+		if (i == len)
+		{
+			mLenNeed = len + 1;
+			return Pending;
+		}
+
+		lenHdr = i + 1;
+	}
+
+	if (lenPayload > mFmt.sizeMax)
+		return errLog(-4, "frame too large: %lu bytes", (unsigned long)lenPayload);
+
+	if (len < lenHdr + lenPayload)
+	{
+		mLenNeed = lenHdr + lenPayload;
+		return Pending;
+	}
+
+	idxFrame = lenHdr;
+	lenFrame = lenPayload;
+	mLenFrameDone = lenHdr + lenPayload;
+
+	return Positive;
+}
+
+/*
+ * Transfers with receive buffer are asked directly.
+ * Others are read into the own buffer
+ */
+ssize_t Deframer::viewGet(const uint8_t *&pData, size_t lenMin)
+{
+	if (mpTrans->peekSupported())
+		return mpTrans->peek(pData, lenMin);
+
+	size_t lenAvail = mIdxRecvEnd - mIdxRecvStart;
+	ssize_t numBytes;
+
+	pData = NULL;
+
+	if (lenAvail < lenMin)
+	{
+		if (mIdxRecvStart)
+		{
+			memmove(mBufRecv.data(), &mBufRecv[mIdxRecvStart], lenAvail);
+
+			mIdxRecvStart = 0;
+			mIdxRecvEnd = lenAvail;
+		}
+
+		if (mBufRecv.size() < lenMin)
+			mBufRecv.resize(lenMin < dSizeBufRecvMin ? dSizeBufRecvMin : lenMin);
+	}
+
+	while (mIdxRecvEnd - mIdxRecvStart < lenMin)
+	{
+		numBytes = mpTrans->read(&mBufRecv[mIdxRecvEnd], mBufRecv.size() - mIdxRecvEnd);
+		if (!numBytes)
+			break;
+
+		if (numBytes < 0)
+			return numBytes;
+
+		mIdxRecvEnd += numBytes;
+	}
+
+	lenAvail = mIdxRecvEnd - mIdxRecvStart;
+	if (!lenAvail)
+		return 0;
+
+	pData = &mBufRecv[mIdxRecvStart];
+
+	return lenAvail;
+}
+
+void Deframer::stateReset()
+{
+	mLenFrameDone = 0;
+	mIdxSearch = 0;
+
+	if (mFmt.mode == FrameLenFixed)
+		mLenNeed = mFmt.lenPrefix;
+	else
+	if (mFmt.mode == FrameDelimiter)
+		mLenNeed = mFmt.delimiter.size();
+	else
+	if (mFmt.mode == FrameSizeFixed)
+		mLenNeed = mFmt.sizeFixed;
+	else
+		mLenNeed = 1;
+
+	if (!mLenNeed)
+		mLenNeed = 1;
+}
+
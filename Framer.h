@@ -0,0 +1,227 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef FRAMER_H
+#define FRAMER_H
+
+#include <string>
+
+#include "Transfering.h"
+#include "Pipe.h"
+
+// Larger frames are treated as protocol errors
+#ifndef CONFIG_FRAME_SIZE_MAX
+#define CONFIG_FRAME_SIZE_MAX			(64 * 1024)
+#endif
+
+enum FrameMode
+{
+	FrameLenFixed = 0,
+	FrameLenVarint,
+	FrameDelimiter,
+	FrameSizeFixed,
+};
+
+/*
+ * Layout of frames on the stream
+ * - FrameLenFixed   .. Length prefix with lenPrefix bytes
+ *                      (1, 2, 4 or 8). Byte order given by
+ *                      bigEndian
+ * - FrameLenVarint  .. Length prefix as unsigned LEB128.
+ *                      Used by Protocol Buffers
+ * - FrameDelimiter  .. Payload followed by delimiter.
+ *                      Delimiter is not part of the payload
+ * - FrameSizeFixed  .. Every payload has sizeFixed bytes
+ *
+Literature
+- https://en.wikipedia.org/wiki/LEB128
+- https://protobuf.dev/programming-guides/encoding/#varints
+*/
+struct FrameFormat
+{
+	FrameFormat()
+		: mode(FrameLenFixed)
+		, lenPrefix(4)
+		, bigEndian(true)
+		, delimiter("\n")
+		, sizeFixed(0)
+		, sizeMax(CONFIG_FRAME_SIZE_MAX)
+	{}
+
+	FrameMode mode;
+	size_t lenPrefix;
+	bool bigEndian;
+	std::string delimiter;
+	size_t sizeFixed;
+	size_t sizeMax;
+};
+
+/*
+ * Writes frames to a transfer
+ * - Header, payload and trailer are sent with one send()
+ * - Data not accepted by the transfer is kept and sent
+ *   first on the next call
+ */
+class Framer
+{
+
+public:
+
+	Framer();
+	virtual ~Framer() {}
+
+	void formatSet(const FrameFormat &fmt);
+	void transferSet(Transfering *pTrans);
+
+	bool frameCreate(const void *pData, size_t len, VecByte &buf) const;
+
+	/*
+	 * Return value
+	 *   Positive .. frame accepted
+	 *   Pending  .. remainder of previous frame still pending
+	 *   < 0      .. invalid payload or transfer failed
+	 */
+	Success frameSend(const void *pData, size_t len);
+	Success frameSend(const VecByte &pkt)
+	{ return frameSend(pkt.data(), pkt.size()); }
+
+	Success flush();
+
+private:
+
+	Framer(const Framer &)
+		: mFmt()
+		, mpTrans(NULL)
+		, mBufSend()
+		, mIdxSend(0)
+	{}
+	Framer &operator=(const Framer &)
+	{
+		mFmt = FrameFormat();
+		mpTrans = NULL;
+		mBufSend.clear();
+		mIdxSend = 0;
+
+		return *this;
+	}
+
+	/* member variables */
+	FrameFormat mFmt;
+	Transfering *mpTrans;
+	VecByte mBufSend;
+	size_t mIdxSend;
+
+};
+
+/*
+ * Splits the byte stream of a transfer into frames
+ * - frameGet() sets pFrame to the payload of the next
+ *   complete frame. The view stays valid until frameDone()
+ *   or the next read of the transfer
+ * - Transfers with receive buffer are used without copying.
+ *   Others are read into an internal buffer
+ * - framesCommit() copies frames into a pipe. The pipe
+ *   owns its particles
+ */
+class Deframer
+{
+
+public:
+
+	Deframer();
+	virtual ~Deframer() {}
+
+	void formatSet(const FrameFormat &fmt);
+	void transferSet(Transfering *pTrans);
+
+	/*
+	 * Return value
+	 *   Positive .. frame available
+	 *   Pending  .. frame not complete yet
+	 *   < 0      .. no more frames can be expected
+	 */
+	Success frameGet(const uint8_t *&pFrame, size_t &lenFrame);
+	void frameDone();
+
+	/*
+	 * Return value
+	 *   >= 0 number of frames committed
+	 *   <  0 no more frames can be expected
+	 */
+	ssize_t framesCommit(Pipe<VecByte> &pp);
+
+private:
+
+	Deframer(const Deframer &)
+		: mFmt()
+		, mpTrans(NULL)
+		, mLenNeed(0)
+		, mLenFrameDone(0)
+		, mIdxSearch(0)
+		, mBufRecv()
+		, mIdxRecvStart(0)
+		, mIdxRecvEnd(0)
+	{}
+	Deframer &operator=(const Deframer &)
+	{
+		mFmt = FrameFormat();
+		mpTrans = NULL;
+		mLenNeed = 0;
+		mLenFrameDone = 0;
+		mIdxSearch = 0;
+		mBufRecv.clear();
+		mIdxRecvStart = 0;
+		mIdxRecvEnd = 0;
+
+		return *this;
+	}
+
+	/* member functions */
+	ssize_t viewGet(const uint8_t *&pData, size_t lenMin);
+	Success frameParse(const uint8_t *pData, size_t len,
+					size_t &idxFrame, size_t &lenFrame);
+	void stateReset();
+
+	/* member variables */
+	FrameFormat mFmt;
+	Transfering *mpTrans;
+	size_t mLenNeed;
+	size_t mLenFrameDone;
+	size_t mIdxSearch;
+
+	// Only used for transfers without receive buffer
+	VecByte mBufRecv;
+	size_t mIdxRecvStart;
+	size_t mIdxRecvEnd;
+
+};
+
+#endif
+
@@ -0,0 +1,814 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <map>
+#include <random>
+#include <chrono>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "HostResolving.h"
+
+#define dForEach_ProcState(gen) \
+		gen(StStart) \
+		gen(StQueriesSend) \
+		gen(StResponsesWait) \
+
+#define dGenProcStateEnum(s) s,
+dProcessStateEnum(ProcState);
+
+#if 0
+#define dGenProcStateString(s) #s,
+dProcessStateStr(ProcState);
+#endif
+
+using namespace std;
+using namespace chrono;
+
+#define dDnsSizeHeader			12
+#define dDnsSizeMsgMax			512
+#define dDnsFlagResponse		0x8000
+#define dDnsFlagRecursion		0x0100
+#define dDnsMaskRcode			0x000F
+#define dDnsTypeA			1
+#define dDnsTypeCname			5
+#define dDnsTypeAaaa			28
+#define dDnsClassIn			1
+
+// Errors tolerated per read. Remaining ones are read on the next tick
+#define dNumRecvErrMax			4
+
+struct ResolvEntry
+{
+	vector<string> addrs;
+	uint32_t expiresMs;
+};
+
+static map<string, ResolvEntry> entriesCache;
+static string addrNameServer;
+static uint16_t portNameServer = 53;
+static string pathHosts = CONFIG_RES_PATH_HOSTS;
+#if CONFIG_PROC_HAVE_DRIVERS
+static mutex mtxResolv;
+#endif
+
+static bool addrFamilyMatch(const string &addr, int family)
+{
+	if (family == AF_UNSPEC)
+		return true;
+
+	bool isIPv6 = addr.find(':') != string::npos;
+
+	return (family == AF_INET6) == isIPv6;
+}
+
+static size_t queryCreate(uint8_t *pBuf, uint16_t id,
+					const string &host, uint16_t type)
+{
+	uint8_t *pDst = pBuf;
+	size_t idxStart = 0, idxEnd, lenLabel;
+
+	*pDst++ = id >> 8;
+	*pDst++ = id;
+	*pDst++ = dDnsFlagRecursion >> 8;
+	*pDst++ = dDnsFlagRecursion & 0xFF;
+	*pDst++ = 0; // questions
+	*pDst++ = 1;
+	memset(pDst, 0, 6);
+	pDst += 6;
+
+	while (idxStart < host.size())
+	{
+		idxEnd = host.find('.', idxStart);
+		if (idxEnd == string::npos)
+			idxEnd = host.size();
+
+		lenLabel = idxEnd - idxStart;
+		if (!lenLabel || lenLabel > 63)
+			return 0;
+
+		*pDst++ = (uint8_t)lenLabel;
+		memcpy(pDst, &host[idxStart], lenLabel);
+		pDst += lenLabel;
+
+		idxStart = idxEnd + 1;
+	}
+
+	*pDst++ = 0;
+	*pDst++ = type >> 8;
+	*pDst++ = type;
+	*pDst++ = 0;
+	*pDst++ = dDnsClassIn;
+
+	return pDst - pBuf;
+}
+
+// Returns the index after the name or zero
+static size_t nameSkip(const uint8_t *pData, size_t len, size_t idx)
+{
+	uint8_t lenLabel;
+
+	while (idx < len)
+	{
+		lenLabel = pData[idx];
+
+		// Compression pointer ends the name
+		if ((lenLabel & 0xC0) == 0xC0)
+			return idx + 2 <= len ? idx + 2 : 0;
+
+		if (lenLabel & 0xC0)
+			return 0;
+
+		++idx;
+
+		if (!lenLabel)
+			return idx;
+
+		idx += lenLabel;
+	}
+
+	return 0;
+}
+
+static uint16_t u16Get(const uint8_t *pData)
+{
+	return (uint16_t)(pData[0] << 8 | pData[1]);
+}
+
+HostResolving::HostResolving(const string &host)
+	: Processing("HostResolving")
+	, mStartMs(0)
+	, mHost(host)
+	, mFamily(AF_UNSPEC)
+	, mSocketFd(INVALID_SOCKET)
+	, mSlot()
+	, mNumTries(0)
+	, mIdsQuery()
+	, mQueriesDone(0)
+	, mAddrs4()
+	, mAddrs6()
+	, mAddrs()
+	, mTtlMinS(CONFIG_RES_TTL_MAX_S)
+	, mFromHosts(false)
+	, mFromCache(false)
+{
+	mState = StStart;
+}
+
+/* member functions */
+
+void HostResolving::familySet(int family)
+{
+	mFamily = family;
+}
+
+const vector<string> &HostResolving::addrs() const
+{
+	return mAddrs;
+}
+
+/*
+Literature
+- https://datatracker.ietf.org/doc/html/rfc1035
+- https://datatracker.ietf.org/doc/html/rfc3596
+- https://man7.org/linux/man-pages/man5/hosts.5.html
+- https://man7.org/linux/man-pages/man5/resolv.conf.5.html
+*/
+Success HostResolving::process()
+{
+	uint32_t curTimeMs = millis();
+	uint32_t diffMs = curTimeMs - mStartMs;
+	Success success;
+#if 0
+	dStateTrace;
+#endif
+	switch (mState)
+	{
+	case StStart:
+
+		mHost = hostNormalize(mHost);
+		if (!mHost.size() || mHost.size() > 253)
+			return procErrLog(-1, "invalid host name '%s'", mHost.c_str());
+
+		if (cacheGet(mHost, mAddrs, mFamily))
+		{
+			mFromCache = true;
+			return Positive;
+		}
+
+		if (hostsFileRead())
+		{
+			mFromHosts = true;
+			mTtlMinS = CONFIG_RES_TTL_HOSTS_S;
+			resultsMerge();
+			return Positive;
+		}
+#ifdef _WIN32
+		if (!TcpTransfering::wsaInit())
+			return procErrLog(-2, "could not init WSA");
+#endif
+		success = socketCreate();
+		if (success != Positive)
+			return procErrLog(-1, "could not create socket");
+
+		mState = StQueriesSend;
+
+		break;
+	case StQueriesSend:
+
+		if (mNumTries >= CONFIG_RES_NUM_TRIES)
+		{
+			if (!mQueriesDone)
+				return procErrLog(-1, "no response from name server");
+
+			// Some servers drop AAAA queries. Use what arrived
+			resultsMerge();
+
+			if (!mAddrs.size())
+				return procErrLog(-1, "could not resolve '%s'", mHost.c_str());
+
+			return Positive;
+		}
+
+		success = queriesSend();
+		if (success != Positive)
+			return procErrLog(-1, "could not send queries");
+
+		++mNumTries;
+
+		mStartMs = curTimeMs;
+		mState = StResponsesWait;
+
+		break;
+	case StResponsesWait:
+
+		if (Reactor::eventsUpdate(mSlot) & RevRead)
+			responsesRead();
+
+		if (mQueriesDone != 3)
+		{
+			if (diffMs > CONFIG_RES_TIMEOUT_QUERY_MS)
+				mState = StQueriesSend;
+			break;
+		}
+
+		resultsMerge();
+
+		if (!mAddrs.size())
+			return procErrLog(-1, "could not resolve '%s'", mHost.c_str());
+
+		return Positive;
+
+		break;
+	default:
+		break;
+	}
+
+	return Pending;
+}
+
+Success HostResolving::shutdown()
+{
+	Reactor::slotRemove(mSlot);
+
+	if (mSocketFd != INVALID_SOCKET)
+	{
+#ifdef _WIN32
+		::closesocket(mSocketFd);
+#else
+		::close(mSocketFd);
+#endif
+		mSocketFd = INVALID_SOCKET;
+	}
+
+	return Positive;
+}
+
+bool HostResolving::hostsFileRead()
+{
+	string path, line, addr, name;
+	char buf[512];
+	size_t idx;
+	FILE *pFile;
+
+	{
+#if CONFIG_PROC_HAVE_DRIVERS
+		Guard lock(mtxResolv);
+#endif
+		path = pathHosts;
+	}
+
+	pFile = fopen(path.c_str(), "r");
+	if (!pFile)
+		return false;
+
+	while (fgets(buf, sizeof(buf), pFile))
+	{
+		line = buf;
+
+		idx = line.find('#');
+		if (idx != string::npos)
+			line.resize(idx);
+
+		istringstream iss(line);
+
+		if (!(iss >> addr))
+			continue;
+
+		while (iss >> name)
+		{
+			if (hostNormalize(name) != mHost)
+				continue;
+
+			if (addrFamilyMatch(addr, AF_INET6))
+				mAddrs6.push_back(addr);
+			else
+				mAddrs4.push_back(addr);
+
+			break;
+		}
+	}
+
+	fclose(pFile);
+
+	return mAddrs4.size() || mAddrs6.size();
+}
+
+Success HostResolving::socketCreate()
+{
+	struct sockaddr_storage addr;
+	random_device rd;
+	socklen_t lenAddr;
+	int res;
+
+	if (!nameServerGet(addr))
+		return procErrLog(-1, "no name server configured");
+
+	// IMPORTANT
+	// No need to close socket in case of error
+	// This is done in function shutdown()
+
+	mSocketFd = ::socket(addr.ss_family, SOCK_DGRAM, 0);
+	if (mSocketFd == INVALID_SOCKET)
+		return procErrLog(-1, "could not create socket");
+
+	if (!fileNonBlockingSet(mSocketFd))
+		return procErrLog(-1, "could not set non blocking mode");
+
+	// Responses from other sources are dropped by the kernel
+	lenAddr = addr.ss_family == AF_INET6 ?
+				sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+
+	res = ::connect(mSocketFd, (struct sockaddr *)&addr, lenAddr);
+	if (res)
+		return procErrLog(-1, "could not connect to name server");
+
+	if (!Reactor::slotAdd(mSlot, mSocketFd))
+		procDbgLog("waiting without reactor");
+
+	// Random IDs and ports make spoofing harder
+	mIdsQuery[0] = (uint16_t)rd();
+	mIdsQuery[1] = mIdsQuery[0] + 1 + (uint16_t)(rd() % 0xFFFE);
+
+	return Positive;
+}
+
+Success HostResolving::queriesSend()
+{
+	static const uint16_t types[2] = { dDnsTypeA, dDnsTypeAaaa };
+	uint8_t buf[dDnsSizeMsgMax];
+	size_t len;
+	ssize_t res;
+
+	for (size_t i = 0; i < 2; ++i)
+	{
+		if (mQueriesDone & (1 << i))
+			continue;
+
+		len = queryCreate(buf, mIdsQuery[i], mHost, types[i]);
+		if (!len)
+			return procErrLog(-1, "invalid host name '%s'", mHost.c_str());
+
+		res = ::send(mSocketFd, (const char *)buf, len, 0);
+		if (res != (ssize_t)len)
+			procWrnLog("could not send query");
+	}
+
+	return Positive;
+}
+
+void HostResolving::responsesRead()
+{
+	uint8_t buf[dDnsSizeMsgMax];
+	ssize_t res;
+	int numErr, numErrs = 0;
+
+	while (mSocketFd != INVALID_SOCKET)
+	{
+		res = ::recv(mSocketFd, (char *)buf, sizeof(buf), 0);
+		if (res < 0)
+		{
+#ifdef _WIN32
+			numErr = WSAGetLastError();
+			if (numErr != WSAEWOULDBLOCK)
+#else
+			numErr = errno;
+			if (numErr != EAGAIN && numErr != EWOULDBLOCK)
+#endif
+			{
+				// ICMP errors are reported once. Pending responses follow
+				procDbgLog("recv() failed: %d", numErr);
+
+				if (++numErrs > dNumRecvErrMax)
+					break;
+
+				continue;
+			}
+
+			Reactor::eventsClear(mSlot, RevRead);
+			break;
+		}
+
+		responseParse(buf, res);
+	}
+}
+
+/*
+ * Only A, AAAA and CNAME records of the answer section
+ * are used. Truncated responses give what they contain
+ */
+void HostResolving::responseParse(const uint8_t *pData, size_t len)
+{
+	uint16_t id, flags, numQuestions, numAnswers;
+	uint16_t type, cls, lenData;
+	uint32_t ttlS;
+	size_t idx = dDnsSizeHeader;
+	char bufAddr[INET6_ADDRSTRLEN];
+	uint8_t bit;
+
+	if (len < dDnsSizeHeader)
+		return;
+
+	id = u16Get(pData);
+	flags = u16Get(pData + 2);
+	numQuestions = u16Get(pData + 4);
+	numAnswers = u16Get(pData + 6);
+
+	if (!(flags & dDnsFlagResponse))
+		return;
+
+	if (id == mIdsQuery[0])
+		bit = 1;
+	else
+	if (id == mIdsQuery[1])
+		bit = 2;
+	else
+		return;
+
+	if (mQueriesDone & bit)
+		return;
+
+	for (; numQuestions; --numQuestions)
+	{
+		idx = nameSkip(pData, len, idx);
+		if (!idx || idx + 4 > len)
+			return;
+
+		idx += 4;
+	}
+
+	mQueriesDone |= bit;
+
+	// NXDOMAIN and friends
+	if (flags & dDnsMaskRcode)
+		return;
+
+	for (; numAnswers; --numAnswers)
+	{
+		idx = nameSkip(pData, len, idx);
+		if (!idx || idx + 10 > len)
+			return;
+
+		type = u16Get(pData + idx);
+		cls = u16Get(pData + idx + 2);
+		ttlS = (uint32_t)u16Get(pData + idx + 4) << 16 | u16Get(pData + idx + 6);
+		lenData = u16Get(pData + idx + 8);
+
+		idx += 10;
+		if (idx + lenData > len)
+			return;
+
+		if (cls != dDnsClassIn)
+		{
+			idx += lenData;
+			continue;
+		}
+
+		if (type == dDnsTypeA && lenData == 4)
+		{
+			inet_ntop(AF_INET, (void *)(pData + idx), bufAddr, sizeof(bufAddr));
+			mAddrs4.push_back(bufAddr);
+		}
+		else
+		if (type == dDnsTypeAaaa && lenData == 16)
+		{
+			inet_ntop(AF_INET6, (void *)(pData + idx), bufAddr, sizeof(bufAddr));
+			mAddrs6.push_back(bufAddr);
+		}
+		else
+		if (type != dDnsTypeCname)
+		{
+			idx += lenData;
+			continue;
+		}
+
+		// Values with the highest bit set are treated as zero
+		if (ttlS > 0x7FFFFFFF)
+			ttlS = 0;
+
+		if (ttlS < mTtlMinS)
+			mTtlMinS = ttlS;
+
+		idx += lenData;
+	}
+}
+
+// Whole result is cached. Filter applies to this process only
+void HostResolving::resultsMerge()
+{
+	vector<string> addrsAll;
+	vector<string>::const_iterator iter;
+
+	addrsAll = mAddrs6;
+	addrsAll.insert(addrsAll.end(), mAddrs4.begin(), mAddrs4.end());
+
+	cacheAdd(mHost, addrsAll, mTtlMinS);
+
+	mAddrs.clear();
+
+	iter = addrsAll.begin();
+	for (; iter != addrsAll.end(); ++iter)
+	{
+		if (addrFamilyMatch(*iter, mFamily))
+			mAddrs.push_back(*iter);
+	}
+}
+
+void HostResolving::processInfo(char *pBuf, char *pBufEnd)
+{
+	vector<string>::const_iterator iter;
+	const char *pSource = "dns";
+
+	if (mFromCache)
+		pSource = "cache";
+	else
+	if (mFromHosts)
+		pSource = "hosts";
+
+	dInfo("Host\t\t\t%s\n", mHost.c_str());
+	dInfo("Source\t\t\t%s\n", pSource);
+
+	if (!mFromCache && !mFromHosts)
+	{
+		dInfo("Tries\t\t\t%u\n", (unsigned)mNumTries);
+		dInfo("TTL\t\t\t%us\n", (unsigned)mTtlMinS);
+	}
+
+	iter = mAddrs.begin();
+	for (; iter != mAddrs.end(); ++iter)
+		dInfo("Address\t\t\t%s\n", iter->c_str());
+}
+
+/* static functions */
+
+bool HostResolving::cacheGet(const string &host, vector<string> &addrs, int family)
+{
+	string hostNorm = hostNormalize(host);
+	map<string, ResolvEntry>::iterator iter;
+	vector<string>::const_iterator iterAddr;
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mtxResolv);
+#endif
+	iter = entriesCache.find(hostNorm);
+	if (iter == entriesCache.end())
+		return false;
+
+	if ((int32_t)(iter->second.expiresMs - millis()) <= 0)
+	{
+		entriesCache.erase(iter);
+		return false;
+	}
+
+	addrs.clear();
+
+	iterAddr = iter->second.addrs.begin();
+	for (; iterAddr != iter->second.addrs.end(); ++iterAddr)
+	{
+		if (addrFamilyMatch(*iterAddr, family))
+			addrs.push_back(*iterAddr);
+	}
+
+	return addrs.size() > 0;
+}
+
+void HostResolving::cacheClear()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mtxResolv);
+#endif
+	entriesCache.clear();
+}
+
+void HostResolving::nameServerSet(const string &addr, uint16_t port)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mtxResolv);
+#endif
+	addrNameServer = addr;
+	portNameServer = port;
+}
+
+void HostResolving::hostsFileSet(const string &path)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mtxResolv);
+#endif
+	pathHosts = path;
+}
+
+// Full cache drops expired entries first, then the oldest one
+void HostResolving::cacheAdd(const string &host, const vector<string> &addrs, uint32_t ttlS)
+{
+	map<string, ResolvEntry>::iterator iter, iterOldest;
+	uint32_t curTimeMs = millis();
+
+	if (!addrs.size() || !ttlS)
+		return;
+
+	if (ttlS > CONFIG_RES_TTL_MAX_S)
+		ttlS = CONFIG_RES_TTL_MAX_S;
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mtxResolv);
+#endif
+	iter = entriesCache.begin();
+	while (entriesCache.size() >= CONFIG_RES_NUM_CACHE_MAX &&
+			iter != entriesCache.end())
+	{
+		if ((int32_t)(iter->second.expiresMs - curTimeMs) <= 0)
+			iter = entriesCache.erase(iter);
+		else
+			++iter;
+	}
+
+	if (entriesCache.size() >= CONFIG_RES_NUM_CACHE_MAX &&
+			entriesCache.find(host) == entriesCache.end())
+	{
+		iterOldest = iter = entriesCache.begin();
+		for (; iter != entriesCache.end(); ++iter)
+		{
+			if ((int32_t)(iter->second.expiresMs - iterOldest->second.expiresMs) < 0)
+				iterOldest = iter;
+		}
+
+		entriesCache.erase(iterOldest);
+	}
+
+	ResolvEntry &entry = entriesCache[host];
+
+	entry.addrs = addrs;
+	entry.expiresMs = curTimeMs + ttlS * 1000;
+}
+
+// First entry of resolv.conf unless set explicitly
+bool HostResolving::nameServerGet(struct sockaddr_storage &addr)
+{
+	struct sockaddr_in *pAddr4 = (struct sockaddr_in *)&addr;
+	struct sockaddr_in6 *pAddr6 = (struct sockaddr_in6 *)&addr;
+	string strAddr, line, key;
+	uint16_t port;
+	char buf[256];
+	FILE *pFile;
+
+	{
+#if CONFIG_PROC_HAVE_DRIVERS
+		Guard lock(mtxResolv);
+#endif
+		strAddr = addrNameServer;
+		port = portNameServer;
+	}
+
+	if (!strAddr.size())
+	{
+		pFile = fopen(CONFIG_RES_PATH_RESOLV_CONF, "r");
+		if (!pFile)
+			return false;
+
+		while (!strAddr.size() && fgets(buf, sizeof(buf), pFile))
+		{
+			istringstream iss(buf);
+
+			if (iss >> key && key == "nameserver")
+				iss >> strAddr;
+		}
+
+		fclose(pFile);
+		port = 53;
+	}
+
+	// Scope IDs are not supported
+	strAddr = strAddr.substr(0, strAddr.find('%'));
+
+	memset(&addr, 0, sizeof(addr));
+
+	if (inet_pton(AF_INET, strAddr.c_str(), &pAddr4->sin_addr) == 1)
+	{
+		pAddr4->sin_family = AF_INET;
+		pAddr4->sin_port = htons(port);
+		return true;
+	}
+
+	if (inet_pton(AF_INET6, strAddr.c_str(), &pAddr6->sin6_addr) == 1)
+	{
+		pAddr6->sin6_family = AF_INET6;
+		pAddr6->sin6_port = htons(port);
+		return true;
+	}
+
+	return false;
+}
+
+string HostResolving::hostNormalize(const string &host)
+{
+	string str = host;
+
+	for (size_t i = 0; i < str.size(); ++i)
+		str[i] = (char)tolower((unsigned char)str[i]);
+
+	if (str.size() && str[str.size() - 1] == '.')
+		str.resize(str.size() - 1);
+
+	return str;
+}
+
+uint32_t HostResolving::millis()
+{
+	auto now = steady_clock::now();
+	auto nowMs = time_point_cast<milliseconds>(now);
+	return (uint32_t)nowMs.time_since_epoch().count();
+}
+
+bool HostResolving::fileNonBlockingSet(SOCKET fd)
+{
+	int opt;
+#ifdef _WIN32
+	unsigned long nonBlockMode = 1;
+
+	opt = ioctlsocket(fd, FIONBIO, &nonBlockMode);
+	if (opt == SOCKET_ERROR)
+		return false;
+#else
+	opt = fcntl(fd, F_GETFL, 0);
+	if (opt == -1)
+		return false;
+
+	opt |= O_NONBLOCK;
+
+	opt = fcntl(fd, F_SETFL, opt);
+	if (opt == -1)
+		return false;
+#endif
+	return true;
+}
+
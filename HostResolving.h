@@ -0,0 +1,222 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef HOST_RESOLVING_H
+#define HOST_RESOLVING_H
+
+#include <string>
+#include <vector>
+
+#include "Processing.h"
+#include "TcpTransfering.h"
+
+// Queries are sent again after this time without response
+#ifndef CONFIG_RES_TIMEOUT_QUERY_MS
+#define CONFIG_RES_TIMEOUT_QUERY_MS		1000
+#endif
+
+#ifndef CONFIG_RES_NUM_TRIES
+#define CONFIG_RES_NUM_TRIES			3
+#endif
+
+// Entries of the hosts file have no TTL
+#ifndef CONFIG_RES_TTL_HOSTS_S
+#define CONFIG_RES_TTL_HOSTS_S			60
+#endif
+
+#ifndef CONFIG_RES_TTL_MAX_S
+#define CONFIG_RES_TTL_MAX_S			3600
+#endif
+
+#ifndef CONFIG_RES_NUM_CACHE_MAX
+#define CONFIG_RES_NUM_CACHE_MAX		64
+#endif
+
+#ifndef CONFIG_RES_PATH_HOSTS
+#ifdef _WIN32
+#define CONFIG_RES_PATH_HOSTS			"C:\\Windows\\System32\\drivers\\etc\\hosts"
+#else
+#define CONFIG_RES_PATH_HOSTS			"/etc/hosts"
+#endif
+#endif
+
+#ifndef CONFIG_RES_PATH_RESOLV_CONF
+#define CONFIG_RES_PATH_RESOLV_CONF		"/etc/resolv.conf"
+#endif
+
+/*
+ * Resolves a host name without blocking the driver
+ * - The hosts file is checked first. Otherwise A and
+ *   AAAA records are queried from the name server over UDP
+ * - Results are cached with the smallest TTL of the records
+ *   and shared by all threads. cacheGet() can be used
+ *   before a resolver is created
+ * - Addresses are numeric strings. IPv6 comes first.
+ *   familySet() filters the result only
+ */
+class HostResolving : public Processing
+{
+
+public:
+
+	static HostResolving *create(const std::string &host)
+	{
+		return new (std::nothrow) HostResolving(host);
+	}
+
+	void familySet(int family);
+	const std::vector<std::string> &addrs() const;
+
+	static bool cacheGet(const std::string &host,
+				std::vector<std::string> &addrs, int family = AF_UNSPEC);
+	static void cacheClear();
+	static void nameServerSet(const std::string &addr, uint16_t port = 53);
+	static void hostsFileSet(const std::string &path);
+
+protected:
+
+	virtual ~HostResolving() {}
+
+private:
+
+	HostResolving(const std::string &host);
+	HostResolving()
+		: Processing("")
+		, mStartMs(0)
+		, mHost("")
+		, mFamily(0)
+		, mSocketFd(INVALID_SOCKET)
+		, mSlot()
+		, mNumTries(0)
+		, mIdsQuery()
+		, mQueriesDone(0)
+		, mAddrs4()
+		, mAddrs6()
+		, mAddrs()
+		, mTtlMinS(0)
+		, mFromHosts(false)
+		, mFromCache(false)
+	{
+		mState = 0;
+	}
+	HostResolving(const HostResolving &)
+		: Processing("")
+		, mStartMs(0)
+		, mHost("")
+		, mFamily(0)
+		, mSocketFd(INVALID_SOCKET)
+		, mSlot()
+		, mNumTries(0)
+		, mIdsQuery()
+		, mQueriesDone(0)
+		, mAddrs4()
+		, mAddrs6()
+		, mAddrs()
+		, mTtlMinS(0)
+		, mFromHosts(false)
+		, mFromCache(false)
+	{
+		mState = 0;
+	}
+	HostResolving &operator=(const HostResolving &)
+	{
+		mStartMs = 0;
+		mHost = "";
+		mFamily = 0;
+		mSocketFd = INVALID_SOCKET;
+		mSlot = ReactorSlot();
+		mNumTries = 0;
+		mIdsQuery[0] = 0;
+		mIdsQuery[1] = 0;
+		mQueriesDone = 0;
+		mAddrs4.clear();
+		mAddrs6.clear();
+		mAddrs.clear();
+		mTtlMinS = 0;
+		mFromHosts = false;
+		mFromCache = false;
+
+		mState = 0;
+
+		return *this;
+	}
+
+	/*
+	 * Naming of functions:  objectVerb()
+	 * Example:              peerAdd()
+	 */
+
+	/* member functions */
+	Success process();
+	Success shutdown();
+
+	bool hostsFileRead();
+	Success socketCreate();
+	Success queriesSend();
+	void responsesRead();
+	void responseParse(const uint8_t *pData, size_t len);
+	void resultsMerge();
+	void processInfo(char *pBuf, char *pBufEnd);
+
+	/* member variables */
+	uint32_t mStartMs;
+	std::string mHost;
+	int mFamily;
+	SOCKET mSocketFd;
+	ReactorSlot mSlot;
+	uint32_t mNumTries;
+
+	// [0] .. A, [1] .. AAAA
+	uint16_t mIdsQuery[2];
+	uint8_t mQueriesDone;
+
+	std::vector<std::string> mAddrs4;
+	std::vector<std::string> mAddrs6;
+	std::vector<std::string> mAddrs;
+	uint32_t mTtlMinS;
+	bool mFromHosts;
+	bool mFromCache;
+
+	/* static functions */
+	static void cacheAdd(const std::string &host,
+				const std::vector<std::string> &addrs, uint32_t ttlS);
+	static bool nameServerGet(struct sockaddr_storage &addr);
+	static std::string hostNormalize(const std::string &host);
+	static uint32_t millis();
+	static bool fileNonBlockingSet(SOCKET fd);
+
+	/* static variables */
+
+	/* constants */
+
+};
+
+#endif
+
@@ -44,46 +44,125 @@
 #endif
 #endif
 
+#ifndef CONFIG_PROC_LOG_HAVE_DISK
+#if defined(__unix__) || defined(_WIN32)
+#define CONFIG_PROC_LOG_HAVE_DISK			1
+#else
+#define CONFIG_PROC_LOG_HAVE_DISK			0
+#endif
+#endif
+
+#ifndef CONFIG_PROC_LOG_DISK_BUFFER_SIZE
+#define CONFIG_PROC_LOG_DISK_BUFFER_SIZE		(64 * 1024)
+#endif
+
 #include <inttypes.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
 #if CONFIG_PROC_LOG_HAVE_CHRONO
 #include <chrono>
 #include <time.h>
 #endif
+
+#include "Processing.h"
+
 #if CONFIG_PROC_HAVE_DRIVERS
 #include <mutex>
+#include <thread>
+#include <atomic>
 #endif
 #ifdef _WIN32
 #include <windows.h>
 #endif
+#if CONFIG_PROC_LOG_HAVE_DISK && defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if CONFIG_PROC_HAVE_LOG
+
+#if CONFIG_PROC_HAVE_DRIVERS && CONFIG_PROC_LOG_HAVE_CHRONO && CONFIG_PROC_LOG_HAVE_STDOUT
+#define dLogHaveAsync	1
+#else
+#define dLogHaveAsync	0
+#endif
 
 using namespace std;
 #if CONFIG_PROC_LOG_HAVE_CHRONO
 using namespace chrono;
 #endif
 
-typedef void (*FuncEntryLogCreate)(
-			const int severity,
-			const void *pProc,
-			const char *filename,
-			const char *function,
-			const int line,
-			const int16_t code,
-			const char *msg,
-			const size_t len);
-
-typedef uint32_t (*FuncCntTimeCreate)();
-
 static FuncEntryLogCreate pFctEntryLogCreate = NULL;
 static FuncCntTimeCreate pFctCntTimeCreate = NULL;
 static int widthCntTime = 0;
 
+#if CONFIG_PROC_HAVE_DRIVERS
+#define dThreadLocal thread_local
+#else
+#define dThreadLocal
+#endif
+
 #if CONFIG_PROC_LOG_HAVE_CHRONO
-static system_clock::time_point tOld;
 const int cDiffSecMax = 9;
 const int cDiffMsMax = 999;
+const int64_t cDiffMsInvalid = -1;
+
+/*
+ * Date and time of the last formatted second
+ * mtxPrint must be locked when used
+ */
+struct LogTimeCache
+{
+	time_t tSec;
+	char str[32];
+};
+
+static LogTimeCache timeCache = { -1, "" };
+#endif
+
+enum LogSinkBits
+{
+	LsbStdout = 1,	// Text output or binary stream
+	LsbHook = 2,	// Function set by entryLogCreateSet()
+	LsbDisk = 4,	// logDiskStart()
+	LsbStructured = 8,	// Function set by entryLogStructuredSet()
+};
+
+#if CONFIG_PROC_LOG_HAVE_DISK
+/*
+ * mtxPrint must be locked when used
+ */
+struct LogDisk
+{
+	FILE *pFile;
+	char *pFilename;
+	char *pBuf;
+	size_t lenBuf;
+	size_t sizeFile;
+	size_t sizeFileMax;
+	size_t numFiles;
+	bool preallocate;
+	bool exitFlushSet;
+	bool writeFailed;
+	uint32_t numWritesShort;
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+	steady_clock::time_point tFlushed;
+#endif
+};
+
+static LogDisk disk = {};
+static LogEncoding encodingDisk = LogEncText;
+#if CONFIG_PROC_HAVE_DRIVERS
+static atomic<bool> diskActive(false);
+#else
+static bool diskActive = false;
+#endif
+static uint32_t diskFlushIntervalMs = 1000;
+static int levelDiskFlush = 2;
 #endif
 
 #ifdef _WIN32
@@ -104,22 +183,343 @@ const char *dColorDefault = "\033[39m";
 #define dColorInfo dColorDefault
 #endif
 
+#ifndef CONFIG_PROC_LOG_NUM_LEVELS_FILE
+#define CONFIG_PROC_LOG_NUM_LEVELS_FILE		8
+#endif
+
+#ifndef CONFIG_PROC_LOG_NUM_SITES_LIMITED
+#define CONFIG_PROC_LOG_NUM_SITES_LIMITED		64
+#endif
+
+// Repeat summaries pending longer are written without a new entry
+#ifndef CONFIG_PROC_LOG_DELAY_SUMMARY_MS
+#define CONFIG_PROC_LOG_DELAY_SUMMARY_MS		1000
+#endif
+
+#ifndef CONFIG_PROC_LOG_NUM_STRINGS_BINARY
+#define CONFIG_PROC_LOG_NUM_STRINGS_BINARY		256
+#endif
+
 const size_t cLogEntryBufferSize = 512;
 static int levelLog = 3;
+static int levelLogHook = 5;
+static int levelLogDisk = 3;
 #if CONFIG_PROC_HAVE_DRIVERS
 static mutex mtxPrint;
 #endif
 
+/*
+ * File specific log levels
+ * - Override levelLog and levelLogHook for a single source file
+ * - Entries are never removed. A level < 0 disables the override
+ */
+struct LogLevelFile
+{
+	char filename[32];
+#if CONFIG_PROC_HAVE_DRIVERS
+	atomic<int> level;
+#else
+	int level;
+#endif
+};
+
+static LogLevelFile levelsFile[CONFIG_PROC_LOG_NUM_LEVELS_FILE];
+#if CONFIG_PROC_HAVE_DRIVERS
+static atomic<int> numLevelsFile(0);
+#else
+static int numLevelsFile = 0;
+#endif
+
+/*
+ * Binary mode
+ * - Records: u8 type, u16 len, payload. Little endian
+ * - Strings are referenced by ID and defined once per stream
+ * - See tools/logdecode for the format
+ */
+enum LogBinaryRecordType
+{
+	LbrHeader = 0xB0,
+	LbrString,
+	LbrEntry,
+};
+
+const uint8_t cLogBinaryVersion = 1;
+const size_t cLogBinaryBufferSize = cLogEntryBufferSize + 64;
+
+struct LogBinaryString
+{
+	const char *pStr;
+	uint32_t id;
+};
+
+static FuncLogBinaryWrite pFctLogBinaryWrite = NULL;
+static FuncEntryLogStructured pFctEntryLogStructured = NULL;
+static LogBinaryString stringsBinary[CONFIG_PROC_LOG_NUM_STRINGS_BINARY];
+static size_t numStringsBinary = 0;
+static uint32_t idStringBinaryNext = 1;
+
+const int cLogSeverityMax = 5;
+
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+/*
+ * Rate limiting
+ * - Token bucket per call site. Call sites are identified
+ *   by the address of the format string and the line
+ * - Tokens are stored in thousandths
+ */
+struct LogRateLimit
+{
+	uint32_t ratePerSec;
+	uint32_t burst;
+};
+
+struct LogCallSite
+{
+	const char *msg;
+	int line;
+	uint64_t tokensMilli;
+	steady_clock::time_point tRefill;
+	uint32_t numSuppressed;
+
+	// Prefix of the summary
+	int severity;
+	const void *pProc;
+	const char *filename;
+	const char *function;
+};
+
+static LogRateLimit rateLimits[cLogSeverityMax + 1] = {};
+static LogCallSite callSites[CONFIG_PROC_LOG_NUM_SITES_LIMITED] = {};
+#if CONFIG_PROC_HAVE_DRIVERS
+static mutex mtxCallSites;
+#endif
+#endif
+
+/*
+ * Repeat collapsing
+ * - Consecutive entries with identical call site, process
+ *   and text are counted instead of written
+ * mtxPrint must be locked when used
+ */
+struct LogRepeat
+{
+	LogEntry entry;
+	const char *fmt;
+	uint8_t sinks;
+	uint32_t hash;
+	uint32_t cnt;
+	uint64_t tMonoUsLast;
+};
+
+static bool repeatsCollapsed[cLogSeverityMax + 1] = {};
+static LogRepeat repeatLast = {};
+static bool summariesExitFlushSet = false;
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+#if CONFIG_PROC_HAVE_DRIVERS
+static atomic<int64_t> tSummariesCheckedMs(0);
+#else
+static int64_t tSummariesCheckedMs = 0;
+#endif
+#endif
+
+static void summariesFlush(bool force);
+static void summariesFlushIfDue();
+
+#if dLogHaveAsync
+/*
+ * Asynchronous backend
+ * - Each producer thread owns a single producer single consumer ring
+ * - Producers only format the user message into the ring
+ * - The writer thread creates the prefix, prints the entries
+ *   in batches and flushes the streams once per batch
+ */
+struct LogRecord
+{
+	int severity;
+	const void *pProc;
+	const char *procName;
+	const char *filename;
+	const char *function;
+	const char *fmt;
+	int line;
+	int16_t code;
+	uint8_t sinks;
+	bool hasCntTime;
+	uint32_t cntTime;
+	system_clock::time_point t;
+	int64_t tDiffMs;
+	uint64_t tMonoUs;
+	uint16_t len;
+	char msg[cLogEntryBufferSize];
+};
+
+struct LogRing
+{
+	LogRecord *pRecords;
+	size_t mask;
+	atomic<size_t> idxWr;
+	atomic<size_t> idxRd;
+	atomic<uint32_t> numDropped;
+	uint32_t numDroppedReported;
+	atomic<bool> orphaned;
+	LogRing *pNext;
+};
+
+struct LogRingOwner
+{
+	LogRing *pRing;
+
+	~LogRingOwner()
+	{
+		// Freed by writer when empty
+		if (pRing)
+			pRing->orphaned.store(true, memory_order_release);
+	}
+};
+
+static thread_local LogRingOwner ringOwner = { NULL };
+static LogRing *pRingsAsync = NULL;
+static mutex mtxRings;
+static thread *pThdWriter = NULL;
+static atomic<bool> asyncActive(false);
+static atomic<bool> asyncStopReq(false);
+static atomic<uint32_t> numAsyncProducers(0);
+static atomic<uint32_t> numDroppedTotal(0);
+static size_t sizeRingAsync = 128;
+static LogOverflowPolicy policyOverflow = LogOverflowDrop;
+static size_t sleepWriterUs = 2000;
+
+static bool entryLogAsyncEnqueue(
+			const int severity,
+			const void *pProc,
+			const char *filename,
+			const char *function,
+			const int line,
+			const int16_t code,
+			const uint8_t sinks,
+			const uint32_t numSuppressed,
+			const char *msg,
+			va_list args);
+static size_t ringsDrain(char *pBuf, size_t sizeBuf);
+static void entryLogAsyncWrite();
+#endif
+
 void levelLogSet(int lvl)
 {
 	levelLog = lvl;
 }
 
+void levelLogHookSet(int lvl)
+{
+	levelLogHook = lvl;
+}
+
+static int levelFileGet(const char *filename)
+{
+	int numLevels = numLevelsFile;
+
+	if (!numLevels || !filename)
+		return -1;
+
+	for (int i = 0; i < numLevels; ++i)
+	{
+		if (strcmp(levelsFile[i].filename, filename))
+			continue;
+
+		return levelsFile[i].level;
+	}
+
+	return -1;
+}
+
+bool levelLogFileSet(const char *filename, int lvl)
+{
+	if (!filename || !*filename)
+		return false;
+
+	if (strlen(filename) >= sizeof(levelsFile[0].filename))
+		return false;
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+	int numLevels = numLevelsFile;
+
+	if (lvl < 0)
+		lvl = -1;
+
+	for (int i = 0; i < numLevels; ++i)
+	{
+		if (strcmp(levelsFile[i].filename, filename))
+			continue;
+
+		levelsFile[i].level = lvl;
+		return true;
+	}
+
+	if (lvl < 0)
+		return true;
+
+	if (numLevels >= CONFIG_PROC_LOG_NUM_LEVELS_FILE)
+		return false;
+
+	strcpy(levelsFile[numLevels].filename, filename);
+	levelsFile[numLevels].level = lvl;
+
+	// Readers don't lock. Publish the entry last
+	numLevelsFile = numLevels + 1;
+
+	return true;
+}
+
+/*
+ * Decides which sinks receive an entry
+ * Return
+ *   LogSinkBits
+ */
+static uint8_t sinksGet(const int severity, const char *filename)
+{
+	int lvlFile = levelFileGet(filename);
+	uint8_t sinks = 0;
+
+	if (severity <= (lvlFile >= 0 ? lvlFile : levelLog))
+		sinks |= LsbStdout;
+
+	if (severity <= (lvlFile >= 0 ? lvlFile : levelLogHook))
+	{
+		if (pFctEntryLogCreate)
+			sinks |= LsbHook;
+
+		if (pFctEntryLogStructured)
+			sinks |= LsbStructured;
+	}
+#if CONFIG_PROC_LOG_HAVE_DISK
+	if (diskActive &&
+			severity <= (lvlFile >= 0 ? lvlFile : levelLogDisk))
+		sinks |= LsbDisk;
+#endif
+	return sinks;
+}
+
+bool levelLogEnabled(const int severity, const char *filename)
+{
+	return sinksGet(severity, filename);
+}
+
+void levelLogDiskSet(int lvl)
+{
+	levelLogDisk = lvl;
+}
+
 void entryLogCreateSet(FuncEntryLogCreate pFct)
 {
 	pFctEntryLogCreate = pFct;
 }
 
+void entryLogStructuredSet(FuncEntryLogStructured pFct)
+{
+	pFctEntryLogStructured = pFct;
+}
+
 void cntTimeCreateSet(FuncCntTimeCreate pFct, int width)
 {
 	if (width < -20 || width > 20)
@@ -182,72 +582,148 @@ int16_t entryLogSimpleCreate(
 	return code;
 }
 
-int16_t entryLogCreate(
-			const int severity,
-			const void *pProc,
-			const char *filename,
-			const char *function,
-			const int line,
-			const int16_t code,
-			const char *msg, ...)
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+/*
+ * Only needed once per second
+ * mtxPrint must be locked by caller!
+ */
+static void timeCacheUpdate(time_t tSec)
 {
-#if CONFIG_PROC_HAVE_DRIVERS
-	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+	tm tTm {};
+#ifdef _WIN32
+	::localtime_s(&tTm, &tSec);
+#else
+	::localtime_r(&tSec, &tTm);
 #endif
-	char *pBufStart = (char *)malloc(cLogEntryBufferSize);
-	if (!pBufStart)
-		return code;
+	char *pBuf = timeCache.str;
+	char *pBufEnd = pBuf + sizeof(timeCache.str);
+	size_t len;
 
-	char *pBuf = pBufStart;
-	char *pBufEnd = pBuf + cLogEntryBufferSize - 1;
+	len = strftime(pBuf, pBufEnd - pBuf, "%Y-%m-%d", &tTm);
+	pBuf += len;
 
-	*pBuf = 0;
-	*pBufEnd = 0;
+	// Time of day is based on the epoch. Same as before the cache
+	int secDay = int(tSec % 86400);
 
-#if CONFIG_PROC_LOG_HAVE_CHRONO
-	// get time
-	system_clock::time_point t = system_clock::now();
-	milliseconds durDiffMs = duration_cast<milliseconds>(t - tOld);
+	snprintf(pBuf, pBufEnd - pBuf, "  %02d:%02d:%02d",
+			secDay / 3600, secDay / 60 % 60, secDay % 60);
 
-	// build day
-	time_t tTt = system_clock::to_time_t(t);
-	char timeBuf[32];
-	tm tTm {};
-#ifdef _WIN32
-	::localtime_s(&tTm, &tTt);
-#else
-	::localtime_r(&tTt, &tTm);
-#endif
-	strftime(timeBuf, sizeof(timeBuf), "%Y-%m-%d", &tTm);
+	timeCache.tSec = tSec;
+}
+
+/*
+ * Time difference to the previous printed entry of the calling thread.
+ * Uses a monotonic clock so changes of the system time don't matter
+ */
+static int64_t diffMsGet(const steady_clock::time_point &t, bool update)
+{
+	static dThreadLocal steady_clock::time_point tOld;
+	static dThreadLocal bool tOldValid = false;
+	int64_t tDiffMs = cDiffMsInvalid;
+
+	if (tOldValid)
+		tDiffMs = duration_cast<milliseconds>(t - tOld).count();
 
-	// build time
-	system_clock::duration dur = t.time_since_epoch();
+	if (!update)
+		return tDiffMs;
 
-	hours durDays = duration_cast<hours>(dur) / 24;
-	dur -= durDays * 24;
+	tOld = t;
+	tOldValid = true;
 
-	hours durHours = duration_cast<hours>(dur);
-	dur -= durHours;
+	return tDiffMs;
+}
+
+static uint64_t usGet(const system_clock::time_point &t)
+{
+	return duration_cast<microseconds>(t.time_since_epoch()).count();
+}
+
+static uint64_t usGet(const steady_clock::time_point &t)
+{
+	return duration_cast<microseconds>(t.time_since_epoch()).count();
+}
+#endif
 
-	minutes durMinutes = duration_cast<minutes>(dur);
-	dur -= durMinutes;
+// pProc is only set by the proc*Log() macros
+/*
+ * pProc must be NULL or point to a Processing.
+ * The name is only read if a sink outputs it
+ */
+static const char *procNameGetLog(const void *pProc, const uint8_t sinks)
+{
+	bool nameUsed = sinks & LsbStructured;
+#if CONFIG_PROC_LOG_HAVE_DISK
+	if ((sinks & LsbDisk) && encodingDisk != LogEncText)
+		nameUsed = true;
+#endif
+	if (!pProc || !nameUsed)
+		return NULL;
+
+	return Processing::procNameGet((const Processing *)pProc);
+}
+
+static void entryInit(LogEntry &entry,
+			const int severity,
+			const void *pProc,
+			const char *procName,
+			const char *filename,
+			const char *function,
+			const int line,
+			const int16_t code,
+			const uint64_t tWallUs,
+			const uint64_t tMonoUs)
+{
+	entry.severity = severity;
+	entry.pProc = pProc;
+	entry.procName = procName;
+	entry.filename = filename;
+	entry.function = function;
+	entry.line = line;
+	entry.code = code;
+	entry.tWallUs = tWallUs;
+	entry.tMonoUs = tMonoUs;
+	entry.text = "";
+	entry.lenText = 0;
+	entry.msg = "";
+	entry.lenMsg = 0;
+}
 
-	seconds durSecs = duration_cast<seconds>(dur);
-	dur -= durSecs;
+/*
+ * Creates the prefix of a log entry
+ *   Date, time, time difference, optional counter time,
+ *   severity, function, process and location
+ * mtxPrint must be locked by caller!
+ */
+static int entryPrefixCreate(
+			char * &pBuf, char *pBufEnd,
+			const int severity,
+			const void *pProc,
+			const char *filename,
+			const char *function,
+			const int line,
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+			const system_clock::time_point &t,
+			const int64_t tDiffMs,
+#endif
+			const bool hasCntTime,
+			const uint32_t cntTime)
+{
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+	int64_t tMs = duration_cast<milliseconds>(t.time_since_epoch()).count();
+	time_t tSec = (time_t)(tMs / 1000);
 
-	milliseconds durMillis = duration_cast<milliseconds>(dur);
-	dur -= durMillis;
+	if (tSec != timeCache.tSec)
+		timeCacheUpdate(tSec);
 
 	// build diff
-	long long tDiff = durDiffMs.count();
-	int tDiffSec = int(tDiff / 1000);
-	int tDiffMs = int(tDiff % 1000);
+	int tDiffSec = int(tDiffMs / 1000);
+	int tDiffMsRem = int(tDiffMs % 1000);
 	bool diffMaxed = false;
 
-	if (tDiffSec > cDiffSecMax)
+	if (tDiffMs < 0 || tDiffSec > cDiffSecMax)
 	{
 		tDiffSec = cDiffSecMax;
-		tDiffMs = cDiffMsMax;
+		tDiffMsRem = cDiffMsMax;
 
 		diffMaxed = true;
 	}
@@ -257,25 +733,21 @@ int16_t entryLogCreate(
 
 #if CONFIG_PROC_LOG_HAVE_CHRONO
 	lenDone = snprintf(pBuf, pBufEnd - pBuf,
-					"%s  %02d:%02d:%02d.%03d "
+					"%s.%03d "
 					"%c%d.%03d  ",
-					timeBuf,
-					int(durHours.count()), int(durMinutes.count()),
-					int(durSecs.count()), int(durMillis.count()),
-					diffMaxed ? '>' : '+', tDiffSec, tDiffMs);
+					timeCache.str, int(tMs % 1000),
+					diffMaxed ? '>' : '+', tDiffSec, tDiffMsRem);
 	if (pBufSaturate(lenDone, pBuf, pBufEnd) < 0)
-		goto exitLogEntryCreate;
+		return -1;
 #endif
-	if (pFctCntTimeCreate)
+	if (hasCntTime)
 	{
-		uint32_t cntTime = pFctCntTimeCreate();
-
 		lenDone = snprintf(pBuf, pBufEnd - pBuf,
 						"%*" PRIu32 "  ",
 						widthCntTime, cntTime);
 
 		if (pBufSaturate(lenDone, pBuf, pBufEnd) < 0)
-			goto exitLogEntryCreate;
+			return -1;
 	}
 
 	if (pProc)
@@ -294,7 +766,7 @@ int16_t entryLogCreate(
 	}
 
 	if (pBufSaturate(lenDone, pBuf, pBufEnd) < 0)
-		goto exitLogEntryCreate;
+		return -1;
 
 	// prefix padding
 	while (lenDone < lenPrefix2 && pBuf < pBufEnd)
@@ -303,77 +775,1569 @@ int16_t entryLogCreate(
 		++lenDone;
 	}
 
-	// user msg
-	va_list args;
-
-	va_start(args, msg);
-	lenDone = vsnprintf(pBuf, pBufEnd - pBuf, msg, args);
-	if (pBufSaturate(lenDone, pBuf, pBufEnd) < 0)
-	{
-		va_end(args);
-		goto exitLogEntryCreate;
-	}
-	va_end(args);
+	return 0;
+}
 
 #if CONFIG_PROC_LOG_HAVE_STDOUT
-	// create log entry
-	if (severity <= levelLog)
-	{
-#if CONFIG_PROC_LOG_HAVE_CHRONO
-		tOld = t;
-#endif
+static void entryPrint(const int severity, const char *pBufStart)
+{
 #ifdef _WIN32
-		HANDLE hConsole = GetStdHandle(severity < 3 ? STD_ERROR_HANDLE : STD_OUTPUT_HANDLE);
-		CONSOLE_SCREEN_BUFFER_INFO infoConsole;
+	HANDLE hConsole = GetStdHandle(severity < 3 ? STD_ERROR_HANDLE : STD_OUTPUT_HANDLE);
+	CONSOLE_SCREEN_BUFFER_INFO infoConsole;
 
-		GetConsoleScreenBufferInfo(hConsole, &infoConsole);
+	GetConsoleScreenBufferInfo(hConsole, &infoConsole);
 
-		WORD colorBkup = infoConsole.wAttributes;
+	WORD colorBkup = infoConsole.wAttributes;
 
-		if (severity == 1)
-		{
-			SetConsoleTextAttribute(hConsole, red);
-			fprintf(stderr, "%s\r\n", pBufStart);
-			SetConsoleTextAttribute(hConsole, colorBkup);
-		}
-		else
-		if (severity == 2)
-		{
-			SetConsoleTextAttribute(hConsole, yellow);
-			fprintf(stderr, "%s\r\n", pBufStart);
-			SetConsoleTextAttribute(hConsole, colorBkup);
-		}
-		else
-		if (severity >= 4)
-		{
-			SetConsoleTextAttribute(hConsole, cyan);
-			fprintf(stdout, "%s\r\n", pBufStart);
-			SetConsoleTextAttribute(hConsole, colorBkup);
-		}
-		else
-		{
-			SetConsoleTextAttribute(hConsole, dColorInfo);
-			fprintf(stdout, "%s\r\n", pBufStart);
-			SetConsoleTextAttribute(hConsole, colorBkup);
-		}
+	if (severity == 1)
+	{
+		SetConsoleTextAttribute(hConsole, red);
+		fprintf(stderr, "%s\r\n", pBufStart);
+		SetConsoleTextAttribute(hConsole, colorBkup);
+	}
+	else
+	if (severity == 2)
+	{
+		SetConsoleTextAttribute(hConsole, yellow);
+		fprintf(stderr, "%s\r\n", pBufStart);
+		SetConsoleTextAttribute(hConsole, colorBkup);
+	}
+	else
+	if (severity >= 4)
+	{
+		SetConsoleTextAttribute(hConsole, cyan);
+		fprintf(stdout, "%s\r\n", pBufStart);
+		SetConsoleTextAttribute(hConsole, colorBkup);
+	}
+	else
+	{
+		SetConsoleTextAttribute(hConsole, dColorInfo);
+		fprintf(stdout, "%s\r\n", pBufStart);
+		SetConsoleTextAttribute(hConsole, colorBkup);
+	}
+#else
+	if (severity == 1)
+		fprintf(stderr, "%s%s%s\r\n", red, pBufStart, dColorDefault);
+	else
+	if (severity == 2)
+		fprintf(stderr, "%s%s%s\r\n", yellow, pBufStart, dColorDefault);
+	else
+	if (severity >= 4)
+		fprintf(stdout, "%s%s%s\r\n", cyan, pBufStart, dColorDefault);
+	else
+		fprintf(stdout, "%s%s%s\r\n", dColorInfo, pBufStart, dColorDefault);
+#endif
+}
+#endif
+
+/*
+ * Encoding of structured entries
+ */
+static void strEscapedPut(char * &pBuf, char *pBufEnd,
+						const char *pStr, size_t len, bool quoted)
+{
+	const char *pStrEnd = pStr + len;
+	int lenDone;
+	char ch;
+
+	if (quoted && pBuf < pBufEnd)
+		*pBuf++ = '"';
+
+	for (; pStr < pStrEnd && pBuf < pBufEnd; ++pStr)
+	{
+		ch = *pStr;
+
+		if (ch == '"' || ch == '\\')
+		{
+			lenDone = snprintf(pBuf, pBufEnd - pBuf, "\\%c", ch);
+			pBufSaturate(lenDone, pBuf, pBufEnd);
+			continue;
+		}
+
+		if (ch == '\n' || ch == '\r' || ch == '\t')
+		{
+			lenDone = snprintf(pBuf, pBufEnd - pBuf, "\\%c",
+							ch == '\n' ? 'n' : ch == '\r' ? 'r' : 't');
+			pBufSaturate(lenDone, pBuf, pBufEnd);
+			continue;
+		}
+
+		if ((uint8_t)ch < 0x20)
+		{
+			lenDone = snprintf(pBuf, pBufEnd - pBuf, "\\u%04x", (unsigned)ch);
+			pBufSaturate(lenDone, pBuf, pBufEnd);
+			continue;
+		}
+
+		*pBuf++ = ch;
+	}
+
+	if (quoted && pBuf < pBufEnd)
+		*pBuf++ = '"';
+
+	*pBuf = 0;
+}
+
+// logfmt values only need quotes if they contain special characters
+static bool logfmtQuotingRequired(const char *pStr, size_t len)
+{
+	if (!len)
+		return true;
+
+	for (size_t i = 0; i < len; ++i)
+	{
+		if ((uint8_t)pStr[i] <= ' ' || pStr[i] == '=' ||
+				pStr[i] == '"' || pStr[i] == '\\')
+			return true;
+	}
+
+	return false;
+}
+
+static void fieldStrPut(char * &pBuf, char *pBufEnd, LogEncoding enc,
+						const char *pKey, const char *pStr, size_t len)
+{
+	int lenDone;
+	bool quoted = true;
+
+	if (enc == LogEncJson)
+		lenDone = snprintf(pBuf, pBufEnd - pBuf, ",\"%s\":", pKey);
+	else
+	{
+		lenDone = snprintf(pBuf, pBufEnd - pBuf, " %s=", pKey);
+		quoted = logfmtQuotingRequired(pStr, len);
+	}
+
+	if (pBufSaturate(lenDone, pBuf, pBufEnd) < 0)
+		return;
+
+	strEscapedPut(pBuf, pBufEnd, pStr, len, quoted);
+}
+
+/*
+ * Return
+ *   Length of the encoded entry without terminating zero
+ */
+size_t logEntryEncode(char *pBuf, char *pBufEnd,
+				const LogEntry *pEntry, LogEncoding enc)
+{
+	char *pBufStart = pBuf;
+	int lenDone;
+
+	if (!pBuf || pBuf >= pBufEnd)
+		return 0;
+
+	--pBufEnd; // terminating zero
+	*pBuf = 0;
+
+	if (enc == LogEncText)
+	{
+		lenDone = snprintf(pBuf, pBufEnd - pBuf + 1, "%s", pEntry->text);
+		pBufSaturate(lenDone, pBuf, pBufEnd);
+
+		return pBuf - pBufStart;
+	}
+
+	const char *pFmt = enc == LogEncJson ?
+				"{\"t\":%" PRIu64 ",\"mono\":%" PRIu64 ",\"sev\":\"%s\",\"lvl\":%d" :
+				"t=%" PRIu64 " mono=%" PRIu64 " sev=%s lvl=%d";
+
+	lenDone = snprintf(pBuf, pBufEnd - pBuf + 1, pFmt,
+					pEntry->tWallUs, pEntry->tMonoUs,
+					severityToStr(pEntry->severity), pEntry->severity);
+	pBufSaturate(lenDone, pBuf, pBufEnd);
+
+	if (pEntry->pProc)
+	{
+		char bufProc[24];
+
+		snprintf(bufProc, sizeof(bufProc), "%p", pEntry->pProc);
+		fieldStrPut(pBuf, pBufEnd, enc, "proc", bufProc, strlen(bufProc));
+	}
+
+	if (pEntry->procName)
+		fieldStrPut(pBuf, pBufEnd, enc, "name",
+				pEntry->procName, strlen(pEntry->procName));
+
+	fieldStrPut(pBuf, pBufEnd, enc, "file",
+				pEntry->filename, strlen(pEntry->filename));
+	fieldStrPut(pBuf, pBufEnd, enc, "func",
+				pEntry->function, strlen(pEntry->function));
+
+	pFmt = enc == LogEncJson ? ",\"line\":%d,\"code\":%d" : " line=%d code=%d";
+
+	lenDone = snprintf(pBuf, pBufEnd - pBuf + 1, pFmt,
+					pEntry->line, (int)pEntry->code);
+	pBufSaturate(lenDone, pBuf, pBufEnd);
+
+	fieldStrPut(pBuf, pBufEnd, enc, "msg", pEntry->msg, pEntry->lenMsg);
+
+	if (enc == LogEncJson && pBuf < pBufEnd)
+		*pBuf++ = '}';
+
+	*pBuf = 0;
+
+	return pBuf - pBufStart;
+}
+
+#if CONFIG_PROC_LOG_HAVE_DISK
+/*
+ * Disk sink
+ * mtxPrint must be locked by caller!
+ */
+static void diskBufferWrite()
+{
+	size_t lenWritten;
+
+	if (disk.lenBuf)
+	{
+		lenWritten = fwrite(disk.pBuf, 1, disk.lenBuf, disk.pFile);
+
+		// Entries are lost. Reported once per failure period
+		if (lenWritten < disk.lenBuf)
+		{
+			++disk.numWritesShort;
+
+			if (!disk.writeFailed)
+				fprintf(stderr, "could not write log file %s: %s\n",
+						disk.pFilename, strerror(errno));
+
+			disk.writeFailed = true;
+			clearerr(disk.pFile);
+		}
+		else
+			disk.writeFailed = false;
+
+		disk.lenBuf = 0;
+	}
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+	disk.tFlushed = steady_clock::now();
+#endif
+}
+
+// Without the async writer a time based flush needs a new entry
+static void diskExitFlush()
+{
+	summariesFlush(true);
+	logDiskFlush();
+}
+
+static bool diskFileOpen()
+{
+	disk.pFile = fopen(disk.pFilename, "ab");
+	if (!disk.pFile)
+		return false;
+
+	// We do the buffering
+	setvbuf(disk.pFile, NULL, _IONBF, 0);
+
+	fseek(disk.pFile, 0, SEEK_END);
+
+	long pos = ftell(disk.pFile);
+	disk.sizeFile = pos > 0 ? (size_t)pos : 0;
+#if defined(__linux__)
+	// Blocks beyond EOF. Readers don't see zeros
+	if (disk.preallocate && disk.sizeFile < disk.sizeFileMax)
+		fallocate(fileno(disk.pFile), FALLOC_FL_KEEP_SIZE,
+				0, disk.sizeFileMax);
+#endif
+	return true;
+}
+
+static void diskFileClose()
+{
+	if (!disk.pFile)
+		return;
+
+	diskBufferWrite();
+#if defined(__linux__)
+	// Release unused preallocated blocks
+	if (disk.preallocate && !fflush(disk.pFile))
+	{
+		if (ftruncate(fileno(disk.pFile), disk.sizeFile))
+		{
+			// Blocks stay allocated. Nothing else to do
+		}
+	}
+#endif
+	fclose(disk.pFile);
+	disk.pFile = NULL;
+}
+
+static void diskRotate()
+{
+	size_t lenName = strlen(disk.pFilename) + 24;
+	char *pNameSrc = (char *)malloc(lenName);
+	char *pNameDst = (char *)malloc(lenName);
+
+	diskFileClose();
+
+	if (!pNameSrc || !pNameDst)
+		goto exitDiskRotate;
+
+	if (disk.numFiles <= 1)
+	{
+		remove(disk.pFilename);
+		goto exitDiskRotate;
+	}
+
+	snprintf(pNameDst, lenName, "%s.%zu", disk.pFilename, disk.numFiles - 1);
+	remove(pNameDst);
+
+	for (size_t i = disk.numFiles - 1; i > 0; --i)
+	{
+		if (i == 1)
+			snprintf(pNameSrc, lenName, "%s", disk.pFilename);
+		else
+			snprintf(pNameSrc, lenName, "%s.%zu", disk.pFilename, i - 1);
+
+		snprintf(pNameDst, lenName, "%s.%zu", disk.pFilename, i);
+		rename(pNameSrc, pNameDst);
+	}
+
+exitDiskRotate:
+	free(pNameSrc);
+	free(pNameDst);
+
+	diskFileOpen();
+}
+
+static void diskWrite(const int severity, const char *pEntry, size_t len)
+{
+	if (!disk.pFile)
+		return;
+
+	if (len > CONFIG_PROC_LOG_DISK_BUFFER_SIZE - 1)
+		len = CONFIG_PROC_LOG_DISK_BUFFER_SIZE - 1;
+
+	if (disk.sizeFile && disk.sizeFile + len + 1 > disk.sizeFileMax)
+	{
+		diskRotate();
+		if (!disk.pFile)
+			return;
+	}
+
+	if (disk.lenBuf + len + 1 > CONFIG_PROC_LOG_DISK_BUFFER_SIZE)
+		diskBufferWrite();
+
+	memcpy(disk.pBuf + disk.lenBuf, pEntry, len);
+	disk.lenBuf += len;
+	disk.pBuf[disk.lenBuf++] = '\n';
+
+	disk.sizeFile += len + 1;
+
+	if (severity <= levelDiskFlush)
+	{
+		diskBufferWrite();
+		return;
+	}
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+	if (steady_clock::now() - disk.tFlushed >= milliseconds(diskFlushIntervalMs))
+		diskBufferWrite();
+#endif
+}
+
+static void diskEntryWrite(const LogEntry *pEntry)
+{
+	static char bufEncoded[2 * cLogEntryBufferSize];
+	size_t len;
+
+	if (encodingDisk == LogEncText)
+	{
+		diskWrite(pEntry->severity, pEntry->text, pEntry->lenText);
+		return;
+	}
+
+	len = logEntryEncode(bufEncoded, bufEncoded + sizeof(bufEncoded),
+						pEntry, encodingDisk);
+
+	diskWrite(pEntry->severity, bufEncoded, len);
+}
+
+#if dLogHaveAsync
+// Used by the writer thread while idle
+static void diskFlushIfDue()
+{
+	if (!disk.pFile || !disk.lenBuf)
+		return;
+
+	if (steady_clock::now() - disk.tFlushed < milliseconds(diskFlushIntervalMs))
+		return;
+
+	diskBufferWrite();
+}
+#endif
+
+bool logDiskStart(const char *filename,
+				size_t sizeFileMax,
+				size_t numFiles,
+				bool preallocate)
+{
+	if (!filename || !*filename || !sizeFileMax)
+		return false;
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+	if (disk.pFile)
+		return false;
+
+	disk.pFilename = (char *)malloc(strlen(filename) + 1);
+	disk.pBuf = (char *)malloc(CONFIG_PROC_LOG_DISK_BUFFER_SIZE);
+
+	if (!disk.pFilename || !disk.pBuf)
+		goto errDiskStart;
+
+	strcpy(disk.pFilename, filename);
+
+	disk.lenBuf = 0;
+	disk.sizeFileMax = sizeFileMax;
+	disk.numFiles = numFiles;
+	disk.preallocate = preallocate;
+	disk.writeFailed = false;
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+	disk.tFlushed = steady_clock::now();
+#endif
+	if (!diskFileOpen())
+		goto errDiskStart;
+
+	if (!disk.exitFlushSet && !atexit(diskExitFlush))
+		disk.exitFlushSet = true;
+
+	diskActive = true;
+
+	return true;
+
+errDiskStart:
+	free(disk.pFilename);
+	disk.pFilename = NULL;
+
+	free(disk.pBuf);
+	disk.pBuf = NULL;
+
+	return false;
+}
+
+void logDiskStop()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+	diskActive = false;
+	diskFileClose();
+
+	free(disk.pFilename);
+	disk.pFilename = NULL;
+
+	free(disk.pBuf);
+	disk.pBuf = NULL;
+}
+
+void logDiskFlush()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+	if (!disk.pFile)
+		return;
+
+	diskBufferWrite();
+}
+
+uint32_t logDiskWritesShortCnt()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+	return disk.numWritesShort;
+}
+
+void logDiskFlushSet(uint32_t intervalMs, int levelFlush)
+{
+	diskFlushIntervalMs = intervalMs;
+	levelDiskFlush = levelFlush;
+}
+
+void logDiskEncodingSet(LogEncoding enc)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+	encodingDisk = enc;
+}
+#else
+bool logDiskStart(const char *filename,
+				size_t sizeFileMax,
+				size_t numFiles,
+				bool preallocate)
+{
+	(void)filename;
+	(void)sizeFileMax;
+	(void)numFiles;
+	(void)preallocate;
+
+	return false;
+}
+
+void logDiskStop()
+{
+}
+
+void logDiskFlush()
+{
+}
+
+uint32_t logDiskWritesShortCnt()
+{
+	return 0;
+}
+
+void logDiskFlushSet(uint32_t intervalMs, int levelFlush)
+{
+	(void)intervalMs;
+	(void)levelFlush;
+}
+
+void logDiskEncodingSet(LogEncoding enc)
+{
+	(void)enc;
+}
+#endif
+
+/*
+ * Writes a formatted entry to the selected sinks
+ * mtxPrint must be locked by caller!
+ */
+static void entryOutput(const uint8_t sinks, const LogEntry *pEntry)
+{
+#if CONFIG_PROC_LOG_HAVE_STDOUT
+	if (sinks & LsbStdout)
+		entryPrint(pEntry->severity, pEntry->text);
+#endif
+#if CONFIG_PROC_LOG_HAVE_DISK
+	if (sinks & LsbDisk)
+		diskEntryWrite(pEntry);
+#endif
+	if ((sinks & LsbHook) && pFctEntryLogCreate)
+		pFctEntryLogCreate(pEntry->severity,
+			pEntry->pProc, pEntry->filename, pEntry->function,
+			pEntry->line, pEntry->code,
+			pEntry->text, pEntry->lenText);
+
+	if ((sinks & LsbStructured) && pFctEntryLogStructured)
+		pFctEntryLogStructured(pEntry);
+}
+
+static void summariesExitFlush()
+{
+	summariesFlush(true);
+	logDiskFlush();
+}
+
+static void summariesExitFlushRegister()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+	if (!summariesExitFlushSet && !atexit(summariesExitFlush))
+		summariesExitFlushSet = true;
+}
+
+void logRateLimitSet(int severity, uint32_t ratePerSec, uint32_t burst)
+{
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+	if (severity < 0 || severity > cLogSeverityMax)
+		return;
+
+	summariesExitFlushRegister();
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxCallSites);
+#endif
+	if (!burst)
+		burst = 1;
+
+	for (int lvl = 1; lvl <= cLogSeverityMax; ++lvl)
+	{
+		if (severity && lvl != severity)
+			continue;
+
+		rateLimits[lvl].ratePerSec = ratePerSec;
+		rateLimits[lvl].burst = burst;
+	}
+
+	// Start with full buckets
+	for (size_t i = 0; i < CONFIG_PROC_LOG_NUM_SITES_LIMITED; ++i)
+		callSites[i] = LogCallSite();
+#else
+	(void)severity;
+	(void)ratePerSec;
+	(void)burst;
+#endif
+}
+
+void logRepeatCollapseSet(int severity, bool collapse)
+{
+	if (severity < 0 || severity > cLogSeverityMax)
+		return;
+
+	summariesExitFlushRegister();
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+	for (int lvl = 1; lvl <= cLogSeverityMax; ++lvl)
+	{
+		if (severity && lvl != severity)
+			continue;
+
+		repeatsCollapsed[lvl] = collapse;
+	}
+}
+
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+/*
+ * Return
+ *   true  .. Entry may be created. numSuppressed contains the number
+ *            of entries dropped at this call site since the last one
+ *   false .. Entry must be dropped
+ */
+static void siteRefill(LogCallSite &site, const LogRateLimit &limit,
+						const steady_clock::time_point &tNow)
+{
+	int64_t durMs = duration_cast<milliseconds>(tNow - site.tRefill).count();
+
+	if (durMs <= 0)
+		return;
+
+	site.tokensMilli += (uint64_t)durMs * limit.ratePerSec;
+	site.tRefill += milliseconds(durMs);
+
+	if (site.tokensMilli > (uint64_t)limit.burst * 1000)
+		site.tokensMilli = (uint64_t)limit.burst * 1000;
+}
+
+static bool rateLimitPass(const int severity, const void *pProc,
+						const char *filename, const char *function,
+						const char *msg, const int line,
+						uint32_t &numSuppressed)
+{
+	numSuppressed = 0;
+
+	if (severity < 1 || severity > cLogSeverityMax)
+		return true;
+
+	if (!rateLimits[severity].ratePerSec)
+		return true;
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxCallSites);
+#endif
+	const LogRateLimit &limit = rateLimits[severity];
+	const size_t numSites = CONFIG_PROC_LOG_NUM_SITES_LIMITED;
+	const size_t numProbesMax = 8;
+	steady_clock::time_point tNow = steady_clock::now();
+	size_t idxStart = (((uintptr_t)msg >> 2) ^ (size_t)line) % numSites;
+	size_t idx = idxStart;
+	LogCallSite *pSite = NULL;
+
+	for (size_t i = 0; i < numProbesMax; ++i, idx = (idx + 1) % numSites)
+	{
+		if (callSites[idx].msg == msg && callSites[idx].line == line)
+		{
+			pSite = &callSites[idx];
+			break;
+		}
+
+		if (!callSites[idx].msg)
+			break;
+	}
+
+	if (!pSite)
+	{
+		// New call site. Evicts an old one if necessary
+		if (callSites[idx].msg)
+			idx = idxStart;
+
+		pSite = &callSites[idx];
+
+		pSite->msg = msg;
+		pSite->line = line;
+		pSite->tokensMilli = (uint64_t)limit.burst * 1000;
+		pSite->tRefill = tNow;
+		pSite->numSuppressed = 0;
+	}
+
+	siteRefill(*pSite, limit, tNow);
+
+	if (pSite->tokensMilli < 1000)
+	{
+		++pSite->numSuppressed;
+
+		pSite->severity = severity;
+		pSite->pProc = pProc;
+		pSite->filename = filename;
+		pSite->function = function;
+
+		return false;
+	}
+
+	pSite->tokensMilli -= 1000;
+
+	numSuppressed = pSite->numSuppressed;
+	pSite->numSuppressed = 0;
+
+	return true;
+}
+#endif
+
+static void suppressedAppend(char * &pBuf, char *pBufEnd, uint32_t numSuppressed)
+{
+	if (!numSuppressed)
+		return;
+
+	int lenDone = snprintf(pBuf, pBufEnd - pBuf,
+					" (%" PRIu32 " similar entries suppressed)",
+					numSuppressed);
+	pBufSaturate(lenDone, pBuf, pBufEnd);
+}
+
+static uint32_t hashCreate(const char *pData, size_t len)
+{
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < len; ++i)
+	{
+		hash ^= (uint8_t)pData[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+ * Writes a summary with the prefix of the given entry
+ * mtxPrint must be locked by caller!
+ */
+static void summaryOutput(LogEntry &entry, const uint8_t sinks,
+			const char *fmt, const uint32_t cnt
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+			, const system_clock::time_point &t,
+			const int64_t tDiffMs
+#endif
+			)
+{
+	char *pBufStart = (char *)malloc(cLogEntryBufferSize);
+	if (!pBufStart)
+		return;
+
+	char *pBuf = pBufStart;
+	char *pBufEnd = pBuf + cLogEntryBufferSize - 1;
+	int lenDone;
+
+	*pBuf = 0;
+	*pBufEnd = 0;
+
+	lenDone = entryPrefixCreate(pBuf, pBufEnd,
+				entry.severity, entry.pProc,
+				entry.filename, entry.function, entry.line,
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+				t, tDiffMs,
+#endif
+				false, 0);
+	if (lenDone < 0)
+		goto exitSummaryOutput;
+
+	entry.msg = pBuf;
+
+	lenDone = snprintf(pBuf, pBufEnd - pBuf, fmt, cnt);
+	if (pBufSaturate(lenDone, pBuf, pBufEnd) < 0)
+		goto exitSummaryOutput;
+
+	entry.lenMsg = pBuf - entry.msg;
+	entry.text = pBufStart;
+	entry.lenText = pBuf - pBufStart;
+
+	entryOutput(sinks, &entry);
+
+exitSummaryOutput:
+	free(pBufStart);
+}
+
+/*
+ * Writes "last entry repeated N times" for the pending entry
+ * Time is taken from the current entry
+ * mtxPrint must be locked by caller!
+ */
+static void repeatsFlush(const LogEntry *pEntryCur
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+			, const system_clock::time_point &t,
+			const int64_t tDiffMs
+#endif
+			)
+{
+	if (!repeatLast.cnt)
+		return;
+
+	LogEntry entry = repeatLast.entry;
+
+	entry.tWallUs = pEntryCur->tWallUs;
+	entry.tMonoUs = pEntryCur->tMonoUs;
+
+	summaryOutput(entry, repeatLast.sinks,
+				"last entry repeated %" PRIu32 " times",
+				repeatLast.cnt
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+				, t, tDiffMs
+#endif
+				);
+
+	repeatLast.cnt = 0;
+}
+
+/*
+ * Repeats are summarized when no other entry followed in time
+ * mtxPrint must be locked by caller!
+ */
+static void repeatsFlushDue(bool force)
+{
+	if (!repeatLast.cnt)
+		return;
+
+	LogEntry entryCur = repeatLast.entry;
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+	system_clock::time_point t = system_clock::now();
+	steady_clock::time_point tMono = steady_clock::now();
+
+	entryCur.tWallUs = usGet(t);
+	entryCur.tMonoUs = usGet(tMono);
+
+	if (!force && entryCur.tMonoUs - repeatLast.tMonoUsLast <
+				(uint64_t)CONFIG_PROC_LOG_DELAY_SUMMARY_MS * 1000)
+		return;
+
+	repeatsFlush(&entryCur, t, diffMsGet(tMono, false));
+#else
+	if (!force)
+		return;
+
+	repeatsFlush(&entryCur);
+#endif
+}
+
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+/*
+ * Return
+ *   true  .. site contains a call site whose suppressed
+ *            entries must be summarized now
+ *   false .. Nothing left from idx on
+ */
+static bool siteSuppressedNext(size_t &idx, LogCallSite &site, bool force)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxCallSites);
+#endif
+	steady_clock::time_point tNow = steady_clock::now();
+	LogCallSite *pSite;
+
+	for (; idx < CONFIG_PROC_LOG_NUM_SITES_LIMITED; ++idx)
+	{
+		pSite = &callSites[idx];
+
+		if (!pSite->msg || !pSite->numSuppressed)
+			continue;
+
+		siteRefill(*pSite, rateLimits[pSite->severity], tNow);
+
+		// Next entry of this call site would report them
+		if (!force && pSite->tokensMilli < 1000)
+			continue;
+
+		site = *pSite;
+		pSite->numSuppressed = 0;
+		++idx;
+
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Writes the summaries of call sites which may log again
+ * but stayed silent
+ * mtxPrint must NOT be locked by caller!
+ */
+static void suppressedFlushDue(bool force)
+{
+	LogCallSite site;
+	size_t idx = 0;
+	uint8_t sinks;
+
+	while (siteSuppressedNext(idx, site, force))
+	{
+		sinks = sinksGet(site.severity, site.filename);
+		if (pFctLogBinaryWrite)
+			sinks &= ~LsbStdout;
+
+		if (!sinks)
+			continue;
+
+		system_clock::time_point t = system_clock::now();
+		steady_clock::time_point tMono = steady_clock::now();
+		LogEntry entry;
+
+		// Process may be gone already. Name isn't read
+		entryInit(entry, site.severity, site.pProc, NULL,
+				site.filename, site.function, site.line, 0,
+				usGet(t), usGet(tMono));
+#if CONFIG_PROC_HAVE_DRIVERS
+		lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+		summaryOutput(entry, sinks,
+					"%" PRIu32 " similar entries suppressed",
+					site.numSuppressed,
+					t, diffMsGet(tMono, false));
+	}
+}
+#endif
+
+/*
+ * Summaries which would wait for a later entry otherwise
+ * mtxPrint must NOT be locked by caller!
+ */
+static void summariesFlush(bool force)
+{
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+	suppressedFlushDue(force);
+#endif
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+	repeatsFlushDue(force);
+}
+
+// Checked a few times per summary delay at most
+static void summariesFlushIfDue()
+{
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+	int64_t tNowMs = duration_cast<milliseconds>(
+				steady_clock::now().time_since_epoch()).count();
+#if CONFIG_PROC_HAVE_DRIVERS
+	int64_t tCheckedMs = tSummariesCheckedMs.load(memory_order_relaxed);
+
+	if (tNowMs - tCheckedMs < CONFIG_PROC_LOG_DELAY_SUMMARY_MS / 4)
+		return;
+
+	// Single thread checks
+	if (!tSummariesCheckedMs.compare_exchange_strong(tCheckedMs, tNowMs))
+		return;
+#else
+	if (tNowMs - tSummariesCheckedMs < CONFIG_PROC_LOG_DELAY_SUMMARY_MS / 4)
+		return;
+
+	tSummariesCheckedMs = tNowMs;
+#endif
+
+	summariesFlush(false);
+#endif
+}
+
+/*
+ * Return
+ *   true  .. Entry is a repetition and has been counted
+ *   false .. Entry must be written
+ * mtxPrint must be locked by caller!
+ */
+static bool entryRepeated(const LogEntry *pEntry,
+			const uint8_t sinks,
+			const char *fmt
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+			, const system_clock::time_point &t,
+			const int64_t tDiffMs
+#endif
+			)
+{
+	int severity = pEntry->severity;
+	bool collapse = severity >= 1 && severity <= cLogSeverityMax &&
+					repeatsCollapsed[severity];
+
+	if (!collapse && !repeatLast.cnt && !repeatLast.fmt)
+		return false;
+
+	uint32_t hash = collapse ? hashCreate(pEntry->msg, pEntry->lenMsg) : 0;
+
+	if (collapse &&
+			repeatLast.fmt == fmt &&
+			repeatLast.entry.line == pEntry->line &&
+			repeatLast.entry.pProc == pEntry->pProc &&
+			repeatLast.hash == hash)
+	{
+		++repeatLast.cnt;
+		repeatLast.tMonoUsLast = pEntry->tMonoUs;
+		return true;
+	}
+
+	repeatsFlush(pEntry
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+		, t, tDiffMs
+#endif
+		);
+
+	if (!collapse)
+	{
+		repeatLast.fmt = NULL;
+		return false;
+	}
+
+	repeatLast.entry = *pEntry;
+	repeatLast.fmt = fmt;
+	repeatLast.sinks = sinks;
+	repeatLast.hash = hash;
+	repeatLast.cnt = 0;
+
+	return false;
+}
+
+/*
+ * Binary mode
+ */
+static bool binPut(uint8_t * &pBuf, const uint8_t *pBufEnd, uint64_t val, size_t len)
+{
+	if ((size_t)(pBufEnd - pBuf) < len)
+		return false;
+
+	for (size_t i = 0; i < len; ++i, val >>= 8)
+		*pBuf++ = (uint8_t)val;
+
+	return true;
+}
+
+static bool binBytesPut(uint8_t * &pBuf, const uint8_t *pBufEnd, const void *pData, size_t len)
+{
+	if ((size_t)(pBufEnd - pBuf) < len)
+		return false;
+
+	memcpy(pBuf, pData, len);
+	pBuf += len;
+
+	return true;
+}
+
+/*
+ * Record header is reserved by caller
+ * mtxPrint must be locked by caller!
+ */
+static void recordBinaryWrite(uint8_t type, uint8_t *pBufStart, const uint8_t *pBuf)
+{
+	size_t len = pBuf - pBufStart - 3;
+
+	pBufStart[0] = type;
+	pBufStart[1] = (uint8_t)len;
+	pBufStart[2] = (uint8_t)(len >> 8);
+
+	pFctLogBinaryWrite(pBufStart, pBuf - pBufStart);
+}
+
+static void headerBinaryWrite()
+{
+	uint8_t buf[8];
+	uint8_t *pBuf = buf + 3;
+
+	binBytesPut(pBuf, buf + sizeof(buf), "PLOG", 4);
+	binPut(pBuf, buf + sizeof(buf), cLogBinaryVersion, 1);
+
+	recordBinaryWrite(LbrHeader, buf, pBuf);
+}
+
+/*
+ * Strings are identified by their address. Therefore only
+ * static strings like literals and __func__ may be used
+ * for format strings, file and function names
+ */
+static uint32_t stringBinaryId(const char *pStr, uint8_t *pBufStart)
+{
+	const size_t numSlots = CONFIG_PROC_LOG_NUM_STRINGS_BINARY;
+	size_t idx = ((uintptr_t)pStr >> 2) % numSlots;
+	LogBinaryString *pEntry;
+
+	for (size_t i = 0; i < numSlots; ++i, idx = (idx + 1) % numSlots)
+	{
+		pEntry = &stringsBinary[idx];
+
+		if (pEntry->pStr == pStr)
+			return pEntry->id;
+
+		if (!pEntry->pStr)
+			break;
+	}
+
+	// Keep probing short. IDs stay unique, strings will be defined again
+	if (numStringsBinary >= numSlots * 3 / 4)
+	{
+		memset(stringsBinary, 0, sizeof(stringsBinary));
+		numStringsBinary = 0;
+
+		idx = ((uintptr_t)pStr >> 2) % numSlots;
+		pEntry = &stringsBinary[idx];
+	}
+
+	pEntry->pStr = pStr;
+	pEntry->id = idStringBinaryNext++;
+	++numStringsBinary;
+
+	uint8_t *pBuf = pBufStart + 3;
+	const uint8_t *pBufEnd = pBufStart + cLogBinaryBufferSize;
+	size_t len = strnlen(pStr, cLogEntryBufferSize);
+
+	binPut(pBuf, pBufEnd, pEntry->id, 4);
+	binBytesPut(pBuf, pBufEnd, pStr, len);
+
+	recordBinaryWrite(LbrString, pBufStart, pBuf);
+
+	return pEntry->id;
+}
+
+enum LogLengthModifier
+{
+	LlmNone = 0,
+	LlmChar,
+	LlmShort,
+	LlmLong,
+	LlmLongLong,
+	LlmMax,
+	LlmSize,
+	LlmPtrDiff,
+	LlmLongDouble,
+};
+
+static bool argSignedPut(uint8_t * &pBuf, const uint8_t *pBufEnd,
+						LogLengthModifier lenMod, va_list &args)
+{
+	int64_t val;
+
+	switch (lenMod)
+	{
+	case LlmChar: val = (signed char)va_arg(args, int); break;
+	case LlmShort: val = (short)va_arg(args, int); break;
+	case LlmLong: val = va_arg(args, long); break;
+	case LlmLongLong: val = va_arg(args, long long); break;
+	case LlmMax: val = va_arg(args, intmax_t); break;
+	case LlmSize: val = va_arg(args, ptrdiff_t); break;
+	case LlmPtrDiff: val = va_arg(args, ptrdiff_t); break;
+	default: val = va_arg(args, int); break;
+	}
+
+	return binPut(pBuf, pBufEnd, (uint64_t)val, 8);
+}
+
+static bool argUnsignedPut(uint8_t * &pBuf, const uint8_t *pBufEnd,
+						LogLengthModifier lenMod, va_list &args)
+{
+	uint64_t val;
+
+	switch (lenMod)
+	{
+	case LlmChar: val = (unsigned char)va_arg(args, unsigned int); break;
+	case LlmShort: val = (unsigned short)va_arg(args, unsigned int); break;
+	case LlmLong: val = va_arg(args, unsigned long); break;
+	case LlmLongLong: val = va_arg(args, unsigned long long); break;
+	case LlmMax: val = va_arg(args, uintmax_t); break;
+	case LlmSize: val = va_arg(args, size_t); break;
+	case LlmPtrDiff: val = (uint64_t)va_arg(args, ptrdiff_t); break;
+	default: val = va_arg(args, unsigned int); break;
+	}
+
+	return binPut(pBuf, pBufEnd, val, 8);
+}
+
+/*
+ * Stores the raw argument values in the order of the format string
+ * - Integers, characters and pointers: 8 bytes
+ * - Floating point values: 8 bytes, IEEE 754 double
+ * - Strings: u16 len, bytes. Precision is respected
+ * - '*' for width and precision: 8 bytes
+ * Return
+ *   false .. Arguments have been truncated
+ */
+static bool argsBinaryPut(uint8_t * &pBuf, const uint8_t *pBufEnd,
+						const char *pFmt, va_list &args)
+{
+	LogLengthModifier lenMod;
+	long precision;
+	int val;
+
+	while (1)
+	{
+		pFmt = strchr(pFmt, '%');
+		if (!pFmt)
+			return true;
+		++pFmt;
+
+		if (*pFmt == '%')
+		{
+			++pFmt;
+			continue;
+		}
+
+		// flags
+		while (*pFmt && strchr("-+ #0'", *pFmt))
+			++pFmt;
+
+		// width
+		if (*pFmt == '*')
+		{
+			val = va_arg(args, int);
+			if (!binPut(pBuf, pBufEnd, (uint64_t)(int64_t)val, 8))
+				return false;
+			++pFmt;
+		}
+
+		while (*pFmt >= '0' && *pFmt <= '9')
+			++pFmt;
+
+		// precision
+		precision = -1;
+
+		if (*pFmt == '.')
+		{
+			++pFmt;
+			precision = 0;
+
+			if (*pFmt == '*')
+			{
+				val = va_arg(args, int);
+				if (!binPut(pBuf, pBufEnd, (uint64_t)(int64_t)val, 8))
+					return false;
+				precision = val < 0 ? -1 : val;
+				++pFmt;
+			}
+
+			for (; *pFmt >= '0' && *pFmt <= '9'; ++pFmt)
+				precision = precision * 10 + (*pFmt - '0');
+		}
+
+		// length modifier
+		lenMod = LlmNone;
+
+		switch (*pFmt)
+		{
+		case 'h':
+			++pFmt;
+			lenMod = LlmShort;
+			if (*pFmt == 'h')
+			{
+				++pFmt;
+				lenMod = LlmChar;
+			}
+			break;
+		case 'l':
+			++pFmt;
+			lenMod = LlmLong;
+			if (*pFmt == 'l')
+			{
+				++pFmt;
+				lenMod = LlmLongLong;
+			}
+			break;
+		case 'q': ++pFmt; lenMod = LlmLongLong; break;
+		case 'j': ++pFmt; lenMod = LlmMax; break;
+		case 'z': ++pFmt; lenMod = LlmSize; break;
+		case 't': ++pFmt; lenMod = LlmPtrDiff; break;
+		case 'L': ++pFmt; lenMod = LlmLongDouble; break;
+		default: break;
+		}
+
+		// conversion
+		switch (*pFmt)
+		{
+		case 'd':
+		case 'i':
+			if (!argSignedPut(pBuf, pBufEnd, lenMod, args))
+				return false;
+			break;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+			if (!argUnsignedPut(pBuf, pBufEnd, lenMod, args))
+				return false;
+			break;
+		case 'c':
+			val = va_arg(args, int);
+			if (!binPut(pBuf, pBufEnd, (uint64_t)(int64_t)val, 8))
+				return false;
+			break;
+		case 'e':
+		case 'E':
+		case 'f':
+		case 'F':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+		{
+			double valDbl;
+			uint64_t valRaw;
+
+			if (lenMod == LlmLongDouble)
+				valDbl = (double)va_arg(args, long double);
+			else
+				valDbl = va_arg(args, double);
+
+			memcpy(&valRaw, &valDbl, sizeof(valRaw));
+
+			if (!binPut(pBuf, pBufEnd, valRaw, 8))
+				return false;
+			break;
+		}
+		case 's':
+		{
+			const char *pStr = va_arg(args, const char *);
+			size_t len;
+
+			if (!pStr)
+				pStr = "(null)";
+
+			len = strnlen(pStr, precision < 0 ? cLogEntryBufferSize : (size_t)precision);
+
+			if ((size_t)(pBufEnd - pBuf) < len + 2)
+				len = pBufEnd - pBuf < 2 ? 0 : pBufEnd - pBuf - 2;
+
+			binPut(pBuf, pBufEnd, len, 2);
+			binBytesPut(pBuf, pBufEnd, pStr, len);
+			break;
+		}
+		case 'p':
+			if (!binPut(pBuf, pBufEnd, (uintptr_t)va_arg(args, void *), 8))
+				return false;
+			break;
+		case 'n':
+			(void)va_arg(args, void *);
+			break;
+		default:
+			// Unknown argument type. Can't go on
+			return true;
+		}
+
+		if (*pFmt)
+			++pFmt;
+	}
+}
+
+/*
+ * Entry record
+ *   u64 time [us] since epoch, u8 severity, u8 flags,
+ *   [i8 width counter time, u32 counter time],
+ *   u64 process, u32 ID format, u32 ID file, u32 ID function,
+ *   u32 line, i16 code, arguments
+ */
+static void entryBinaryWrite(
+			const int severity,
+			const void *pProc,
+			const char *filename,
+			const char *function,
+			const int line,
+			const int16_t code,
+			const char *msg,
+			va_list args)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+	static uint8_t bufBinary[cLogBinaryBufferSize];
+
+	if (!pFctLogBinaryWrite)
+		return;
+
+	uint32_t idFmt = stringBinaryId(msg, bufBinary);
+	uint32_t idFile = stringBinaryId(filename, bufBinary);
+	uint32_t idFunc = stringBinaryId(function, bufBinary);
+
+	uint8_t *pBuf = bufBinary + 3;
+	const uint8_t *pBufEnd = bufBinary + cLogBinaryBufferSize;
+	uint8_t *pFlags;
+	uint64_t tUs = 0;
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+	tUs = duration_cast<microseconds>(
+			system_clock::now().time_since_epoch()).count();
+#endif
+	binPut(pBuf, pBufEnd, tUs, 8);
+	binPut(pBuf, pBufEnd, (uint8_t)severity, 1);
+
+	pFlags = pBuf;
+	binPut(pBuf, pBufEnd, 0, 1);
+
+	if (pFctCntTimeCreate)
+	{
+		*pFlags |= 1;
+		binPut(pBuf, pBufEnd, (uint8_t)(int8_t)widthCntTime, 1);
+		binPut(pBuf, pBufEnd, pFctCntTimeCreate(), 4);
+	}
+
+	binPut(pBuf, pBufEnd, (uintptr_t)pProc, 8);
+	binPut(pBuf, pBufEnd, idFmt, 4);
+	binPut(pBuf, pBufEnd, idFile, 4);
+	binPut(pBuf, pBufEnd, idFunc, 4);
+	binPut(pBuf, pBufEnd, (uint32_t)line, 4);
+	binPut(pBuf, pBufEnd, (uint16_t)code, 2);
+
+	va_list argsCopy;
+
+	va_copy(argsCopy, args);
+	if (!argsBinaryPut(pBuf, pBufEnd, msg, argsCopy))
+		*pFlags |= 2;
+	va_end(argsCopy);
+
+	recordBinaryWrite(LbrEntry, bufBinary, pBuf);
+}
+
+void logBinaryWriteSet(FuncLogBinaryWrite pFct)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+	pFctLogBinaryWrite = pFct;
+
+	// New stream. Strings must be defined again
+	memset(stringsBinary, 0, sizeof(stringsBinary));
+	numStringsBinary = 0;
+
+	if (!pFctLogBinaryWrite)
+		return;
+
+	headerBinaryWrite();
+}
+
+int16_t entryLogCreate(
+			const int severity,
+			const void *pProc,
+			const char *filename,
+			const char *function,
+			const int line,
+			const int16_t code,
+			const char *msg, ...)
+{
+	uint32_t numSuppressed = 0;
+	uint8_t sinks;
+#if dLogHaveAsync
+	// Otherwise done by the writer
+	if (!asyncActive.load(memory_order_relaxed))
+#endif
+		summariesFlushIfDue();
+
+	// Nothing is formatted for disabled entries
+	sinks = sinksGet(severity, filename);
+	if (!sinks)
+		return code;
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+	if (!rateLimitPass(severity, pProc, filename, function,
+						msg, line, numSuppressed))
+		return code;
+#endif
+
+	if ((sinks & LsbStdout) && pFctLogBinaryWrite)
+	{
+		va_list argsBinary;
+
+		va_start(argsBinary, msg);
+		entryBinaryWrite(severity, pProc, filename,
+					function, line, code, msg, argsBinary);
+		va_end(argsBinary);
+
+		sinks &= ~LsbStdout;
+		if (!sinks)
+			return code;
+	}
+#if dLogHaveAsync
+	if (asyncActive.load(memory_order_acquire))
+	{
+		va_list argsAsync;
+		bool queued;
+
+		// Stop waits for producers which saw the writer active
+		numAsyncProducers.fetch_add(1);
+
+		va_start(argsAsync, msg);
+		queued = asyncActive.load() &&
+				entryLogAsyncEnqueue(severity, pProc, filename,
+							function, line, code,
+							sinks, numSuppressed, msg, argsAsync);
+		va_end(argsAsync);
+
+		numAsyncProducers.fetch_sub(1);
+
+		if (queued)
+			return code;
+	}
+#endif
+	LogEntry entry;
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+	// get time
+	system_clock::time_point t = system_clock::now();
+	steady_clock::time_point tMono = steady_clock::now();
+	int64_t tDiffMs = diffMsGet(tMono, sinks & (LsbStdout | LsbDisk));
+
+	entryInit(entry, severity, pProc, procNameGetLog(pProc, sinks),
+			filename, function, line, code, usGet(t), usGet(tMono));
 #else
-		if (severity == 1)
-			fprintf(stderr, "%s%s%s\r\n", red, pBufStart, dColorDefault);
-		else
-		if (severity == 2)
-			fprintf(stderr, "%s%s%s\r\n", yellow, pBufStart, dColorDefault);
-		else
-		if (severity >= 4)
-			fprintf(stdout, "%s%s%s\r\n", cyan, pBufStart, dColorDefault);
-		else
-			fprintf(stdout, "%s%s%s\r\n", dColorInfo, pBufStart, dColorDefault);
+	entryInit(entry, severity, pProc, procNameGetLog(pProc, sinks),
+			filename, function, line, code, 0, 0);
+#endif
+#if CONFIG_PROC_HAVE_DRIVERS
+	lock_guard<mutex> lock(mtxPrint); // Guard not defined!
+#endif
+	char *pBufStart = (char *)malloc(cLogEntryBufferSize);
+	if (!pBufStart)
+		return code;
+
+	char *pBuf = pBufStart;
+	char *pBufEnd = pBuf + cLogEntryBufferSize - 1;
+	uint32_t cntTime = 0;
+	int lenDone;
+
+	*pBuf = 0;
+	*pBufEnd = 0;
+
+	if (pFctCntTimeCreate)
+		cntTime = pFctCntTimeCreate();
+
+	lenDone = entryPrefixCreate(pBuf, pBufEnd,
+				severity, pProc, filename, function, line,
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+				t, tDiffMs,
 #endif
+				pFctCntTimeCreate != NULL, cntTime);
+	if (lenDone < 0)
+		goto exitLogEntryCreate;
+
+	// user msg
+	va_list args;
+	char *pMsg;
+
+	pMsg = pBuf;
+
+	va_start(args, msg);
+	lenDone = vsnprintf(pBuf, pBufEnd - pBuf, msg, args);
+	if (pBufSaturate(lenDone, pBuf, pBufEnd) < 0)
+	{
+		va_end(args);
+		goto exitLogEntryCreate;
 	}
+	va_end(args);
+
+	suppressedAppend(pBuf, pBufEnd, numSuppressed);
+
+	entry.text = pBufStart;
+	entry.lenText = pBuf - pBufStart;
+	entry.msg = pMsg;
+	entry.lenMsg = pBuf - pMsg;
+
+	if (entryRepeated(&entry, sinks, msg
+#if CONFIG_PROC_LOG_HAVE_CHRONO
+				, t, tDiffMs
 #endif
-	if (pFctEntryLogCreate)
-		pFctEntryLogCreate(severity,
-			pProc, filename, function, line, code,
-			pBufStart, pBuf - pBufStart);
+				))
+		goto exitLogEntryCreate;
+
+	// create log entry
+	entryOutput(sinks, &entry);
 
 exitLogEntryCreate:
 	free(pBufStart);
@@ -381,3 +2345,351 @@ exitLogEntryCreate:
 	return code;
 }
 
+#if dLogHaveAsync
+bool logAsyncStart(size_t numEntriesPerThread, LogOverflowPolicy policy)
+{
+	lock_guard<mutex> lock(mtxRings);
+
+	if (pThdWriter)
+		return true;
+
+	// Ring size must be a power of two
+	size_t sizeRing = 1;
+	while (sizeRing < numEntriesPerThread)
+		sizeRing <<= 1;
+
+	if (sizeRing != sizeRingAsync)
+	{
+		// Only rings created from now on have the new size
+		sizeRingAsync = sizeRing;
+	}
+
+	policyOverflow = policy;
+	asyncStopReq.store(false);
+
+	pThdWriter = new dNoThrow thread(entryLogAsyncWrite);
+	if (!pThdWriter)
+		return false;
+
+	asyncActive.store(true, memory_order_release);
+
+	return true;
+}
+
+void logAsyncStop()
+{
+	thread *pThd;
+
+	{
+		lock_guard<mutex> lock(mtxRings);
+
+		pThd = pThdWriter;
+		pThdWriter = NULL;
+	}
+
+	if (!pThd)
+		return;
+
+	asyncActive.store(false);
+
+	// Records of producers in flight must be complete
+	while (numAsyncProducers.load())
+		this_thread::yield();
+
+	asyncStopReq.store(true);
+
+	if (pThd->joinable())
+		pThd->join();
+
+	delete pThd;
+
+	// Nothing must be left behind
+	char *pBuf = (char *)malloc(cLogEntryBufferSize);
+	if (!pBuf)
+		return;
+
+	ringsDrain(pBuf, cLogEntryBufferSize);
+	free(pBuf);
+
+	summariesFlush(true);
+
+	fflush(stdout);
+	fflush(stderr);
+}
+
+void logAsyncWriterSleepSet(size_t delayUs)
+{
+	if (!delayUs)
+		return;
+
+	sleepWriterUs = delayUs;
+}
+
+uint32_t logAsyncDroppedCnt()
+{
+	return numDroppedTotal.load();
+}
+
+static LogRing *ringThreadGet()
+{
+	if (ringOwner.pRing)
+		return ringOwner.pRing;
+
+	LogRing *pRing = new dNoThrow LogRing;
+	if (!pRing)
+		return NULL;
+
+	{
+		lock_guard<mutex> lock(mtxRings);
+
+		pRing->pRecords = new dNoThrow LogRecord[sizeRingAsync];
+		if (!pRing->pRecords)
+		{
+			delete pRing;
+			return NULL;
+		}
+
+		pRing->mask = sizeRingAsync - 1;
+		pRing->idxWr.store(0);
+		pRing->idxRd.store(0);
+		pRing->numDropped.store(0);
+		pRing->numDroppedReported = 0;
+		pRing->orphaned.store(false);
+
+		pRing->pNext = pRingsAsync;
+		pRingsAsync = pRing;
+	}
+
+	ringOwner.pRing = pRing;
+
+	return pRing;
+}
+
+/*
+ * Return
+ *   true  .. Entry has been queued or dropped
+ *   false .. Entry must be created synchronously
+ */
+static bool entryLogAsyncEnqueue(
+			const int severity,
+			const void *pProc,
+			const char *filename,
+			const char *function,
+			const int line,
+			const int16_t code,
+			const uint8_t sinks,
+			const uint32_t numSuppressed,
+			const char *msg,
+			va_list args)
+{
+	LogRing *pRing = ringThreadGet();
+	if (!pRing)
+		return false;
+
+	size_t idxWr = pRing->idxWr.load(memory_order_relaxed);
+
+	while (idxWr - pRing->idxRd.load(memory_order_acquire) > pRing->mask)
+	{
+		if (policyOverflow == LogOverflowDrop ||
+				!asyncActive.load(memory_order_acquire))
+		{
+			pRing->numDropped.fetch_add(1, memory_order_relaxed);
+			numDroppedTotal.fetch_add(1, memory_order_relaxed);
+			return true;
+		}
+
+		this_thread::yield();
+	}
+
+	LogRecord *pRec = &pRing->pRecords[idxWr & pRing->mask];
+	int lenDone;
+
+	pRec->severity = severity;
+	pRec->pProc = pProc;
+	pRec->procName = procNameGetLog(pProc, sinks);
+	pRec->filename = filename;
+	pRec->function = function;
+	pRec->fmt = msg;
+	pRec->line = line;
+	pRec->code = code;
+	pRec->sinks = sinks;
+	pRec->hasCntTime = pFctCntTimeCreate != NULL;
+	pRec->cntTime = pRec->hasCntTime ? pFctCntTimeCreate() : 0;
+	steady_clock::time_point tMono = steady_clock::now();
+
+	pRec->t = system_clock::now();
+	pRec->tDiffMs = diffMsGet(tMono, sinks & (LsbStdout | LsbDisk));
+	pRec->tMonoUs = usGet(tMono);
+
+	char *pBuf = pRec->msg;
+	char *pBufEnd = pBuf + sizeof(pRec->msg) - 1;
+
+	*pBufEnd = 0;
+
+	lenDone = vsnprintf(pBuf, pBufEnd - pBuf, msg, args);
+	if (pBufSaturate(lenDone, pBuf, pBufEnd) < 0)
+		*pBuf = 0;
+
+	suppressedAppend(pBuf, pBufEnd, numSuppressed);
+
+	lenDone = pBuf - pRec->msg;
+
+	pRec->len = (uint16_t)lenDone;
+
+	pRing->idxWr.store(idxWr + 1, memory_order_release);
+
+	return true;
+}
+
+static void recordWrite(const LogRecord *pRec, char *pBufStart, size_t sizeBuf)
+{
+	char *pBuf = pBufStart;
+	char *pBufEnd = pBuf + sizeBuf - 1;
+	int lenDone;
+
+	*pBuf = 0;
+	*pBufEnd = 0;
+
+	lenDone = entryPrefixCreate(pBuf, pBufEnd,
+				pRec->severity, pRec->pProc,
+				pRec->filename, pRec->function, pRec->line,
+				pRec->t, pRec->tDiffMs,
+				pRec->hasCntTime, pRec->cntTime);
+	if (lenDone < 0)
+		return;
+
+	LogEntry entry;
+
+	entryInit(entry, pRec->severity, pRec->pProc, pRec->procName,
+			pRec->filename, pRec->function, pRec->line, pRec->code,
+			usGet(pRec->t), pRec->tMonoUs);
+
+	entry.msg = pBuf;
+
+	lenDone = snprintf(pBuf, pBufEnd - pBuf, "%s", pRec->msg);
+	if (pBufSaturate(lenDone, pBuf, pBufEnd) < 0)
+		return;
+
+	entry.lenMsg = pBuf - entry.msg;
+	entry.text = pBufStart;
+	entry.lenText = pBuf - pBufStart;
+
+	if (entryRepeated(&entry, pRec->sinks, pRec->fmt,
+				pRec->t, pRec->tDiffMs))
+		return;
+
+	entryOutput(pRec->sinks, &entry);
+}
+
+static size_t ringsDrain(char *pBuf, size_t sizeBuf)
+{
+	lock_guard<mutex> lockRings(mtxRings);
+	lock_guard<mutex> lockPrint(mtxPrint);
+	LogRing **ppRing = &pRingsAsync;
+	LogRing *pRing;
+	size_t idxRd, idxWr;
+	size_t numDone = 0;
+	uint32_t numDropped;
+	bool orphaned;
+
+	while (*ppRing)
+	{
+		pRing = *ppRing;
+
+		orphaned = pRing->orphaned.load(memory_order_acquire);
+		idxRd = pRing->idxRd.load(memory_order_relaxed);
+		idxWr = pRing->idxWr.load(memory_order_acquire);
+
+		for (; idxRd != idxWr; ++idxRd, ++numDone)
+			recordWrite(&pRing->pRecords[idxRd & pRing->mask], pBuf, sizeBuf);
+
+		pRing->idxRd.store(idxRd, memory_order_release);
+
+		numDropped = pRing->numDropped.load(memory_order_relaxed);
+		if (numDropped != pRing->numDroppedReported)
+		{
+			snprintf(pBuf, sizeBuf, "%" PRIu32 " log entries dropped",
+					numDropped - pRing->numDroppedReported);
+			entryPrint(2, pBuf);
+
+			pRing->numDroppedReported = numDropped;
+			++numDone;
+		}
+
+		if (!orphaned)
+		{
+			ppRing = &pRing->pNext;
+			continue;
+		}
+
+		// Owning thread is gone and won't write anymore
+		*ppRing = pRing->pNext;
+
+		delete[] pRing->pRecords;
+		delete pRing;
+	}
+
+	return numDone;
+}
+
+static void entryLogAsyncWrite()
+{
+	char *pBuf = (char *)malloc(cLogEntryBufferSize);
+	if (!pBuf)
+		return;
+
+	size_t numDone;
+	bool stopReq;
+
+	while (1)
+	{
+		stopReq = asyncStopReq.load();
+
+		numDone = ringsDrain(pBuf, cLogEntryBufferSize);
+		if (numDone)
+		{
+			fflush(stdout);
+			fflush(stderr);
+			continue;
+		}
+
+		if (stopReq)
+			break;
+		summariesFlushIfDue();
+#if CONFIG_PROC_LOG_HAVE_DISK
+		{
+			lock_guard<mutex> lock(mtxPrint);
+			diskFlushIfDue();
+		}
+#endif
+		this_thread::sleep_for(microseconds(sleepWriterUs));
+	}
+
+	free(pBuf);
+}
+#else
+bool logAsyncStart(size_t numEntriesPerThread, LogOverflowPolicy policy)
+{
+	(void)numEntriesPerThread;
+	(void)policy;
+
+	return false;
+}
+
+void logAsyncStop()
+{
+}
+
+void logAsyncWriterSleepSet(size_t delayUs)
+{
+	(void)delayUs;
+}
+
+uint32_t logAsyncDroppedCnt()
+{
+	return 0;
+}
+#endif
+
+#endif
+
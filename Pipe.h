@@ -35,6 +35,8 @@
 
 #include <list>
 #include <queue>
+#include <map>
+#include <set>
 #include <chrono>
 #if DEBUG_PIPE
 #include <iostream>
@@ -45,8 +47,12 @@
 /*
   What is Pipe?
   - It's a queue of particles and corresponding timestamps
-  - With up to one parent and multiple children
+  - With multiple parents and multiple children
   - Thread safe
+  - Entries of multiple parents can be merged
+    - PipeMergeFifo         .. Interleaved in order of arrival (default)
+    - PipeMergeTimeOrdered  .. K-way merge ordered by t1 using a
+                               bounded reorder window
   - EOF signals can be sent
     - Sender:   sourceDoneSet()
     - Receiver: sinkDoneSet()
@@ -61,6 +67,12 @@
 
 typedef uint32_t ParticleTime;
 
+enum PipeMergeMode
+{
+	PipeMergeFifo = 0,
+	PipeMergeTimeOrdered,
+};
+
 /* Literature
  * - https://en.cppreference.com/w/cpp/language/rule_of_three
  */
@@ -115,7 +127,7 @@ struct PipeEntry
 	PipeEntry(PipeEntry&& other) noexcept
 		: particle(std::move(other.particle))
 		, t1(other.t1)
-		, t2(other.t1)
+		, t2(other.t2)
 	{
 		other.t1 = 0;
 		other.t2 = 0;
@@ -183,6 +195,17 @@ public:
 		mDataBlocking = block;
 	}
 
+	/*
+	 * Only relevant for pipes with multiple parents
+	 * windowMs:  Maximum time span in t1 an entry is held back
+	 *            while waiting for older entries of other parents
+	 * waitMaxMs: Maximum wall-clock time an entry is held back.
+	 *            Releases the tail when all parents go quiet.
+	 *            0 disables the bound
+	 */
+	virtual void mergeModeSet(PipeMergeMode mode, ParticleTime windowMs = 100,
+							ParticleTime waitMaxMs = 1000) = 0;
+
 	virtual bool toPushTry() = 0;
 
 	// optional
@@ -229,6 +252,9 @@ protected:
 		, mSourceDone(false)
 		, mSinkDone(false)
 		, mDataBlocking(true)
+		, mMergeMode(PipeMergeFifo)
+		, mMergeWindowMs(0)
+		, mMergeWaitMaxMs(0)
 	{}
 
 	virtual ~PipeBase()
@@ -245,6 +271,9 @@ protected:
 	bool mSourceDone;
 	bool mSinkDone;
 	bool mDataBlocking;
+	PipeMergeMode mMergeMode;
+	ParticleTime mMergeWindowMs;
+	ParticleTime mMergeWaitMaxMs;
 
 private:
 	PipeBase()
@@ -260,6 +289,7 @@ public:
 	typedef typename std::list<Pipe<T> *>::iterator PipeListIter;
 	Pipe()
 		: PipeBase(defaultSizeMax)
+		, mTimeNewest(0)
 	{
 #if DEBUG_PIPE
 		std::cout << "Pipe(): " << this << std::endl;
@@ -268,6 +298,7 @@ public:
 
 	Pipe(std::size_t size)
 		: PipeBase(size)
+		, mTimeNewest(0)
 	{
 #if DEBUG_PIPE
 		std::cout << "Pipe(size_t size): " << this << std::endl;
@@ -301,7 +332,7 @@ public:
 
 		if (!parentAccepted)
 		{
-			errLog(-2, "Could not connect to child. Another parent connected already");
+			errLog(-2, "Could not connect to child. Child is me");
 			return;
 		}
 
@@ -337,6 +368,10 @@ public:
 			std::cout << this << "->parentDisconnect(" << pParent << ") - 2" << std::endl;
 #endif
 		}
+#if CONFIG_PROC_HAVE_DRIVERS
+		Guard lockEntries(mEntryMtx);
+#endif
+		mSources.clear();
 	}
 
 	ssize_t get(PipeEntry<T> &entry)
@@ -347,7 +382,10 @@ public:
 		if (!mSize && mSourceDone)
 			return -1;
 
-		if (!mSize)
+		if (mMergeMode == PipeMergeTimeOrdered)
+			reorderedRelease();
+
+		if (mEntries.empty())
 			return 0;
 
 		entry = std::move(mEntries.front());
@@ -359,19 +397,30 @@ public:
 
 	ssize_t commit(T particle, ParticleTime t1 = 0, ParticleTime t2 = 0)
 	{
+		return entryAdd(NULL, std::move(particle), t1, t2);
+	}
+
+	void mergeModeSet(PipeMergeMode mode, ParticleTime windowMs = 100,
+							ParticleTime waitMaxMs = 1000)
+	{
 #if CONFIG_PROC_HAVE_DRIVERS
 		Guard lock(mEntryMtx);
 #endif
-		if (mSourceDone || mSinkDone)
-			return -1;
+		mMergeMode = mode;
+		mMergeWindowMs = windowMs;
+		mMergeWaitMaxMs = waitMaxMs;
 
-		if (mSize >= mSizeMax)
-			return 0;
+		if (mode == PipeMergeTimeOrdered)
+			return;
 
-		mEntries.emplace(std::move(particle), t1, t2);
-		++mSize;
+		// Flush held back entries
+		while (!mReorder.empty())
+		{
+			mEntries.push(std::move(mReorder.begin()->second.entry));
+			mReorder.erase(mReorder.begin());
+		}
 
-		return 1;
+		mArrivals.clear();
 	}
 
 	bool toPushTry()
@@ -390,6 +439,9 @@ public:
 #if CONFIG_PROC_HAVE_DRIVERS
 				Guard lock(mEntryMtx);
 #endif
+				if (mMergeMode == PipeMergeTimeOrdered)
+					reorderedRelease();
+
 				/* do we have something to send? */
 				if (mEntries.empty())
 					break;
@@ -425,7 +477,7 @@ public:
 			/* transfer entry to all children */
 			iter = mChildList.begin();
 			for (; iter != mChildList.end(); ++iter)
-				(*iter)->commit(entry.particle, entry.t1, entry.t2);
+				(*iter)->entryAdd(this, entry.particle, entry.t1, entry.t2);
 
 			somethingPushed = true;
 		}
@@ -437,7 +489,7 @@ public:
 		for (; iter != mChildList.end(); ++iter)
 		{
 			if (nothingLeft)
-				(*iter)->sourceDoneSet();
+				(*iter)->parentDoneSet(this);
 		}
 
 		return somethingPushed;
@@ -449,6 +501,173 @@ public:
 	}
 
 private:
+	/*
+	 * Merge state of a single parent
+	 * Used to decide whether an entry held back in
+	 * the reorder buffer can be released
+	 */
+	struct PipeMergeSource
+	{
+		Pipe<T> *pParent;
+		ParticleTime tLast;
+		bool seen;
+		bool done;
+	};
+
+	// Compare with wrap around of ParticleTime in mind
+	struct ParticleTimeLess
+	{
+		bool operator()(ParticleTime a, ParticleTime b) const
+		{
+			return (int32_t)(a - b) < 0;
+		}
+	};
+
+	// Entry held back. Arrival is wall-clock time
+	struct PipeEntryHeld
+	{
+		PipeEntryHeld(PipeEntry<T> &&e, ParticleTime arrival)
+			: entry(std::move(e))
+			, tArrival(arrival)
+		{}
+
+		PipeEntry<T> entry;
+		ParticleTime tArrival;
+	};
+
+	typedef typename std::list<PipeMergeSource>::iterator SourceIter;
+	typedef std::multimap<ParticleTime, PipeEntryHeld, ParticleTimeLess> ReorderMap;
+	typedef std::multiset<ParticleTime, ParticleTimeLess> ArrivalSet;
+
+	ssize_t entryAdd(Pipe<T> *pParent, T particle, ParticleTime t1, ParticleTime t2)
+	{
+#if CONFIG_PROC_HAVE_DRIVERS
+		Guard lock(mEntryMtx);
+#endif
+		if (mSourceDone || mSinkDone)
+			return -1;
+
+		if (mSize >= mSizeMax)
+			return 0;
+
+		++mSize;
+
+		if (mMergeMode != PipeMergeTimeOrdered)
+		{
+			mEntries.emplace(std::move(particle), t1, t2);
+			return 1;
+		}
+
+		SourceIter iter = mSources.begin();
+		for (; iter != mSources.end(); ++iter)
+		{
+			if (iter->pParent != pParent)
+				continue;
+
+			iter->tLast = t1;
+			iter->seen = true;
+			break;
+		}
+
+		if (mReorder.empty() || (int32_t)(t1 - mTimeNewest) > 0)
+			mTimeNewest = t1;
+
+		ParticleTime tArrival = nowMs();
+
+		// multimap: Equal keys keep their order of insertion
+		mReorder.emplace(t1, PipeEntryHeld(PipeEntry<T>(std::move(particle), t1, t2), tArrival));
+		mArrivals.insert(tArrival);
+
+		return 1;
+	}
+
+	/*
+	 * Literature
+	 * - https://en.wikipedia.org/wiki/K-way_merge_algorithm
+	 *
+	 * The oldest entry is released if
+	 * - Every active parent delivered an entry at least as new
+	 *   => Nothing older can arrive anymore
+	 * - The newest entry is ahead by more than the reorder window
+	 * - Any held entry waited longer than the wall-clock bound.
+	 *   Parents may go quiet and never deliver newer entries
+	 * - The pipe is full. Otherwise the parents would be blocked forever
+	 * - All parents are done
+	 */
+	void reorderedRelease()
+	{
+		// mEntryMtx must be locked by caller!
+		typename ReorderMap::iterator iterEntry;
+		SourceIter iterSrc;
+		ParticleTime t, tNow = 0;
+		bool release, sourcesPast;
+
+		if (mMergeWaitMaxMs && !mReorder.empty())
+			tNow = nowMs();
+
+		while (!mReorder.empty())
+		{
+			iterEntry = mReorder.begin();
+			t = iterEntry->first;
+
+			release = mSourceDone || mSize >= mSizeMax;
+
+			if (!release)
+				release = (ParticleTime)(mTimeNewest - t) >= mMergeWindowMs;
+
+			if (!release && mMergeWaitMaxMs)
+				release = (ParticleTime)(tNow - *mArrivals.begin()) >= mMergeWaitMaxMs;
+
+			if (!release && mSources.size())
+			{
+				sourcesPast = true;
+
+				iterSrc = mSources.begin();
+				for (; iterSrc != mSources.end(); ++iterSrc)
+				{
+					if (iterSrc->done)
+						continue;
+
+					if (iterSrc->seen && (int32_t)(iterSrc->tLast - t) >= 0)
+						continue;
+
+					sourcesPast = false;
+					break;
+				}
+
+				release = sourcesPast;
+			}
+
+			if (!release)
+				break;
+
+			mArrivals.erase(mArrivals.find(iterEntry->second.tArrival));
+
+			mEntries.push(std::move(iterEntry->second.entry));
+			mReorder.erase(iterEntry);
+		}
+	}
+
+	void parentDoneSet(Pipe<T> *pParent)
+	{
+#if CONFIG_PROC_HAVE_DRIVERS
+		Guard lock(mEntryMtx);
+#endif
+		bool allDone = true;
+
+		SourceIter iter = mSources.begin();
+		for (; iter != mSources.end(); ++iter)
+		{
+			if (iter->pParent == pParent)
+				iter->done = true;
+
+			allDone = allDone && iter->done;
+		}
+
+		if (allDone)
+			mSourceDone = true;
+	}
+
 	void listDelete(bool parent = false)
 	{
 #if CONFIG_PROC_HAVE_DRIVERS
@@ -509,12 +728,28 @@ private:
 #if CONFIG_PROC_HAVE_DRIVERS
 		Guard lock(mParentListMtx);
 #endif
-		if (mParentList.size())
+		if (pParent == this)
 			return false;
 
 		mParentList.remove(pParent);
 		mParentList.push_back(pParent);
 
+		{
+#if CONFIG_PROC_HAVE_DRIVERS
+			Guard lockEntries(mEntryMtx);
+#endif
+			sourceRemove(pParent);
+
+			PipeMergeSource src;
+
+			src.pParent = pParent;
+			src.tLast = 0;
+			src.seen = false;
+			src.done = false;
+
+			mSources.push_back(src);
+		}
+
 #if DEBUG_PIPE
 		std::cout << this << "->parentAdd(" << pParent << ")" << std::endl;
 #endif
@@ -545,12 +780,38 @@ private:
 #endif
 			break;
 		}
+#if CONFIG_PROC_HAVE_DRIVERS
+		Guard lockEntries(mEntryMtx);
+#endif
+		sourceRemove(pParent);
+	}
+
+	void sourceRemove(Pipe<T> *pParent)
+	{
+		// mEntryMtx must be locked by caller!
+		SourceIter iter = mSources.begin();
+		while (iter != mSources.end())
+		{
+			if (iter->pParent != pParent)
+			{
+				++iter;
+				continue;
+			}
+
+			iter = mSources.erase(iter);
+		}
 	}
 
 	std::list<Pipe<T> *> mParentList;
 	std::list<Pipe<T> *> mChildList;
 	std::queue<PipeEntry<T> > mEntries;
 
+	// merging
+	std::list<PipeMergeSource> mSources;
+	ReorderMap mReorder;
+	ArrivalSet mArrivals;
+	ParticleTime mTimeNewest;
+
 	static size_t defaultSizeMax;
 
 };
@@ -0,0 +1,878 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef PIPE_BRIDGING_H
+#define PIPE_BRIDGING_H
+
+#include <string>
+#include <type_traits>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "Processing.h"
+#include "Pipe.h"
+#include "TcpTransfering.h"
+
+/*
+  What is PipeBridging?
+  - Connects a Pipe<T> of one node with a Pipe<T> of another node
+  - PipeSending<T>
+    - Entries committed to ppIn are sent to the remote peer
+  - PipeReceiving<T>
+    - Entries of the remote peer are committed to ppOut
+  - Particles are converted by a pluggable serializer
+    - Default for trivially copyable types, VecByte and std::string
+  - Timestamps t1 and t2 are preserved
+  - Multiple entries are batched into one frame
+  - Credit based flow control
+    - The receiver grants credits for the free space of ppOut
+    - The sender only sends entries for which it has credits
+    - Without credits ppIn runs full and blocks the upstream pipe
+
+  Frame format (little endian)
+    u8    type
+    u32   length of payload
+    ..    payload
+
+  Payload of data frame
+    u16   number of entries
+    For each entry
+      u32 t1
+      u32 t2
+      u32 length of particle
+      ..  serialized particle
+
+  Payload of credit frame
+    u32   number of credits
+*/
+
+#ifndef CONFIG_PIPE_BRIDGE_SIZE_FRAME_MAX
+#define CONFIG_PIPE_BRIDGE_SIZE_FRAME_MAX		(16 * 1024 * 1024)
+#endif
+
+enum PipeBridgeFrameType
+{
+	PbfData = 1,
+	PbfCredit,
+	PbfDone,
+};
+
+template<typename T, bool trivial = std::is_trivially_copyable<T>::value>
+struct PipeBridgeSerializerDefault
+{
+	static bool serialize(const T &particle, VecByte &buf)
+	{
+		const uint8_t *pData = (const uint8_t *)&particle;
+		buf.insert(buf.end(), pData, pData + sizeof(T));
+		return true;
+	}
+
+	static bool deserialize(const uint8_t *pData, size_t len, T &particle)
+	{
+		if (len != sizeof(T))
+			return false;
+
+		memcpy((void *)&particle, pData, len);
+		return true;
+	}
+};
+
+// No default for complex types. User must set serializer
+template<typename T>
+struct PipeBridgeSerializerDefault<T, false>
+{
+	static const bool missing = true;
+};
+
+template<>
+struct PipeBridgeSerializerDefault<VecByte, false>
+{
+	static bool serialize(const VecByte &particle, VecByte &buf)
+	{
+		buf.insert(buf.end(), particle.begin(), particle.end());
+		return true;
+	}
+
+	static bool deserialize(const uint8_t *pData, size_t len, VecByte &particle)
+	{
+		particle.assign(pData, pData + len);
+		return true;
+	}
+};
+
+template<>
+struct PipeBridgeSerializerDefault<std::string, false>
+{
+	static bool serialize(const std::string &particle, VecByte &buf)
+	{
+		buf.insert(buf.end(), particle.begin(), particle.end());
+		return true;
+	}
+
+	static bool deserialize(const uint8_t *pData, size_t len, std::string &particle)
+	{
+		particle.assign((const char *)pData, len);
+		return true;
+	}
+};
+
+template<typename T>
+class PipeBridging : public Processing
+{
+
+public:
+
+	typedef bool (*FuncSerialize)(const T &particle, VecByte &buf); // append to buf
+	typedef bool (*FuncDeserialize)(const uint8_t *pData, size_t len, T &particle);
+
+	void serializerSet(FuncSerialize pFctSer, FuncDeserialize pFctDeser)
+	{
+		mpFctSerialize = pFctSer;
+		mpFctDeserialize = pFctDeser;
+	}
+
+protected:
+
+	enum BridgeState
+	{
+		StStart = 0,
+		StConnDoneWait,
+		StMain,
+		StFlush,
+	};
+
+	PipeBridging(const char *name, SOCKET fd)
+		: Processing(name)
+		, mpFctSerialize(NULL)
+		, mpFctDeserialize(NULL)
+		, mSocketFd(fd)
+		, mHostAddr("")
+		, mHostPort(0)
+		, mpTrans(NULL)
+		, mBufRx()
+		, mLenFrameDone(0)
+		, mBufTx()
+		, mCntEntries(0)
+		, mCntFrames(0)
+	{
+		mState = StStart;
+		serializerDefaultSet<T>(0);
+	}
+
+	PipeBridging(const char *name, const std::string &hostAddr, uint16_t hostPort)
+		: Processing(name)
+		, mpFctSerialize(NULL)
+		, mpFctDeserialize(NULL)
+		, mSocketFd(INVALID_SOCKET)
+		, mHostAddr(hostAddr)
+		, mHostPort(hostPort)
+		, mpTrans(NULL)
+		, mBufRx()
+		, mLenFrameDone(0)
+		, mBufTx()
+		, mCntEntries(0)
+		, mCntFrames(0)
+	{
+		mState = StStart;
+		serializerDefaultSet<T>(0);
+	}
+
+	virtual ~PipeBridging() {}
+
+	Success transportStart()
+	{
+		if (!mpFctSerialize || !mpFctDeserialize)
+			return procErrLog(-1, "serializer not set");
+
+		if (mSocketFd != INVALID_SOCKET)
+			mpTrans = TcpTransfering::create(mSocketFd);
+		else
+			mpTrans = TcpTransfering::create(mHostAddr, mHostPort);
+
+		if (!mpTrans)
+			return procErrLog(-1, "could not create process");
+
+		// socket is owned by transfer process now
+		mSocketFd = INVALID_SOCKET;
+
+		start(mpTrans);
+
+		return Positive;
+	}
+
+	Success transportReady()
+	{
+		if (mpTrans->success() != Pending)
+			return procErrLog(-1, "could not connect to peer");
+
+		if (!mpTrans->mSendReady)
+			return Pending;
+
+		return Positive;
+	}
+
+	/*
+	 * Return value
+	 *   Positive .. Frame available
+	 *   Pending  .. No complete frame yet
+	 *   < 0      .. Connection down or protocol error
+	 */
+	Success frameReceive(uint8_t &type, const uint8_t * &pPayload, uint32_t &lenPayload)
+	{
+		frameConsume();
+
+		uint8_t buf[1024];
+		ssize_t lenRead;
+		bool connDown = false;
+
+		while (1)
+		{
+			lenRead = mpTrans->read(buf, sizeof(buf));
+			if (!lenRead)
+				break;
+
+			if (lenRead < 0)
+			{
+				// process frames received so far first
+				connDown = true;
+				break;
+			}
+
+			mBufRx.insert(mBufRx.end(), buf, buf + lenRead);
+		}
+
+		if (mBufRx.size() < cSizeHdr)
+			return connDown ? -1 : Pending;
+
+		type = mBufRx[0];
+		lenPayload = u32Get(&mBufRx[1]);
+
+		if (lenPayload > CONFIG_PIPE_BRIDGE_SIZE_FRAME_MAX)
+			return procErrLog(-2, "frame too large: %u", lenPayload);
+
+		if (mBufRx.size() < cSizeHdr + lenPayload)
+			return connDown ? -1 : Pending;
+
+		pPayload = mBufRx.data() + cSizeHdr;
+		mLenFrameDone = cSizeHdr + lenPayload;
+
+		return Positive;
+	}
+
+	/*
+	 * The frame is taken in any case unless an error occurs.
+	 * Call framePendingSend() before creating the next one
+	 *
+	 * Return value
+	 *   Positive .. Frame sent
+	 *   Pending  .. Send queue full. Frame kept for a retry
+	 *   < 0      .. Connection down
+	 */
+	Success frameSend(uint8_t type, const VecByte &payload)
+	{
+		mBufTx.clear();
+
+		mBufTx.push_back(type);
+		u32Append(mBufTx, (uint32_t)payload.size());
+		mBufTx.insert(mBufTx.end(), payload.begin(), payload.end());
+
+		return framePendingSend();
+	}
+
+	// Transfer accepts all or nothing
+	Success framePendingSend()
+	{
+		if (mBufTx.empty())
+			return Positive;
+
+		ssize_t lenSent = mpTrans->send(mBufTx.data(), mBufTx.size());
+		if (lenSent < 0)
+			return procErrLog(-1, "could not send frame");
+
+		if (!lenSent)
+			return Pending;
+
+		mBufTx.clear();
+		++mCntFrames;
+
+		return Positive;
+	}
+
+	Success shutdown()
+	{
+		if (mSocketFd == INVALID_SOCKET)
+			return Positive;
+
+		// Transfer process never created
+#ifdef _WIN32
+		::closesocket(mSocketFd);
+#else
+		::close(mSocketFd);
+#endif
+		mSocketFd = INVALID_SOCKET;
+
+		return Positive;
+	}
+
+	void processInfo(char *pBuf, char *pBufEnd)
+	{
+		dInfo("Entries\t\t\t%lu\n", (unsigned long)mCntEntries);
+		dInfo("Frames\t\t\t%lu\n", (unsigned long)mCntFrames);
+	}
+
+	static uint32_t u32Get(const uint8_t *pData)
+	{
+		return (uint32_t)pData[0] |
+				(uint32_t)pData[1] << 8 |
+				(uint32_t)pData[2] << 16 |
+				(uint32_t)pData[3] << 24;
+	}
+
+	static void u32Append(VecByte &buf, uint32_t val)
+	{
+		buf.push_back(val & 0xFF);
+		buf.push_back((val >> 8) & 0xFF);
+		buf.push_back((val >> 16) & 0xFF);
+		buf.push_back((val >> 24) & 0xFF);
+	}
+
+	FuncSerialize mpFctSerialize;
+	FuncDeserialize mpFctDeserialize;
+	SOCKET mSocketFd;
+	std::string mHostAddr;
+	uint16_t mHostPort;
+	TcpTransfering *mpTrans;
+	VecByte mBufRx;
+	size_t mLenFrameDone;
+	VecByte mBufTx;
+
+	// statistics
+	size_t mCntEntries;
+	size_t mCntFrames;
+
+	static const size_t cSizeHdr = 5;
+
+private:
+
+	PipeBridging() = delete;
+	PipeBridging(const PipeBridging &) = delete;
+	PipeBridging &operator=(const PipeBridging &) = delete;
+
+	void frameConsume()
+	{
+		if (!mLenFrameDone)
+			return;
+
+		mBufRx.erase(mBufRx.begin(), mBufRx.begin() + mLenFrameDone);
+		mLenFrameDone = 0;
+	}
+
+	template<typename U>
+	void serializerDefaultSet(decltype(&PipeBridgeSerializerDefault<U>::serialize))
+	{
+		mpFctSerialize = PipeBridgeSerializerDefault<U>::serialize;
+		mpFctDeserialize = PipeBridgeSerializerDefault<U>::deserialize;
+	}
+
+	template<typename U>
+	void serializerDefaultSet(...)
+	{
+		// No default available
+	}
+
+};
+
+template<typename T>
+class PipeSending : public PipeBridging<T>
+{
+
+public:
+
+	static PipeSending *create(SOCKET fd)
+	{
+		return new dNoThrow PipeSending(fd);
+	}
+
+	static PipeSending *create(const std::string &hostAddr, uint16_t hostPort)
+	{
+		return new dNoThrow PipeSending(hostAddr, hostPort);
+	}
+
+	void batchSizeSet(uint16_t sizeBatch)
+	{
+		if (!sizeBatch)
+			return;
+
+		mSizeBatch = sizeBatch;
+	}
+
+	// Connect a local pipe to this one
+	Pipe<T> ppIn;
+
+protected:
+
+	virtual ~PipeSending() {}
+
+private:
+
+	typedef PipeBridging<T> Base;
+
+	PipeSending(SOCKET fd)
+		: Base("PipeSending", fd)
+		, ppIn()
+		, mSizeBatch(32)
+		, mCredits(0)
+		, mPayload()
+		, mDoneCreated(false)
+	{}
+
+	PipeSending(const std::string &hostAddr, uint16_t hostPort)
+		: Base("PipeSending", hostAddr, hostPort)
+		, ppIn()
+		, mSizeBatch(32)
+		, mCredits(0)
+		, mPayload()
+		, mDoneCreated(false)
+	{}
+
+	PipeSending() = delete;
+	PipeSending(const PipeSending &) = delete;
+	PipeSending &operator=(const PipeSending &) = delete;
+
+	Success process()
+	{
+		Success success;
+
+		switch (this->mState)
+		{
+		case Base::StStart:
+
+			success = this->transportStart();
+			if (success != Positive)
+				return success;
+
+			this->mState = Base::StConnDoneWait;
+
+			break;
+		case Base::StConnDoneWait:
+
+			success = this->transportReady();
+			if (success == Pending)
+				break;
+
+			if (success != Positive)
+				return success;
+
+			this->mState = Base::StMain;
+
+			break;
+		case Base::StMain:
+
+			success = creditsReceive();
+			if (success != Positive)
+				return success;
+
+			success = batchesSend();
+			if (success == Pending)
+				break;
+
+			if (success != Positive)
+				return success;
+
+			this->mState = Base::StFlush;
+
+			break;
+		case Base::StFlush:
+
+			// Closing the socket with unread credits may
+			// cause a reset and data loss on the receiver.
+			// Therefore wait for the receiver to close first
+			success = creditsReceive();
+			if (success == Positive)
+				break;
+
+			return Positive;
+
+			break;
+		default:
+			break;
+		}
+
+		return Pending;
+	}
+
+	Success creditsReceive()
+	{
+		const uint8_t *pPayload;
+		uint32_t lenPayload;
+		uint8_t type;
+		Success success;
+
+		while (1)
+		{
+			success = this->frameReceive(type, pPayload, lenPayload);
+			if (success == Pending)
+				break;
+
+			if (success != Positive && this->mState == Base::StFlush)
+				return -1;
+
+			if (success != Positive)
+				return procErrLog(-1, "connection to receiver down");
+
+			if (type != PbfCredit || lenPayload != 4)
+				return procErrLog(-1, "unexpected frame. type: %u", type);
+
+			mCredits += Base::u32Get(pPayload);
+		}
+
+		return Positive;
+	}
+
+	Success batchesSend()
+	{
+		PipeEntry<T> entry;
+		uint16_t numEntries;
+		size_t idxLen;
+		uint32_t lenParticle;
+		ssize_t res;
+		Success success;
+
+		// Frame of the last call first. Keeps the stream in order
+		success = this->framePendingSend();
+		if (success != Positive)
+			return success;
+
+		while (mCredits)
+		{
+			mPayload.clear();
+			mPayload.push_back(0); // number of entries
+			mPayload.push_back(0);
+
+			numEntries = 0;
+
+			while (mCredits && numEntries < mSizeBatch)
+			{
+				res = ppIn.get(entry);
+				if (res < 1)
+					break;
+
+				Base::u32Append(mPayload, entry.t1);
+				Base::u32Append(mPayload, entry.t2);
+
+				idxLen = mPayload.size();
+				Base::u32Append(mPayload, 0);
+
+				if (!this->mpFctSerialize(entry.particle, mPayload))
+					return procErrLog(-1, "could not serialize particle");
+
+				lenParticle = (uint32_t)(mPayload.size() - idxLen - 4);
+				mPayload[idxLen + 0] = lenParticle & 0xFF;
+				mPayload[idxLen + 1] = (lenParticle >> 8) & 0xFF;
+				mPayload[idxLen + 2] = (lenParticle >> 16) & 0xFF;
+				mPayload[idxLen + 3] = (lenParticle >> 24) & 0xFF;
+
+				++numEntries;
+				--mCredits;
+			}
+
+			if (!numEntries)
+				break;
+
+			mPayload[0] = numEntries & 0xFF;
+			mPayload[1] = (numEntries >> 8) & 0xFF;
+
+			success = this->frameSend(PbfData, mPayload);
+			if (success < 0)
+				return success;
+
+			this->mCntEntries += numEntries;
+
+			if (success == Pending)
+				return Pending;
+		}
+
+		if (ppIn.entriesLeft())
+			return Pending;
+
+		if (mDoneCreated)
+			return Positive;
+
+		mPayload.clear();
+		mDoneCreated = true;
+
+		return this->frameSend(PbfDone, mPayload);
+	}
+
+	void processInfo(char *pBuf, char *pBufEnd)
+	{
+		Base::processInfo(pBuf, pBufEnd);
+
+		// continue after output of base
+		pBuf += strlen(pBuf);
+
+		dInfo("Credits\t\t\t%lu\n", (unsigned long)mCredits);
+		dInfo("Queue\t\t\t%zu\n", ppIn.size());
+	}
+
+	uint16_t mSizeBatch;
+	size_t mCredits;
+	VecByte mPayload;
+	bool mDoneCreated;
+
+};
+
+template<typename T>
+class PipeReceiving : public PipeBridging<T>
+{
+
+public:
+
+	static PipeReceiving *create(SOCKET fd)
+	{
+		return new dNoThrow PipeReceiving(fd);
+	}
+
+	static PipeReceiving *create(const std::string &hostAddr, uint16_t hostPort)
+	{
+		return new dNoThrow PipeReceiving(hostAddr, hostPort);
+	}
+
+	// Connect this pipe to a local one
+	Pipe<T> ppOut;
+
+protected:
+
+	virtual ~PipeReceiving() {}
+
+private:
+
+	typedef PipeBridging<T> Base;
+
+	PipeReceiving(SOCKET fd)
+		: Base("PipeReceiving", fd)
+		, ppOut()
+		, mCreditsGranted(0)
+		, mPayload()
+	{}
+
+	PipeReceiving(const std::string &hostAddr, uint16_t hostPort)
+		: Base("PipeReceiving", hostAddr, hostPort)
+		, ppOut()
+		, mCreditsGranted(0)
+		, mPayload()
+	{}
+
+	PipeReceiving() = delete;
+	PipeReceiving(const PipeReceiving &) = delete;
+	PipeReceiving &operator=(const PipeReceiving &) = delete;
+
+	Success process()
+	{
+		Success success;
+
+		switch (this->mState)
+		{
+		case Base::StStart:
+
+			success = this->transportStart();
+			if (success != Positive)
+				return success;
+
+			this->mState = Base::StConnDoneWait;
+
+			break;
+		case Base::StConnDoneWait:
+
+			success = this->transportReady();
+			if (success == Pending)
+				break;
+
+			if (success != Positive)
+				return success;
+
+			this->mState = Base::StMain;
+
+			break;
+		case Base::StMain:
+
+			ppOut.toPushTry();
+
+			success = entriesReceive();
+			if (success == Positive)
+			{
+				this->mState = Base::StFlush;
+				break;
+			}
+
+			if (success != Pending)
+				return success;
+
+			success = creditsGrant();
+			if (success != Positive)
+				return success;
+
+			break;
+		case Base::StFlush:
+
+			ppOut.toPushTry();
+
+			if (ppOut.size())
+				break;
+
+			return Positive;
+
+			break;
+		default:
+			break;
+		}
+
+		return Pending;
+	}
+
+	/*
+	 * Return value
+	 *   Positive .. Sender is done
+	 *   Pending  .. More entries can be expected
+	 */
+	Success entriesReceive()
+	{
+		const uint8_t *pPayload, *pEnd;
+		uint32_t lenPayload, lenParticle;
+		uint16_t numEntries;
+		PipeEntry<T> entry;
+		uint8_t type;
+		Success success;
+		ssize_t res;
+
+		while (1)
+		{
+			success = this->frameReceive(type, pPayload, lenPayload);
+			if (success == Pending)
+				break;
+
+			if (success != Positive)
+				return procErrLog(-1, "connection to sender down");
+
+			if (type == PbfDone)
+			{
+				ppOut.sourceDoneSet();
+				return Positive;
+			}
+
+			if (type != PbfData || lenPayload < 2)
+				return procErrLog(-1, "unexpected frame. type: %u", type);
+
+			pEnd = pPayload + lenPayload;
+			numEntries = pPayload[0] | pPayload[1] << 8;
+			pPayload += 2;
+
+			for (; numEntries; --numEntries)
+			{
+				if (pEnd - pPayload < 12)
+					return procErrLog(-1, "entry header truncated");
+
+				entry.t1 = Base::u32Get(pPayload);
+				entry.t2 = Base::u32Get(pPayload + 4);
+				lenParticle = Base::u32Get(pPayload + 8);
+				pPayload += 12;
+
+				if ((uint32_t)(pEnd - pPayload) < lenParticle)
+					return procErrLog(-1, "particle truncated");
+
+				if (!this->mpFctDeserialize(pPayload, lenParticle, entry.particle))
+					return procErrLog(-1, "could not deserialize particle");
+
+				pPayload += lenParticle;
+
+				res = ppOut.commit(std::move(entry.particle), entry.t1, entry.t2);
+				if (res < 1)
+					return procErrLog(-1, "sender exceeded credits");
+
+				if (mCreditsGranted)
+					--mCreditsGranted;
+
+				++this->mCntEntries;
+			}
+		}
+
+		return Pending;
+	}
+
+	Success creditsGrant()
+	{
+		Success success = this->framePendingSend();
+		if (success != Positive)
+			return success;
+
+		size_t sizeMax = ppOut.sizeMax();
+		size_t sizeUsed = ppOut.size();
+		size_t sizeFree = sizeMax > sizeUsed ? sizeMax - sizeUsed : 0;
+
+		if (sizeFree <= mCreditsGranted)
+			return Positive;
+
+		size_t credits = sizeFree - mCreditsGranted;
+
+		// Keep number of credit frames low
+		if (mCreditsGranted && credits < (sizeMax >> 2))
+			return Positive;
+
+		mPayload.clear();
+		Base::u32Append(mPayload, (uint32_t)credits);
+
+		success = this->frameSend(PbfCredit, mPayload);
+		if (success < 0)
+			return success;
+
+		mCreditsGranted += credits;
+
+		return Positive;
+	}
+
+	void processInfo(char *pBuf, char *pBufEnd)
+	{
+		Base::processInfo(pBuf, pBufEnd);
+
+		// continue after output of base
+		pBuf += strlen(pBuf);
+
+		dInfo("Credits granted\t\t%lu\n", (unsigned long)mCreditsGranted);
+		dInfo("Queue\t\t\t%zu\n", ppOut.size());
+	}
+
+	size_t mCreditsGranted;
+	VecByte mPayload;
+
+};
+
+#endif
+
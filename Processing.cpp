@@ -30,9 +30,22 @@
 
 #include "Processing.h"
 
+#if CONFIG_PROC_LOG_LEVEL_MAX >= 5
 #define coreLog(m, ...)					(genericLog(5, NULL, 0, m, ##__VA_ARGS__))
 #define procCoreLog(m, ...)				(genericLog(5, this, 0, m, ##__VA_ARGS__))
 
+// The ID is only needed for core logs
+#define dChildIdCreate(pChild) \
+	char childId[CONFIG_PROC_ID_BUFFER_SIZE]; \
+	childId[0] = 0; \
+	if (levelLogEnabled(5, __PROC_FILENAME__)) \
+		procId(childId, childId + sizeof(childId), pChild);
+#else
+#define coreLog(m, ...)					(entryLogStripped(0))
+#define procCoreLog(m, ...)				(entryLogStripped(0))
+#define dChildIdCreate(pChild)
+#endif
+
 #if CONFIG_PROC_HAVE_DRIVERS
 #define CONFIG_PROC_TITLE_NEW_DRIVER
 #if defined(__linux__)
@@ -141,8 +154,7 @@ void Processing::treeTick()
 			continue;
 		}
 
-		char childId[CONFIG_PROC_ID_BUFFER_SIZE];
-		procId(childId, childId + sizeof(childId), pChild);
+		dChildIdCreate(pChild);
 
 		procCoreLog("removing %s from child list", childId);
 		{
@@ -493,8 +505,7 @@ void Processing::undrivenSet(Processing *pChild)
 
 void Processing::destroy(Processing *pChild)
 {
-	char childId[CONFIG_PROC_ID_BUFFER_SIZE];
-	procId(childId, childId + sizeof(childId), pChild);
+	dChildIdCreate(pChild);
 
 	coreLog("child %s destroy()", childId);
 
@@ -756,8 +767,7 @@ Processing *Processing::start(Processing *pChild, DriverMode driver)
 		return NULL;
 	}
 #endif
-	char childId[CONFIG_PROC_ID_BUFFER_SIZE];
-	procId(childId, childId + sizeof(childId), pChild);
+	dChildIdCreate(pChild);
 
 	procCoreLog("starting %s", childId);
 
@@ -839,8 +849,7 @@ Processing *Processing::cancel(Processing *pChild)
 		return NULL;
 	}
 
-	char childId[CONFIG_PROC_ID_BUFFER_SIZE];
-	procId(childId, childId + sizeof(childId), pChild);
+	dChildIdCreate(pChild);
 
 	procCoreLog("canceling %s", childId);
 	pChild->mStatParent |= PsbParCanceled;
@@ -877,8 +886,7 @@ Processing *Processing::whenFinishedRepel(Processing *pChild)
 		return NULL;
 	}
 
-	char childId[CONFIG_PROC_ID_BUFFER_SIZE];
-	procId(childId, childId + sizeof(childId), pChild);
+	dChildIdCreate(pChild);
 
 	procCoreLog("repelling %s when finished", childId);
 	pChild->mStatParent |= PsbParWhenFinishedUnused;
@@ -43,6 +43,14 @@
 #define CONFIG_PROC_HAVE_LOG					0
 #endif
 
+/*
+ * Log calls above this severity are removed at compile time
+ * 1 .. ERR, 2 .. WRN, 3 .. INF, 4 .. DBG, 5 .. COR
+ */
+#ifndef CONFIG_PROC_LOG_LEVEL_MAX
+#define CONFIG_PROC_LOG_LEVEL_MAX				5
+#endif
+
 #ifndef CONFIG_PROC_HAVE_DRIVERS
 #if defined(__STDCPP_THREADS__)
 #define CONFIG_PROC_HAVE_DRIVERS				1
@@ -174,6 +182,7 @@ public:
 	static const char *strrchr(const char *x, char y);
 	static void *memcpy(void *to, const void *from, size_t cnt);
 #endif
+	static const char *procNameGet(const Processing *pProc) { return pProc ? pProc->mName : NULL; }
 	static void showAddressInIdSet(uint8_t val) { showAddressInId = val; }
 	static void disableTreeDefaultSet(uint8_t val) { disableTreeDefault = val; }
 #if CONFIG_PROC_HAVE_DRIVERS
@@ -360,6 +369,45 @@ private:
 
 typedef uint32_t (*FuncCntTimeCreate)();
 
+enum LogOverflowPolicy
+{
+	LogOverflowDrop = 0,	// Never blocks. Entry is dropped and counted
+	LogOverflowBlock,		// Producer waits for the writer
+};
+
+enum LogEncoding
+{
+	LogEncText = 0,		// Same as stdout
+	LogEncLogfmt,		// key=value pairs
+	LogEncJson,			// One JSON object per line
+};
+
+/*
+ * Structured log entry
+ * - Strings are only valid during the call of the sink
+ * - text contains the complete entry with prefix
+ * - msg points to the user message inside text
+ * - procName is only set for sinks which output it
+ */
+struct LogEntry
+{
+	int severity;
+	const void *pProc;
+	const char *procName;
+	const char *filename;
+	const char *function;
+	int line;
+	int16_t code;
+	uint64_t tWallUs;	// Since epoch
+	uint64_t tMonoUs;	// Monotonic. Not affected by changes of the system time
+	const char *text;
+	size_t lenText;
+	const char *msg;
+	size_t lenMsg;
+};
+
+typedef void (*FuncEntryLogStructured)(const LogEntry *pEntry);
+
 #if CONFIG_PROC_HAVE_LOG
 typedef void (*FuncEntryLogCreate)(
 			const int severity,
@@ -371,15 +419,76 @@ typedef void (*FuncEntryLogCreate)(
 			const char *msg,
 			const size_t len);
 
+typedef void (*FuncLogBinaryWrite)(const void *pData, size_t len);
+
 void levelLogSet(int lvl);
+void levelLogHookSet(int lvl);
+bool levelLogFileSet(const char *filename, int lvl = -1);
+bool levelLogEnabled(const int severity, const char *filename);
 void entryLogCreateSet(FuncEntryLogCreate pFct);
+void entryLogStructuredSet(FuncEntryLogStructured pFct);
+void logBinaryWriteSet(FuncLogBinaryWrite pFct);
+size_t logEntryEncode(char *pBuf, char *pBufEnd,
+				const LogEntry *pEntry, LogEncoding enc);
 void cntTimeCreateSet(FuncCntTimeCreate pFct, int width = 8);
 
+/*
+ * Asynchronous logging
+ * - Entries are queued in per thread lock-free rings
+ * - A writer thread prints them in batches
+ * - Requires internal drivers
+ */
+bool logAsyncStart(size_t numEntriesPerThread = 128, LogOverflowPolicy policy = LogOverflowDrop);
+void logAsyncStop();
+void logAsyncWriterSleepSet(size_t delayUs);
+uint32_t logAsyncDroppedCnt();
+
+/*
+ * Disk logging
+ * - Entries are collected in a user space buffer
+ * - Buffer is written when full, after intervalMs
+ *   or immediately for entries with severity <= levelFlush
+ * - Files are rotated by size: filename, filename.1, ..
+ * - Optionally the maximum file size is preallocated
+ * - The buffer is written at exit as well
+ * - Short writes are counted and reported on stderr
+ */
+bool logDiskStart(const char *filename,
+				size_t sizeFileMax = 10 * 1024 * 1024,
+				size_t numFiles = 3,
+				bool preallocate = false);
+void logDiskStop();
+void logDiskFlush();
+uint32_t logDiskWritesShortCnt();
+void logDiskFlushSet(uint32_t intervalMs, int levelFlush = 2);
+void levelLogDiskSet(int lvl);
+void logDiskEncodingSet(LogEncoding enc);
+
+/*
+ * Overload protection
+ * - Token bucket per call site: ratePerSec, burst
+ *   Dropped entries are reported with the next one passing
+ * - Consecutive identical entries are collapsed to
+ *   "last entry repeated N times"
+ * - Pending summaries are also written when the call site
+ *   may log again or the repeats are older than
+ *   CONFIG_PROC_LOG_DELAY_SUMMARY_MS, in logAsyncStop()
+ *   and at exit
+ * - severity 0 applies to all severities
+ * - ratePerSec 0 disables rate limiting
+ */
+void logRateLimitSet(int severity, uint32_t ratePerSec, uint32_t burst = 10);
+void logRepeatCollapseSet(int severity, bool collapse = true);
+
 int16_t entryLogSimpleCreate(
 				const int isErr,
 				const int16_t code,
 				const char *msg, ...);
 
+/*
+ * pProc must be NULL or point to a Processing. Its name
+ * is read for the structured sink and encoded disk logs
+ */
 int16_t entryLogCreate(
 				const int severity,
 				const void *pProc,
@@ -390,14 +499,49 @@ int16_t entryLogCreate(
 				const char *msg, ...);
 
 #define genericSimpleLog(e, c, m, ...)      (entryLogSimpleCreate(e, c, m, ##__VA_ARGS__))
-#define genericLog(l, p, c, m, ...)         (entryLogCreate(l, p, __PROC_FILENAME__, __func__, __LINE__, c, m, ##__VA_ARGS__))
+#define genericLog(l, p, c, m, ...)         (levelLogEnabled(l, __PROC_FILENAME__) ? \
+		entryLogCreate(l, p, __PROC_FILENAME__, __func__, __LINE__, c, m, ##__VA_ARGS__) : (int16_t)(c))
 #else
 inline void levelLogSet(int lvl)
 {
 	(void)lvl;
 }
 
+inline void levelLogHookSet(int lvl)
+{
+	(void)lvl;
+}
+
+inline bool levelLogFileSet(const char *filename, int lvl = -1)
+{
+	(void)filename;
+	(void)lvl;
+
+	return false;
+}
+
+inline bool levelLogEnabled(const int severity, const char *filename)
+{
+	(void)severity;
+	(void)filename;
+
+	return false;
+}
+
 #define entryLogCreateSet(pFct)
+#define entryLogStructuredSet(pFct)
+#define logBinaryWriteSet(pFct)
+
+inline size_t logEntryEncode(char *pBuf, char *pBufEnd,
+				const LogEntry *pEntry, LogEncoding enc)
+{
+	(void)pBuf;
+	(void)pBufEnd;
+	(void)pEntry;
+	(void)enc;
+
+	return 0;
+}
 
 inline void cntTimeCreateSet(FuncCntTimeCreate pFct, int width = 8)
 {
@@ -405,6 +549,76 @@ inline void cntTimeCreateSet(FuncCntTimeCreate pFct, int width = 8)
 	(void)width;
 }
 
+inline bool logAsyncStart(size_t numEntriesPerThread = 128, LogOverflowPolicy policy = LogOverflowDrop)
+{
+	(void)numEntriesPerThread;
+	(void)policy;
+
+	return false;
+}
+
+inline void logAsyncStop() {}
+
+inline void logAsyncWriterSleepSet(size_t delayUs)
+{
+	(void)delayUs;
+}
+
+inline uint32_t logAsyncDroppedCnt()
+{
+	return 0;
+}
+
+inline bool logDiskStart(const char *filename,
+				size_t sizeFileMax = 10 * 1024 * 1024,
+				size_t numFiles = 3,
+				bool preallocate = false)
+{
+	(void)filename;
+	(void)sizeFileMax;
+	(void)numFiles;
+	(void)preallocate;
+
+	return false;
+}
+
+inline void logDiskStop() {}
+inline void logDiskFlush() {}
+
+inline uint32_t logDiskWritesShortCnt()
+{
+	return 0;
+}
+
+inline void logDiskFlushSet(uint32_t intervalMs, int levelFlush = 2)
+{
+	(void)intervalMs;
+	(void)levelFlush;
+}
+
+inline void levelLogDiskSet(int lvl)
+{
+	(void)lvl;
+}
+
+inline void logDiskEncodingSet(LogEncoding enc)
+{
+	(void)enc;
+}
+
+inline void logRateLimitSet(int severity, uint32_t ratePerSec, uint32_t burst = 10)
+{
+	(void)severity;
+	(void)ratePerSec;
+	(void)burst;
+}
+
+inline void logRepeatCollapseSet(int severity, bool collapse = true)
+{
+	(void)severity;
+	(void)collapse;
+}
+
 inline int16_t entryLogSimpleCreateDummy(
 				const int isErr,
 				const int16_t code,
@@ -442,15 +656,43 @@ inline int16_t entryLogCreateDummy(
 #define userErrLog(c, m, ...)       (c < 0 ? genericSimpleLog(1, c, m, ##__VA_ARGS__) : c)
 #define userInfLog(m, ...)                  (genericSimpleLog(0, 0, m, ##__VA_ARGS__))
 
-#define errLog(c, m, ...)           (c < 0 ? genericLog(1, NULL, c, m, ##__VA_ARGS__) : c)
-#define wrnLog(m, ...)                      (genericLog(2, NULL, 0, m, ##__VA_ARGS__))
-#define infLog(m, ...)                      (genericLog(3, NULL, 0, m, ##__VA_ARGS__))
-#define dbgLog(m, ...)                      (genericLog(4, NULL, 0, m, ##__VA_ARGS__))
+// Arguments of stripped log calls are not evaluated
+inline int16_t entryLogStripped(int16_t code)
+{
+	return code;
+}
 
+#if CONFIG_PROC_LOG_LEVEL_MAX >= 1
+#define errLog(c, m, ...)           (c < 0 ? genericLog(1, NULL, c, m, ##__VA_ARGS__) : c)
 #define procErrLog(c, m, ...)       (c < 0 ? genericLog(1, this, c, m, ##__VA_ARGS__) : c)
+#else
+#define errLog(c, m, ...)                   (entryLogStripped(c))
+#define procErrLog(c, m, ...)               (entryLogStripped(c))
+#endif
+
+#if CONFIG_PROC_LOG_LEVEL_MAX >= 2
+#define wrnLog(m, ...)                      (genericLog(2, NULL, 0, m, ##__VA_ARGS__))
 #define procWrnLog(m, ...)                  (genericLog(2, this, 0, m, ##__VA_ARGS__))
+#else
+#define wrnLog(m, ...)                      (entryLogStripped(0))
+#define procWrnLog(m, ...)                  (entryLogStripped(0))
+#endif
+
+#if CONFIG_PROC_LOG_LEVEL_MAX >= 3
+#define infLog(m, ...)                      (genericLog(3, NULL, 0, m, ##__VA_ARGS__))
 #define procInfLog(m, ...)                  (genericLog(3, this, 0, m, ##__VA_ARGS__))
+#else
+#define infLog(m, ...)                      (entryLogStripped(0))
+#define procInfLog(m, ...)                  (entryLogStripped(0))
+#endif
+
+#if CONFIG_PROC_LOG_LEVEL_MAX >= 4
+#define dbgLog(m, ...)                      (genericLog(4, NULL, 0, m, ##__VA_ARGS__))
 #define procDbgLog(m, ...)                  (genericLog(4, this, 0, m, ##__VA_ARGS__))
+#else
+#define dbgLog(m, ...)                      (entryLogStripped(0))
+#define procDbgLog(m, ...)                  (entryLogStripped(0))
+#endif
 
 inline void dInfoInternal(char * &pBuf, char *pBufEnd, const char *msg, ...)
 {
@@ -0,0 +1,235 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "Reactor.h"
+
+#if CONFIG_PROC_HAVE_EPOLL
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Counter of deliveries above the event bits
+#define dEventsDelivery		0x100
+
+#if CONFIG_PROC_HAVE_EPOLL
+#if CONFIG_PROC_HAVE_DRIVERS
+#define dThreadLocal thread_local
+#else
+#define dThreadLocal
+#endif
+
+struct ReactorThread
+{
+	ReactorThread()
+		: fdEpoll(-1)
+		, idPoll(1)
+		, numPolls(0)
+	{}
+	~ReactorThread()
+	{
+		if (fdEpoll >= 0)
+			::close(fdEpoll);
+	}
+
+	int fdEpoll;
+	uint32_t idPoll;
+	uint32_t numPolls;
+};
+
+static dThreadLocal ReactorThread reactorThread;
+
+static uint32_t epollToEvents(uint32_t flags)
+{
+	uint32_t events = 0;
+
+	if (flags & EPOLLIN)
+		events |= RevRead;
+
+	if (flags & EPOLLOUT)
+		events |= RevWrite;
+
+	if (flags & (EPOLLRDHUP | EPOLLHUP))
+		events |= RevHangUp;
+
+	if (flags & EPOLLERR)
+		events |= RevError;
+
+	return events;
+}
+
+static void reactorPoll(ReactorThread &rt)
+{
+	struct epoll_event events[CONFIG_PROC_REACTOR_NUM_EVENTS];
+	ReactorSlot *pSlot;
+	int numEvents;
+
+	numEvents = ::epoll_wait(rt.fdEpoll, events, CONFIG_PROC_REACTOR_NUM_EVENTS, 0);
+
+	++rt.idPoll;
+	++rt.numPolls;
+
+	for (int i = 0; i < numEvents; ++i)
+	{
+		pSlot = (ReactorSlot *)events[i].data.ptr;
+
+		// Counter first. Pending clears fail before the new events are visible
+		pSlot->eventsReady.fetch_add(dEventsDelivery);
+		pSlot->eventsReady.fetch_or(epollToEvents(events[i].events));
+	}
+}
+#endif
+
+/*
+Literature
+- https://man7.org/linux/man-pages/man7/epoll.7.html
+- https://man7.org/linux/man-pages/man2/epoll_ctl.2.html
+*/
+bool Reactor::slotAdd(ReactorSlot &slot, intptr_t fd, uint32_t events)
+{
+#if CONFIG_PROC_HAVE_EPOLL
+	ReactorThread &rt = reactorThread;
+	struct epoll_event ev;
+
+	if (fd < 0 || slot.fdEpoll >= 0)
+		return false;
+
+	if (rt.fdEpoll < 0)
+		rt.fdEpoll = ::epoll_create1(EPOLL_CLOEXEC);
+
+	if (rt.fdEpoll < 0)
+		return false;
+
+	ev.events = EPOLLET | EPOLLRDHUP;
+	ev.data.ptr = &slot;
+
+	if (events & RevRead)
+		ev.events |= EPOLLIN;
+
+	if (events & RevWrite)
+		ev.events |= EPOLLOUT;
+
+	if (::epoll_ctl(rt.fdEpoll, EPOLL_CTL_ADD, (int)fd, &ev))
+		return false;
+
+	slot.fd = fd;
+	slot.fdEpoll = rt.fdEpoll;
+	slot.eventsReady = 0;
+	slot.idPoll = rt.idPoll;
+
+	return true;
+#else
+	(void)slot;
+	(void)fd;
+	(void)events;
+	return false;
+#endif
+}
+
+void Reactor::slotRemove(ReactorSlot &slot)
+{
+#if CONFIG_PROC_HAVE_EPOLL
+	if (slot.fdEpoll < 0)
+		return;
+
+	::epoll_ctl(slot.fdEpoll, EPOLL_CTL_DEL, (int)slot.fd, NULL);
+#endif
+	slot.fd = -1;
+	slot.fdEpoll = -1;
+	slot.eventsReady = RevAll;
+}
+
+bool Reactor::slotActive(const ReactorSlot &slot)
+{
+	return slot.fdEpoll >= 0;
+}
+
+/*
+ * Must be called once per tick by the owner. The first
+ * slot which already knows the latest results triggers
+ * the next epoll_wait() of this thread
+ */
+uint32_t Reactor::eventsUpdate(ReactorSlot &slot)
+{
+#if CONFIG_PROC_HAVE_EPOLL
+	ReactorThread &rt = reactorThread;
+
+	if (slot.fdEpoll < 0 || slot.fdEpoll != rt.fdEpoll)
+	{
+		slot.eventsReady = RevAll;
+		return slot.eventsReady;
+	}
+
+	if (slot.idPoll == rt.idPoll)
+		reactorPoll(rt);
+
+	slot.idPoll = rt.idPoll;
+
+	return slot.eventsReady;
+#else
+	slot.eventsReady = RevAll;
+	return slot.eventsReady;
+#endif
+}
+
+/*
+ * Only for the thread which polls the reactor
+ */
+void Reactor::eventsClear(ReactorSlot &slot, uint32_t events)
+{
+	slot.eventsReady.fetch_and(~events);
+}
+
+/*
+ * For socket calls which may run on any thread. The events
+ * are cleared only if no poll delivered new events since
+ * eventsSeen has been read. This must happen before the call
+ */
+void Reactor::eventsClear(ReactorSlot &slot, uint32_t events, uint32_t eventsSeen)
+{
+	uint32_t eventsCur = slot.eventsReady.load();
+
+	while (!((eventsCur ^ eventsSeen) & ~(dEventsDelivery - 1)))
+	{
+		if (slot.eventsReady.compare_exchange_weak(eventsCur, eventsCur & ~events))
+			break;
+	}
+}
+
+uint32_t Reactor::numPollsGet()
+{
+#if CONFIG_PROC_HAVE_EPOLL
+	return reactorThread.numPolls;
+#else
+	return 0;
+#endif
+}
+
@@ -0,0 +1,135 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stdint.h>
+#include <atomic>
+
+#include "Processing.h"
+
+#ifndef CONFIG_PROC_HAVE_EPOLL
+#if defined(__linux__)
+#define CONFIG_PROC_HAVE_EPOLL			1
+#else
+#define CONFIG_PROC_HAVE_EPOLL			0
+#endif
+#endif
+
+#ifndef CONFIG_PROC_REACTOR_NUM_EVENTS
+#define CONFIG_PROC_REACTOR_NUM_EVENTS		64
+#endif
+
+enum ReactorEvent
+{
+	RevRead = 1,
+	RevWrite = 2,
+	RevHangUp = 4,
+	RevError = 8,
+	RevAll = 15,
+};
+
+/*
+ * Registration of a socket at the reactor of the current thread
+ * - Events are edge triggered. They stay set until
+ *   the owner clears them, usually after EAGAIN
+ * - Without a reactor every event is reported as possible
+ *   and the owner has to probe the socket itself. This is
+ *   also the state of a slot which is not registered
+ * - Bits above the events count the polls which delivered
+ *   events to this slot. Socket calls may run on another
+ *   thread than the poll. Their clear must not wipe events
+ *   delivered after the call
+ */
+struct ReactorSlot
+{
+	ReactorSlot()
+		: fd(-1)
+		, fdEpoll(-1)
+		, eventsReady(RevAll)
+		, idPoll(0)
+	{}
+	ReactorSlot(const ReactorSlot &o)
+		: fd(o.fd)
+		, fdEpoll(o.fdEpoll)
+		, eventsReady(o.eventsReady.load())
+		, idPoll(o.idPoll)
+	{}
+	ReactorSlot &operator=(const ReactorSlot &o)
+	{
+		fd = o.fd;
+		fdEpoll = o.fdEpoll;
+		eventsReady = o.eventsReady.load();
+		idPoll = o.idPoll;
+
+		return *this;
+	}
+
+	intptr_t fd;
+	int fdEpoll;
+	std::atomic<uint32_t> eventsReady;
+	uint32_t idPoll;
+};
+
+/*
+ * One reactor exists per driver thread and is shared by all
+ * processes of this driver. It is polled at most once per tick
+ * - Slots must be added, updated and removed by the thread
+ *   which drives the owning process
+ */
+class Reactor
+{
+
+public:
+
+	static bool slotAdd(ReactorSlot &slot, intptr_t fd, uint32_t events = RevRead);
+	static void slotRemove(ReactorSlot &slot);
+	static bool slotActive(const ReactorSlot &slot);
+
+	static uint32_t eventsUpdate(ReactorSlot &slot);
+	static void eventsClear(ReactorSlot &slot, uint32_t events);
+	static void eventsClear(ReactorSlot &slot, uint32_t events, uint32_t eventsSeen);
+
+	static uint32_t numPollsGet();
+
+private:
+
+	Reactor() {}
+	Reactor(const Reactor &) {}
+	Reactor &operator=(const Reactor &)
+	{
+		return *this;
+	}
+
+};
+
+#endif
+
@@ -293,8 +293,10 @@ Success SystemCommanding::process()
 		break;
 	case StWelcomeSend:
 
+		mpTrans->corkSet(true);
 		mpTrans->send(cWelcomeMsg.c_str(), cWelcomeMsg.size());
 		promptSend();
+		mpTrans->corkSet(false);
 
 		mState = StMain;
 
@@ -305,7 +307,10 @@ Success SystemCommanding::process()
 		if (success != Pending)
 			return success;
 
+		// Answer to the received keys in one segment
+		mpTrans->corkSet(true);
 		dataReceive();
+		mpTrans->corkSet(false);
 
 		if (!mDone)
 			break;
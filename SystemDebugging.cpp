@@ -51,11 +51,11 @@ typedef list<struct SystemDebuggingPeer>::iterator PeerIter;
 bool SystemDebugging::procTreeDetailed = true;
 bool SystemDebugging::procTreeColored = true;
 #endif
-queue<string> SystemDebugging::qLogEntries;
 #if CONFIG_PROC_HAVE_DRIVERS
 static mutex mtxLogEntries;
 #endif
 int SystemDebugging::levelLog = 3;
+size_t SystemDebugging::numLogReplay = CONFIG_DBG_NUM_LOG_REPLAY;
 
 const size_t SystemDebugging::maxPeers = 100;
 
@@ -63,12 +63,153 @@ const string cSeqCtrlC = "\xff\xf4\xff\xfd\x06";
 const size_t cLenSeqCtrlC = cSeqCtrlC.size();
 
 static char buffProcTree[8192];
+#if CONFIG_PROC_HAVE_LOG
+static char buffLogEncoded[1024];
+
+/*
+ * Log history
+ * - Ring of variable sized records: Header, text, process name
+ * - Positions and sequence numbers are absolute and never wrap
+ * - Oldest records are evicted when space runs out
+ * - Peers keep their own cursor. Nothing is copied for them
+ */
+struct LogHistoryHdr
+{
+	LogEntry entry;
+	uint32_t lenProcName;
+	uint32_t idxMsg;
+};
+
+static uint8_t buffLogHistory[CONFIG_DBG_SIZE_LOG_HISTORY];
+static uint64_t posLogOldest = 0;
+static uint64_t posLogNext = 0;
+static uint64_t seqLogOldest = 0;
+static uint64_t seqLogNext = 0;
+static bool logDumpRequested = false;
+static size_t numLogDump = 0;
+
+static void historyWrite(uint64_t pos, const void *pData, size_t len)
+{
+	size_t idx = pos % sizeof(buffLogHistory);
+	size_t lenPart = sizeof(buffLogHistory) - idx;
+
+	if (lenPart > len)
+		lenPart = len;
+
+	memcpy(buffLogHistory + idx, pData, lenPart);
+	memcpy(buffLogHistory, (const uint8_t *)pData + lenPart, len - lenPart);
+}
+
+static void historyRead(uint64_t pos, void *pData, size_t len)
+{
+	size_t idx = pos % sizeof(buffLogHistory);
+	size_t lenPart = sizeof(buffLogHistory) - idx;
+
+	if (lenPart > len)
+		lenPart = len;
+
+	memcpy(pData, buffLogHistory + idx, lenPart);
+	memcpy((uint8_t *)pData + lenPart, buffLogHistory, len - lenPart);
+}
+
+static size_t historyRecordSize(const LogHistoryHdr &hdr)
+{
+	return sizeof(hdr) + hdr.entry.lenText + hdr.lenProcName;
+}
+
+// Lock must be held by the caller
+static void historyAppend(const LogEntry *pEntry)
+{
+	LogHistoryHdr hdr;
+	size_t lenProcName = pEntry->procName ? strlen(pEntry->procName) : 0;
+	size_t lenRec = sizeof(hdr) + pEntry->lenText + lenProcName;
+
+	if (lenRec > sizeof(buffLogHistory))
+		return;
+
+	while (posLogNext + lenRec - posLogOldest > sizeof(buffLogHistory))
+	{
+		historyRead(posLogOldest, &hdr, sizeof(hdr));
+
+		posLogOldest += historyRecordSize(hdr);
+		++seqLogOldest;
+	}
+
+	hdr.entry = *pEntry;
+	hdr.lenProcName = lenProcName;
+	hdr.idxMsg = pEntry->msg - pEntry->text;
+
+	historyWrite(posLogNext, &hdr, sizeof(hdr));
+	historyWrite(posLogNext + sizeof(hdr), pEntry->text, pEntry->lenText);
+	historyWrite(posLogNext + sizeof(hdr) + pEntry->lenText, pEntry->procName, lenProcName);
+
+	posLogNext += lenRec;
+	++seqLogNext;
+}
+
+// Lock must be held by the caller
+static void historyRewind(struct SystemDebuggingPeer &peer, size_t numEntries)
+{
+	LogHistoryHdr hdr;
+	uint64_t numAvail = seqLogNext - seqLogOldest;
+
+	if (numEntries > numAvail)
+		numEntries = numAvail;
+
+	peer.seqLog = seqLogOldest;
+	peer.posLog = posLogOldest;
+
+	while (peer.seqLog + numEntries < seqLogNext)
+	{
+		historyRead(peer.posLog, &hdr, sizeof(hdr));
+
+		peer.posLog += historyRecordSize(hdr);
+		++peer.seqLog;
+	}
+}
+
+// Lock must be held by the caller
+static bool historyEntryGet(struct SystemDebuggingPeer &peer,
+				SystemDebuggingLogEntry &entry, uint64_t &numLost)
+{
+	LogHistoryHdr hdr;
+
+	if (peer.seqLog < seqLogOldest)
+	{
+		numLost += seqLogOldest - peer.seqLog;
+
+		peer.seqLog = seqLogOldest;
+		peer.posLog = posLogOldest;
+	}
+
+	if (peer.seqLog >= seqLogNext)
+		return false;
+
+	historyRead(peer.posLog, &hdr, sizeof(hdr));
+
+	entry.text.resize(hdr.entry.lenText);
+	entry.procName.resize(hdr.lenProcName);
+
+	historyRead(peer.posLog + sizeof(hdr), &entry.text[0], hdr.entry.lenText);
+	historyRead(peer.posLog + sizeof(hdr) + hdr.entry.lenText,
+				&entry.procName[0], hdr.lenProcName);
+
+	entry.entry = hdr.entry;
+	entry.idxMsg = hdr.idxMsg;
+
+	peer.posLog += historyRecordSize(hdr);
+	++peer.seqLog;
+
+	return true;
+}
+#endif
 
 SystemDebugging::SystemDebugging(Processing *pTreeRoot)
 	: Processing("SystemDebugging")
 	, mpTreeRoot(pTreeRoot)
 	, mpLstProc(NULL)
 	, mpLstLog(NULL)
+	, mpLstLogJson(NULL)
 	, mpLstCmd(NULL)
 	, mpLstCmdAuto(NULL)
 	, mPeerList()
@@ -104,6 +245,12 @@ bool SystemDebugging::ready()
 void SystemDebugging::levelLogSet(int lvl)
 {
 	levelLog = lvl;
+	levelLogHookSet(lvl);
+}
+
+void SystemDebugging::logReplaySet(size_t numEntries)
+{
+	numLogReplay = numEntries;
 }
 
 Success SystemDebugging::process()
@@ -127,8 +274,14 @@ Success SystemDebugging::process()
 
 		cmdReg("levelLog", &SystemDebugging::cmdLevelLogSet, "", "Set the log level for stdout", cInternalCmdCls);
 		cmdReg("levelLogSys", &SystemDebugging::cmdLevelLogSysSet, "", "Set the log level for socket", cInternalCmdCls);
-
-		entryLogCreateSet(SystemDebugging::entryLogEnqueue);
+		cmdReg("levelLogFile", &SystemDebugging::cmdLevelLogFileSet, "", "Set the log level for a source file", cInternalCmdCls);
+#if CONFIG_PROC_HAVE_LOG
+		cmdReg("logDump", &SystemDebugging::cmdLogDump, "", "Send the log history to all log peers", cInternalCmdCls);
+#endif
+		levelLogHookSet(levelLog);
+#if CONFIG_PROC_HAVE_LOG
+		entryLogStructuredSet(SystemDebugging::entryLogEnqueue);
+#endif
 
 		mState = StMain;
 
@@ -171,6 +324,15 @@ Success SystemDebugging::listenersStart()
 	mpLstLog->portSet(mPortStart + 2, mListenLocal);
 
 	start(mpLstLog);
+
+	// log as JSON lines
+	mpLstLogJson = TcpListening::create();
+	if (!mpLstLogJson)
+		return procErrLog(-1, "could not create process");
+
+	mpLstLogJson->portSet(mPortStart + 8, mListenLocal);
+
+	start(mpLstLogJson);
 #endif
 	// command
 	mpLstCmd = TcpListening::create();
@@ -200,6 +362,7 @@ void SystemDebugging::peerListUpdate()
 	peerAdd(mpLstProc, PeerProc, "process tree");
 #if CONFIG_PROC_HAVE_LOG
 	peerAdd(mpLstLog, PeerLog, "log");
+	peerAdd(mpLstLogJson, PeerLogJson, "log JSON");
 #endif
 	peerAdd(mpLstCmd, PeerCmd, "command");
 }
@@ -281,7 +444,7 @@ void SystemDebugging::peerCheck()
 		if (peer.type == PeerProc)
 			disconnectReq = disconnectRequestedCheck((TcpTransfering *)pProc);
 		else
-		if (peer.type == PeerLog)
+		if (peer.type == PeerLog || peer.type == PeerLogJson)
 		{
 			TcpTransfering *pTrans = (TcpTransfering *)pProc;
 			disconnectReq = disconnectRequestedCheck(pTrans);
@@ -343,6 +506,17 @@ void SystemDebugging::peerAdd(TcpListening *pListener, enum PeerType peerType, c
 		peer.type = peerType;
 		peer.typeDesc = pTypeDesc;
 		peer.pProc = pProc;
+		peer.seqLog = 0;
+		peer.posLog = 0;
+#if CONFIG_PROC_HAVE_LOG
+		if (peerType == PeerLog || peerType == PeerLogJson)
+		{
+#if CONFIG_PROC_HAVE_DRIVERS
+			Guard lock(mtxLogEntries);
+#endif
+			historyRewind(peer, numLogReplay);
+		}
+#endif
 
 		mPeerList.push_back(peer);
 
@@ -419,41 +593,93 @@ void SystemDebugging::processTreeSend()
 #if CONFIG_PROC_HAVE_LOG
 void SystemDebugging::logEntriesSend()
 {
+	SystemDebuggingLogEntry entry;
 	string msg;
 	PeerIter iter;
-	struct SystemDebuggingPeer peer;
 	TcpTransfering *pTrans = NULL;
+	uint64_t numLost;
+	size_t lenJson;
+	bool entryFound;
 
-	while (1)
 	{
-		{
 #if CONFIG_PROC_HAVE_DRIVERS
-			Guard lock(mtxLogEntries);
+		Guard lock(mtxLogEntries);
 #endif
-			if (!qLogEntries.size())
-				break;
+		iter = mPeerList.begin();
+		while (logDumpRequested && iter != mPeerList.end())
+		{
+			struct SystemDebuggingPeer &peer = *iter++;
 
-			msg = qLogEntries.front();
-			qLogEntries.pop();
+			if (peer.type == PeerLog || peer.type == PeerLogJson)
+				historyRewind(peer, numLogDump);
 		}
 
-		if (!msg.size())
-			break;
+		logDumpRequested = false;
+	}
 
-		msg += "\r\n";
+	iter = mPeerList.begin();
+	while (iter != mPeerList.end())
+	{
+		struct SystemDebuggingPeer &peer = *iter++;
+		pTrans = (TcpTransfering *)peer.pProc;
 
-		iter = mPeerList.begin();
-		while (iter != mPeerList.end())
+		if (peer.type != PeerLog && peer.type != PeerLogJson)
+			continue;
+
+		// Entries stay in the history until the peer is ready
+		if (!pTrans->mSendReady)
+			continue;
+
+		pTrans->corkSet(true);
+
+		while (pTrans->sendQueueBytes() < CONFIG_DBG_SIZE_LOG_QUEUE_PEER)
 		{
-			peer = *iter++;
-			pTrans = (TcpTransfering *)peer.pProc;
+			numLost = 0;
+			{
+#if CONFIG_PROC_HAVE_DRIVERS
+				Guard lock(mtxLogEntries);
+#endif
+				entryFound = historyEntryGet(peer, entry, numLost);
+			}
 
-			if (!pTrans->mSendReady)
-				continue;
+			if (numLost && peer.type == PeerLog)
+			{
+				msg = to_string(numLost) + " log entries lost\r\n";
+				pTrans->send(msg.c_str(), msg.size());
+			}
+
+			if (numLost && peer.type == PeerLogJson)
+			{
+				msg = "{\"lost\":" + to_string(numLost) + "}\n";
+				pTrans->send(msg.c_str(), msg.size());
+			}
+
+			if (!entryFound)
+				break;
 
 			if (peer.type == PeerLog)
+			{
+				msg = entry.text + "\r\n";
 				pTrans->send(msg.c_str(), msg.size());
+				continue;
+			}
+
+			// Strings are owned by the history entry
+			entry.entry.text = entry.text.c_str();
+			entry.entry.lenText = entry.text.size();
+			entry.entry.msg = entry.entry.text + entry.idxMsg;
+			entry.entry.lenMsg = entry.entry.lenText - entry.idxMsg;
+			entry.entry.procName = entry.procName.size() ? entry.procName.c_str() : NULL;
+
+			lenJson = logEntryEncode(buffLogEncoded,
+						buffLogEncoded + sizeof(buffLogEncoded) - 1,
+						&entry.entry, LogEncJson);
+			buffLogEncoded[lenJson++] = '\n';
+
+			pTrans->send(buffLogEncoded, lenJson);
 		}
+
+		pTrans->corkSet(false);
 	}
 }
 #endif
@@ -461,6 +687,19 @@ void SystemDebugging::logEntriesSend()
 void SystemDebugging::processInfo(char *pBuf, char *pBufEnd)
 {
 	dInfo("Update period [ms]\t\t%d\n", (int)mUpdateMs);
+#if CONFIG_PROC_HAVE_LOG
+	uint64_t numEntries, numBytes;
+	{
+#if CONFIG_PROC_HAVE_DRIVERS
+		Guard lock(mtxLogEntries);
+#endif
+		numEntries = seqLogNext - seqLogOldest;
+		numBytes = posLogNext - posLogOldest;
+	}
+
+	dInfo("Log history\t\t\t%d entries, %d/%d bytes\n",
+			(int)numEntries, (int)numBytes, (int)sizeof(buffLogHistory));
+#endif
 }
 
 /* static functions */
@@ -488,28 +727,66 @@ void SystemDebugging::cmdLevelLogSysSet(char *pArgs, char *pBuf, char *pBufEnd)
 	dInfo("System log level set to %d", lvl);
 }
 
-void SystemDebugging::entryLogEnqueue(
-		const int severity,
-		const void *pProc,
-		const char *filename,
-		const char *function,
-		const int line,
-		const int16_t code,
-		const char *msg,
-		const size_t len)
+void SystemDebugging::cmdLevelLogFileSet(char *pArgs, char *pBuf, char *pBufEnd)
+{
+	char *pLvl = pArgs ? strchr(pArgs, ' ') : NULL;
+	int lvl = -1;
+
+	if (!pArgs || !*pArgs)
+	{
+		dInfo("Usage: levelLogFile <file> [level]");
+		return;
+	}
+
+	if (pLvl)
+	{
+		*pLvl++ = 0;
+		lvl = atoi(pLvl);
+	}
+
+	if (!levelLogFileSet(pArgs, lvl))
+	{
+		dInfo("Could not set log level for %s", pArgs);
+		return;
+	}
+
+	if (lvl < 0)
+	{
+		dInfo("Log level for %s removed", pArgs);
+		return;
+	}
+
+	dInfo("Log level for %s set to %d", pArgs, lvl);
+}
+
+#if CONFIG_PROC_HAVE_LOG
+void SystemDebugging::cmdLogDump(char *pArgs, char *pBuf, char *pBufEnd)
 {
+	int num = pArgs ? atoi(pArgs) : 0;
+	size_t numEntries;
+
+	{
 #if CONFIG_PROC_HAVE_DRIVERS
-	Guard lock(mtxLogEntries);
+		Guard lock(mtxLogEntries);
 #endif
-	(void)pProc;
-	(void)filename;
-	(void)function;
-	(void)line;
-	(void)code;
+		numEntries = seqLogNext - seqLogOldest;
 
-	if (severity > levelLog)
-		return;
+		if (num > 0 && (size_t)num < numEntries)
+			numEntries = num;
 
-	qLogEntries.emplace(msg, len);
+		numLogDump = numEntries;
+		logDumpRequested = true;
+	}
+
+	dInfo("Sending %d log entries to log peers", (int)numEntries);
 }
 
+void SystemDebugging::entryLogEnqueue(const LogEntry *pEntry)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mtxLogEntries);
+#endif
+	historyAppend(pEntry);
+}
+#endif
+
@@ -33,7 +33,6 @@
 
 #include <string>
 #include <list>
-#include <queue>
 #include <time.h>
 
 #include "Processing.h"
@@ -45,6 +44,7 @@ enum PeerType {
 	PeerProc = 0,
 	PeerLog,
 	PeerCmd,
+	PeerLogJson,
 };
 
 struct SystemDebuggingPeer
@@ -52,8 +52,32 @@ struct SystemDebuggingPeer
 	enum PeerType type;
 	std::string typeDesc;
 	Processing *pProc;
+	uint64_t seqLog;	// Next entry of the log history to be sent
+	uint64_t posLog;
 };
 
+// Strings of the log entry are owned by this structure
+struct SystemDebuggingLogEntry
+{
+	LogEntry entry;
+	std::string text;
+	std::string procName;
+	size_t idxMsg;
+};
+
+#ifndef CONFIG_DBG_SIZE_LOG_HISTORY
+#define CONFIG_DBG_SIZE_LOG_HISTORY		(32 * 1024)
+#endif
+
+#ifndef CONFIG_DBG_NUM_LOG_REPLAY
+#define CONFIG_DBG_NUM_LOG_REPLAY		100
+#endif
+
+// Entries stay in the history while a peer has more data queued
+#ifndef CONFIG_DBG_SIZE_LOG_QUEUE_PEER
+#define CONFIG_DBG_SIZE_LOG_QUEUE_PEER		(64 * 1024)
+#endif
+
 class SystemDebugging : public Processing
 {
 
@@ -70,6 +94,7 @@ public:
 	bool ready();
 
 	static void levelLogSet(int lvl);
+	static void logReplaySet(size_t numEntries);
 
 protected:
 
@@ -83,6 +108,7 @@ private:
 		, mpTreeRoot(NULL)
 		, mpLstProc(NULL)
 		, mpLstLog(NULL)
+		, mpLstLogJson(NULL)
 		, mpLstCmd(NULL)
 		, mpLstCmdAuto(NULL)
 		, mPeerList()
@@ -102,6 +128,7 @@ private:
 		, mpTreeRoot(NULL)
 		, mpLstProc(NULL)
 		, mpLstLog(NULL)
+		, mpLstLogJson(NULL)
 		, mpLstCmd(NULL)
 		, mpLstCmdAuto(NULL)
 		, mPeerList()
@@ -121,6 +148,7 @@ private:
 		mpTreeRoot = NULL;
 		mpLstProc = NULL;
 		mpLstLog = NULL;
+		mpLstLogJson = NULL;
 		mpLstCmd = NULL;
 		mpLstCmdAuto = NULL;
 		mPeerList.clear();
@@ -162,6 +190,7 @@ private:
 	Processing *mpTreeRoot;
 	TcpListening *mpLstProc;
 	TcpListening *mpLstLog;
+	TcpListening *mpLstLogJson;
 	TcpListening *mpLstCmd;
 	TcpListening *mpLstCmdAuto;
 
@@ -180,21 +209,17 @@ private:
 	/* static functions */
 	static void cmdLevelLogSet(char *pArgs, char *pBuf, char *pBufEnd);
 	static void cmdLevelLogSysSet(char *pArgs, char *pBuf, char *pBufEnd);
+	static void cmdLevelLogFileSet(char *pArgs, char *pBuf, char *pBufEnd);
 	static void procTreeDetailedToggle(char *pArgs, char *pBuf, char *pBufEnd);
 	static void procTreeColoredToggle(char *pArgs, char *pBuf, char *pBufEnd);
-	static void entryLogEnqueue(
-			const int severity,
-			const void *pProc,
-			const char *filename,
-			const char *function,
-			const int line,
-			const int16_t code,
-			const char *msg,
-			const size_t len);
+#if CONFIG_PROC_HAVE_LOG
+	static void cmdLogDump(char *pArgs, char *pBuf, char *pBufEnd);
+	static void entryLogEnqueue(const LogEntry *pEntry);
+#endif
 
 	/* static variables */
-	static std::queue<std::string> qLogEntries;
 	static int levelLog;
+	static size_t numLogReplay;
 
 	/* constants */
 	static const size_t maxPeers;
@@ -0,0 +1,416 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <chrono>
+
+#include "TcpConnPooling.h"
+
+#define dForEach_ProcState(gen) \
+		gen(StStart) \
+		gen(StMain) \
+
+#define dGenProcStateEnum(s) s,
+dProcessStateEnum(ProcState);
+
+#if 0
+#define dGenProcStateString(s) #s,
+dProcessStateStr(ProcState);
+#endif
+
+using namespace std;
+using namespace chrono;
+
+TcpConnPooling::TcpConnPooling()
+	: Processing("TcpConnPooling")
+#if CONFIG_PROC_HAVE_DRIVERS
+	, mHostsMtx()
+#endif
+	, mHosts()
+	, mTmoIdleMs(CONFIG_POOL_TIMEOUT_IDLE_MS)
+	, mHits(0)
+	, mMisses(0)
+	, mEvictions(0)
+	, mConnFailed(0)
+	, mConnRetries(0)
+	, mNumWaits(0)
+	, mWaitSumMs(0)
+	, mWaitMaxMs(0)
+{
+	mState = StStart;
+}
+
+/* member functions */
+
+/*
+ * Returns NULL while no connection is ready. The
+ * first miss requests a new connection
+ */
+TcpTransfering *TcpConnPooling::connTake(const string &host, uint16_t port)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mHostsMtx);
+#endif
+	list<TcpPoolConn>::iterator iter;
+	uint32_t curTimeMs = millis();
+	uint32_t waitMs;
+
+	TcpPoolHost *pHost = hostFind(host, port);
+	if (!pHost)
+		return NULL;
+
+	iter = pHost->conns.begin();
+	for (; iter != pHost->conns.end(); ++iter)
+	{
+		if (iter->lent || iter->dropReq)
+			continue;
+
+		if (!iter->pTrans->mSendReady || iter->pTrans->success() != Pending)
+			continue;
+
+		iter->lent = true;
+		iter->used = true;
+		iter->sinceMs = curTimeMs;
+
+		if (!pHost->waiting)
+		{
+			++mHits;
+			return iter->pTrans;
+		}
+
+		pHost->waiting = false;
+
+		waitMs = curTimeMs - pHost->waitStartMs;
+
+		++mNumWaits;
+		mWaitSumMs += waitMs;
+
+		if (waitMs > mWaitMaxMs)
+			mWaitMaxMs = waitMs;
+
+		return iter->pTrans;
+	}
+
+	if (!pHost->waiting)
+	{
+		++mMisses;
+		pHost->waiting = true;
+		pHost->waitStartMs = curTimeMs;
+	}
+
+	return NULL;
+}
+
+void TcpConnPooling::connGiveBack(TcpTransfering *pTrans)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mHostsMtx);
+#endif
+	list<TcpPoolHost>::iterator iterHost;
+	list<TcpPoolConn>::iterator iter;
+	TcpPoolConn *pConn = NULL;
+	size_t numIdle = 0;
+
+	if (!pTrans)
+		return;
+
+	iterHost = mHosts.begin();
+	for (; iterHost != mHosts.end() && !pConn; ++iterHost)
+	{
+		numIdle = 0;
+
+		iter = iterHost->conns.begin();
+		for (; iter != iterHost->conns.end(); ++iter)
+		{
+			if (iter->pTrans == pTrans)
+				pConn = &(*iter);
+			else
+			if (!iter->lent && !iter->dropReq && iter->pTrans->mSendReady)
+				++numIdle;
+		}
+	}
+
+	if (!pConn)
+	{
+		procWrnLog("connection not from this pool");
+		return;
+	}
+
+	pConn->lent = false;
+	pConn->sinceMs = millis();
+
+	// Unread data means the protocol state is unknown
+	if (pTrans->success() != Pending || pTrans->recvQueueBytes())
+		pConn->dropReq = true;
+
+	if (numIdle >= CONFIG_POOL_NUM_IDLE_PER_HOST_MAX)
+		pConn->dropReq = true;
+}
+
+void TcpConnPooling::warmKeep(const string &host, uint16_t port, size_t numConn)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mHostsMtx);
+#endif
+	TcpPoolHost *pHost = hostFind(host, port);
+	if (!pHost)
+		return;
+
+	pHost->numWarmMin = numConn;
+}
+
+void TcpConnPooling::idleTimeoutSet(uint32_t tmoMs)
+{
+	mTmoIdleMs = tmoMs;
+}
+
+Success TcpConnPooling::process()
+{
+	list<TcpPoolHost>::iterator iter;
+	uint32_t curTimeMs = millis();
+#if 0
+	dStateTrace;
+#endif
+	switch (mState)
+	{
+	case StStart:
+
+		mState = StMain;
+
+		break;
+	case StMain:
+	{
+#if CONFIG_PROC_HAVE_DRIVERS
+		Guard lock(mHostsMtx);
+#endif
+		iter = mHosts.begin();
+		for (; iter != mHosts.end(); ++iter)
+			connsMaintain(*iter, curTimeMs);
+
+		break;
+	}
+	default:
+		break;
+	}
+
+	return Pending;
+}
+
+// Connections are children and removed with the pool
+Success TcpConnPooling::shutdown()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mHostsMtx);
+#endif
+	mHosts.clear();
+
+	return Positive;
+}
+
+// Lock must be held by the caller
+TcpPoolHost *TcpConnPooling::hostFind(const string &host, uint16_t port)
+{
+	list<TcpPoolHost>::iterator iter;
+
+	iter = mHosts.begin();
+	for (; iter != mHosts.end(); ++iter)
+	{
+		if (iter->port == port && iter->host == host)
+			return &(*iter);
+	}
+
+	mHosts.push_back(TcpPoolHost());
+
+	TcpPoolHost &entry = mHosts.back();
+
+	entry.host = host;
+	entry.port = port;
+
+	return &entry;
+}
+
+/*
+ * Drops dead and expired connections and starts
+ * new ones for waiting requesters and warm minimums.
+ * Unreachable hosts get no new connect on every tick
+ */
+void TcpConnPooling::connsMaintain(TcpPoolHost &host, uint32_t curTimeMs)
+{
+	list<TcpPoolConn>::iterator iter;
+	size_t numReady = 0, numConnecting = 0;
+	size_t numWanted;
+	TcpTransfering *pTrans;
+	bool drop;
+
+	iter = host.conns.begin();
+	while (iter != host.conns.end())
+	{
+		pTrans = iter->pTrans;
+
+		if (iter->lent)
+		{
+			++iter;
+			continue;
+		}
+
+		drop = iter->dropReq;
+
+		if (!pTrans->mSendReady && pTrans->success() != Pending)
+		{
+			++mConnFailed;
+
+			host.delayRetryMs <<= 1;
+
+			if (!host.delayRetryMs)
+				host.delayRetryMs = CONFIG_POOL_DELAY_RETRY_MIN_MS;
+
+			if (host.delayRetryMs > CONFIG_POOL_DELAY_RETRY_MAX_MS)
+				host.delayRetryMs = CONFIG_POOL_DELAY_RETRY_MAX_MS;
+
+			host.failedMs = curTimeMs;
+
+			repel(pTrans);
+			iter = host.conns.erase(iter);
+			continue;
+		}
+
+		if (pTrans->success() != Pending)
+			drop = true;
+
+		if (pTrans->mSendReady && curTimeMs - iter->sinceMs > mTmoIdleMs)
+			drop = true;
+
+		// Late response. Received by the connection itself
+		if (iter->used && pTrans->recvQueueBytes())
+			drop = true;
+
+		if (drop)
+		{
+			++mEvictions;
+
+			repel(pTrans);
+			iter = host.conns.erase(iter);
+			continue;
+		}
+
+		if (pTrans->mSendReady)
+		{
+			host.delayRetryMs = 0;
+			++numReady;
+		}
+		else
+			++numConnecting;
+
+		++iter;
+	}
+
+	numWanted = host.numWarmMin;
+
+	if (host.waiting && numWanted < 1)
+		numWanted = 1;
+
+	if (numReady + numConnecting >= numWanted)
+		return;
+
+	if (host.conns.size() >= CONFIG_POOL_NUM_CONN_PER_HOST_MAX)
+		return;
+
+	if (host.delayRetryMs && curTimeMs - host.failedMs < host.delayRetryMs)
+		return;
+
+	pTrans = TcpTransfering::create(host.host, host.port);
+	if (!pTrans)
+	{
+		procErrLog(-1, "could not create process");
+		return;
+	}
+
+	start(pTrans);
+
+	if (host.delayRetryMs)
+		++mConnRetries;
+
+	host.conns.push_back(TcpPoolConn());
+	host.conns.back().pTrans = pTrans;
+	host.conns.back().sinceMs = curTimeMs;
+}
+
+void TcpConnPooling::processInfo(char *pBuf, char *pBufEnd)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mHostsMtx);
+#endif
+	list<TcpPoolHost>::const_iterator iterHost;
+	list<TcpPoolConn>::const_iterator iter;
+	size_t numIdle, numLent, numConnecting;
+
+	dInfo("Hits\t\t\t%u\n", (unsigned)mHits);
+	dInfo("Misses\t\t\t%u\n", (unsigned)mMisses);
+	dInfo("Evictions\t\t%u\n", (unsigned)mEvictions);
+	dInfo("Connects failed\t\t%u\n", (unsigned)mConnFailed);
+	dInfo("Connects retried\t%u\n", (unsigned)mConnRetries);
+	dInfo("Wait time\t\tavg %ums, max %ums\n",
+			(unsigned)(mNumWaits ? mWaitSumMs / mNumWaits : 0),
+			(unsigned)mWaitMaxMs);
+
+	iterHost = mHosts.begin();
+	for (; iterHost != mHosts.end(); ++iterHost)
+	{
+		numIdle = 0;
+		numLent = 0;
+		numConnecting = 0;
+
+		iter = iterHost->conns.begin();
+		for (; iter != iterHost->conns.end(); ++iter)
+		{
+			if (iter->lent)
+				++numLent;
+			else
+			if (iter->pTrans->mSendReady)
+				++numIdle;
+			else
+				++numConnecting;
+		}
+
+		dInfo("%s:%u\t\tidle %zu, lent %zu, connecting %zu, retry delay %ums\n",
+				iterHost->host.c_str(), (unsigned)iterHost->port,
+				numIdle, numLent, numConnecting,
+				(unsigned)iterHost->delayRetryMs);
+	}
+}
+
+/* static functions */
+
+uint32_t TcpConnPooling::millis()
+{
+	auto now = steady_clock::now();
+	auto nowMs = time_point_cast<milliseconds>(now);
+	return (uint32_t)nowMs.time_since_epoch().count();
+}
+
@@ -0,0 +1,215 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef TCP_CONN_POOLING_H
+#define TCP_CONN_POOLING_H
+
+#include <string>
+#include <list>
+
+#include "Processing.h"
+#include "TcpTransfering.h"
+
+#ifndef CONFIG_POOL_NUM_CONN_PER_HOST_MAX
+#define CONFIG_POOL_NUM_CONN_PER_HOST_MAX	8
+#endif
+
+#ifndef CONFIG_POOL_NUM_IDLE_PER_HOST_MAX
+#define CONFIG_POOL_NUM_IDLE_PER_HOST_MAX	4
+#endif
+
+#ifndef CONFIG_POOL_TIMEOUT_IDLE_MS
+#define CONFIG_POOL_TIMEOUT_IDLE_MS		30000
+#endif
+
+// Delay before a failed connect is retried. Doubled per failure
+#ifndef CONFIG_POOL_DELAY_RETRY_MIN_MS
+#define CONFIG_POOL_DELAY_RETRY_MIN_MS		100
+#endif
+
+#ifndef CONFIG_POOL_DELAY_RETRY_MAX_MS
+#define CONFIG_POOL_DELAY_RETRY_MAX_MS		30000
+#endif
+
+struct TcpPoolConn
+{
+	TcpPoolConn()
+		: pTrans(NULL)
+		, sinceMs(0)
+		, lent(false)
+		, used(false)
+		, dropReq(false)
+	{}
+
+	TcpTransfering *pTrans;
+	uint32_t sinceMs;
+	bool lent;
+	bool used;
+	bool dropReq;
+};
+
+struct TcpPoolHost
+{
+	TcpPoolHost()
+		: host("")
+		, port(0)
+		, conns()
+		, numWarmMin(0)
+		, waiting(false)
+		, waitStartMs(0)
+		, delayRetryMs(0)
+		, failedMs(0)
+	{}
+
+	std::string host;
+	uint16_t port;
+	std::list<TcpPoolConn> conns;
+	size_t numWarmMin;
+	bool waiting;
+	uint32_t waitStartMs;
+
+	// Zero while the host is reachable
+	uint32_t delayRetryMs;
+	uint32_t failedMs;
+};
+
+/*
+ * Keeps client connections per host and port open for reuse
+ * - Requesters call connTake() every tick until a connection
+ *   is returned. Connections are established by the pool
+ * - connGiveBack() returns a connection without closing it.
+ *   Connections with unread data or errors are dropped
+ * - Idle connections are checked on every tick and dropped
+ *   when closed by the peer or after the idle timeout.
+ *   Returned connections are dropped when data arrives
+ * - Failed connects are retried after a delay which grows
+ *   exponentially until a connection is established
+ * - Connections are children of the pool. The pool must
+ *   outlive the requesters
+ */
+class TcpConnPooling : public Processing
+{
+
+public:
+
+	static TcpConnPooling *create()
+	{
+		return new (std::nothrow) TcpConnPooling;
+	}
+
+	TcpTransfering *connTake(const std::string &host, uint16_t port);
+	void connGiveBack(TcpTransfering *pTrans);
+	void warmKeep(const std::string &host, uint16_t port, size_t numConn);
+	void idleTimeoutSet(uint32_t tmoMs);
+
+protected:
+
+	virtual ~TcpConnPooling() {}
+
+private:
+
+	TcpConnPooling();
+	TcpConnPooling(const TcpConnPooling &)
+		: Processing("")
+#if CONFIG_PROC_HAVE_DRIVERS
+		, mHostsMtx()
+#endif
+		, mHosts()
+		, mTmoIdleMs(0)
+		, mHits(0)
+		, mMisses(0)
+		, mEvictions(0)
+		, mConnFailed(0)
+		, mConnRetries(0)
+		, mNumWaits(0)
+		, mWaitSumMs(0)
+		, mWaitMaxMs(0)
+	{
+		mState = 0;
+	}
+	TcpConnPooling &operator=(const TcpConnPooling &)
+	{
+		mHosts.clear();
+		mTmoIdleMs = 0;
+		mHits = 0;
+		mMisses = 0;
+		mEvictions = 0;
+		mConnFailed = 0;
+		mConnRetries = 0;
+		mNumWaits = 0;
+		mWaitSumMs = 0;
+		mWaitMaxMs = 0;
+
+		mState = 0;
+
+		return *this;
+	}
+
+	/*
+	 * Naming of functions:  objectVerb()
+	 * Example:              peerAdd()
+	 */
+
+	/* member functions */
+	Success process();
+	Success shutdown();
+
+	TcpPoolHost *hostFind(const std::string &host, uint16_t port);
+	void connsMaintain(TcpPoolHost &host, uint32_t curTimeMs);
+	void processInfo(char *pBuf, char *pBufEnd);
+
+	/* member variables */
+#if CONFIG_PROC_HAVE_DRIVERS
+	std::mutex mHostsMtx;
+#endif
+	std::list<TcpPoolHost> mHosts;
+	uint32_t mTmoIdleMs;
+
+	// statistics
+	uint32_t mHits;
+	uint32_t mMisses;
+	uint32_t mEvictions;
+	uint32_t mConnFailed;
+	uint32_t mConnRetries;
+	uint32_t mNumWaits;
+	uint32_t mWaitSumMs;
+	uint32_t mWaitMaxMs;
+
+	/* static functions */
+	static uint32_t millis();
+
+	/* static variables */
+
+	/* constants */
+
+};
+
+#endif
+
@@ -31,6 +31,10 @@
 #include <string.h>
 #ifndef _WIN32
 #include <unistd.h>
+#include <netinet/tcp.h>
+#endif
+#if defined(__linux__)
+#include <linux/filter.h>
 #endif
 #include "TcpListening.h"
 
@@ -62,15 +66,31 @@ TcpListening::TcpListening()
 	, mPort(0)
 	, mLocalOnly(false)
 	, mMaxConn(200)
+	, mReusePort(false)
+	, mSteerByCpu(false)
+	, mBacklog(8192)
+	, mDeferAcceptSec(0)
+	, mMaxConnPerSource(0)
+	, mConnPerSource()
+	, mSourcesQueued()
 	, mInterrupted(false)
 	, mCntSkip(0)
+	, mOpts()
 	, mFdLstIPv4(INVALID_SOCKET)
 	, mFdLstIPv6(INVALID_SOCKET)
+	, mSlotLstIPv4()
+	, mSlotLstIPv6()
+	, mpUringLstIPv4(NULL)
+	, mpUringLstIPv6(NULL)
 	, mAddrIPv4("")
 	, mAddrIPv6("")
 	, mConnCreated(0)
+	, mWakeups(0)
+	, mConnRejectedSource(0)
 {
 	mState = StStart;
+
+	mOpts.keepAlive = 1;
 }
 
 void TcpListening::portSet(uint16_t port, bool localOnly)
@@ -84,6 +104,42 @@ void TcpListening::maxConnSet(size_t maxConn)
 	mMaxConn = maxConn;
 }
 
+void TcpListening::backlogSet(int backlog)
+{
+	mBacklog = backlog;
+}
+
+/*
+ * Accepted connections are reported only after the peer
+ * has sent data or the timeout expired. Linux only
+ */
+void TcpListening::deferAcceptSet(uint32_t timeoutSec)
+{
+	mDeferAcceptSec = timeoutSec;
+}
+
+// Limits the connections of one source address in ppPeerFd. 0 .. No limit
+void TcpListening::maxConnPerSourceSet(size_t maxConn)
+{
+	mMaxConnPerSource = maxConn;
+}
+
+void TcpListening::reusePortSet(bool steerByCpu)
+{
+	mReusePort = true;
+	mSteerByCpu = steerByCpu;
+}
+
+void TcpListening::optionsSet(const TcpSocketOptions &opts)
+{
+	mOpts = opts;
+}
+
+const TcpSocketOptions &TcpListening::options() const
+{
+	return mOpts;
+}
+
 SOCKET TcpListening::nextPeerFd()
 {
 	PipeEntry<SOCKET> peerFdEntry;
@@ -102,6 +158,7 @@ Literature socket programming:
 Success TcpListening::process()
 {
 	Success success;
+	uint32_t events;
 #ifdef _WIN32
 	bool ok;
 #endif
@@ -134,19 +191,61 @@ Success TcpListening::process()
 
 		//procDbgLog("creating listening sockets: done");
 
+		// io_uring replaces the reactor if enabled
+		mpUringLstIPv4 = Uring::acceptStart(mFdLstIPv4);
+		if (mpUringLstIPv4)
+		{
+			mpUringLstIPv6 = Uring::acceptStart(mFdLstIPv6);
+
+			mState = StMain;
+			break;
+		}
+
+		// Without reactor the sockets are polled every few ticks
+		if (!Reactor::slotAdd(mSlotLstIPv4, mFdLstIPv4))
+			procDbgLog("accepting without reactor");
+
+		Reactor::slotAdd(mSlotLstIPv6, mFdLstIPv6);
+
 		mState = StMain;
 
 		break;
 	case StMain:
 
-		++mCntSkip;
-		if (mCntSkip < dCntSkipMax)
-			return Pending;
-		mCntSkip = 0;
+		sourcesRelease();
+
+		if (mpUringLstIPv4)
+		{
+			success = connectionsTake(mpUringLstIPv4);
+			if (success == Pending)
+				success = connectionsTake(mpUringLstIPv6);
 
+			if (success != Pending)
+				return success;
+
+			return mInterrupted ? Positive : Pending;
+		}
+
+		if (!Reactor::slotActive(mSlotLstIPv4))
+		{
+			++mCntSkip;
+			if (mCntSkip < dCntSkipMax)
+				return Pending;
+			mCntSkip = 0;
+		}
+
+		events = Reactor::eventsUpdate(mSlotLstIPv4);
+		events |= Reactor::eventsUpdate(mSlotLstIPv6);
+
+		if (!(events & RevRead))
+			return mInterrupted ? Positive : Pending;
+
+		++mWakeups;
+
+		// Drain the accept queues. Batch ends with EAGAIN
 		while (1)
 		{
-			success = connectionsAccept(mFdLstIPv4);
+			success = connectionsAccept(mFdLstIPv4, mSlotLstIPv4);
 			if (success != Positive)
 				break;
 		}
@@ -156,7 +255,7 @@ Success TcpListening::process()
 
 		while (1)
 		{
-			success = connectionsAccept(mFdLstIPv6);
+			success = connectionsAccept(mFdLstIPv6, mSlotLstIPv6);
 			if (success != Positive)
 				break;
 		}
@@ -250,6 +349,29 @@ Success TcpListening::socketCreate(bool isIPv6, SOCKET &fdLst, string &strAddr)
 	if (::setsockopt(fdLst, SOL_SOCKET, SO_REUSEADDR, (const char *)&opt, sizeof(opt)))
 		return procErrLog(-1, "setsockopt(SO_REUSEADDR) failed: %s", errnoToStr(errGet()).c_str());
 
+	if (mReusePort)
+	{
+#ifdef SO_REUSEPORT
+		opt = 1;
+		if (::setsockopt(fdLst, SOL_SOCKET, SO_REUSEPORT, (const char *)&opt, sizeof(opt)))
+			return procErrLog(-1, "setsockopt(SO_REUSEPORT) failed: %s", errnoToStr(errGet()).c_str());
+#else
+		return procErrLog(-1, "SO_REUSEPORT not supported");
+#endif
+	}
+
+	if (mOpts.sizeBufSend > 0 || mOpts.sizeBufRecv > 0)
+	{
+		TcpSocketOptions optsLst;
+		string optsFailed;
+
+		optsLst.sizeBufSend = mOpts.sizeBufSend;
+		optsLst.sizeBufRecv = mOpts.sizeBufRecv;
+
+		if (!TcpTransfering::optionsApply(fdLst, optsLst, optsFailed))
+			procWrnLog("could not set socket options:%s", optsFailed.c_str());
+	}
+
 	ok = fileNonBlockingSet(fdLst);
 	if (!ok)
 		return procErrLog(-1, "could not set non blocking mode: %s",
@@ -274,80 +396,254 @@ Success TcpListening::socketCreate(bool isIPv6, SOCKET &fdLst, string &strAddr)
 		return -1;
 	}
 
-	if (::listen(fdLst, 8192) < 0)
+	if (::listen(fdLst, mBacklog) < 0)
 		return procErrLog(-1, "listen() failed: %s", errnoToStr(errGet()).c_str());
 
+	if (mDeferAcceptSec)
+	{
+#ifdef TCP_DEFER_ACCEPT
+		opt = (int)mDeferAcceptSec;
+		if (::setsockopt(fdLst, IPPROTO_TCP, TCP_DEFER_ACCEPT, (const char *)&opt, sizeof(opt)))
+			procWrnLog("setsockopt(TCP_DEFER_ACCEPT) failed: %s", errnoToStr(errGet()).c_str());
+#else
+		procWrnLog("TCP_DEFER_ACCEPT not supported");
+#endif
+	}
+
+	if (mSteerByCpu && !steeringByCpuSet(fdLst))
+		procWrnLog("could not set CPU steering: %s", errnoToStr(errGet()).c_str());
+
 	return Positive;
 }
 
-Success TcpListening::connectionsAccept(SOCKET &fdLst)
+/*
+ * The program returns the CPU which received the packet. The
+ * kernel uses it as the index into the reuseport group. If the
+ * index is out of range the kernel falls back to hashing
+ *
+Literature
+- https://man7.org/linux/man-pages/man7/socket.7.html
+- https://www.kernel.org/doc/Documentation/networking/filter.txt
+*/
+bool TcpListening::steeringByCpuSet(SOCKET fd)
+{
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+	struct sock_filter code[] =
+	{
+		{ BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+		{ BPF_RET | BPF_A, 0, 0, 0 },
+	};
+	struct sock_fprog prog;
+
+	prog.len = sizeof(code) / sizeof(code[0]);
+	prog.filter = code;
+
+	return !::setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+#else
+	(void)fd;
+	errno = ENOTSUP;
+	return false;
+#endif
+}
+
+/*
+ * Accepted sockets are non-blocking already on Linux.
+ * The peer address is delivered by accept() itself and
+ * converted to a string only if it is logged
+ *
+Literature
+- https://man7.org/linux/man-pages/man2/accept4.2.html
+*/
+Success TcpListening::connectionsAccept(SOCKET &fdLst, ReactorSlot &slot)
 {
 	if (fdLst == INVALID_SOCKET)
 		return Pending;
 
+	if (!(slot.eventsReady & RevRead))
+		return Pending;
+
 	SOCKET peerSocketFd;
 	struct sockaddr_storage addr;
 	socklen_t addrLen;
-	string strAddr;
-	uint16_t numPort;
-	bool isIPv6, ok;
 	int numErr;
-	int res;
 
-	peerSocketFd = ::accept(fdLst, NULL, NULL);
+	addrLen = sizeof(addr);
+#if defined(__linux__)
+	peerSocketFd = ::accept4(fdLst, (struct sockaddr *)&addr, &addrLen,
+							SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+	peerSocketFd = ::accept(fdLst, (struct sockaddr *)&addr, &addrLen);
+#endif
 	if (peerSocketFd == INVALID_SOCKET)
 	{
 		numErr = errGet();
 #ifdef _WIN32
 		if (numErr == WSAEWOULDBLOCK || numErr == WSAEINPROGRESS)
+		{
+			Reactor::eventsClear(slot, RevRead);
 			return Pending;
+		}
 #else
 		if (numErr == EWOULDBLOCK ||
 			numErr == EALREADY ||
 			numErr == EINPROGRESS ||
 			numErr == EAGAIN)
+		{
+			Reactor::eventsClear(slot, RevRead);
 			return Pending;
+		}
 #endif
 		procWrnLog("accept() failed: %s (%d)", errnoToStr(numErr).c_str(), numErr);
 		return Pending;
 	}
 
-	memset(&addr, 0, sizeof(addr));
-	addrLen = sizeof(addr);
+	return connectionAdmit(peerSocketFd, addr);
+}
+
+/*
+ * Multishot accept keeps the accepted sockets in the slot.
+ * They stay there while the output queue is full
+ */
+Success TcpListening::connectionsTake(UringSlot *pSlot)
+{
+	SOCKET peerSocketFd;
+	struct sockaddr_storage addr;
+	socklen_t addrLen;
+	Success success;
 
-	res = ::getpeername(peerSocketFd, (struct sockaddr *)&addr, &addrLen);
-	if (!res)
+	Uring::update(pSlot);
+
+	if (Uring::pending(pSlot))
+		++mWakeups;
+
+	while (!ppPeerFd.isFull() && ppPeerFd.size() < mMaxConn)
 	{
-		ok = TcpTransfering::sockaddrInfoGet(addr, strAddr, numPort, isIPv6);
-		if (!ok)
-			return procErrLog(-1, "could not get socket address info");
+		peerSocketFd = Uring::fdAcceptedGet(pSlot);
+		if (peerSocketFd == INVALID_SOCKET)
+			break;
+
+		memset(&addr, 0, sizeof(addr));
+
+		if (mMaxConnPerSource || levelLogEnabled(4, __PROC_FILENAME__))
+		{
+			addrLen = sizeof(addr);
+			::getpeername(peerSocketFd, (struct sockaddr *)&addr, &addrLen);
+		}
 
-		procDbgLog("got peer %s%s%s:%u",
-				isIPv6 ? "[" : "",
-				strAddr.c_str(),
-				isIPv6 ? "]" : "",
-				numPort);
+		success = connectionAdmit(peerSocketFd, addr);
+		if (success != Positive)
+			return success;
 	}
 
+	return Pending;
+}
+
+Success TcpListening::connectionAdmit(SOCKET peerSocketFd, struct sockaddr_storage &addr)
+{
+	if (levelLogEnabled(4, __PROC_FILENAME__))
+		peerLog(addr);
+
 	if (ppPeerFd.isFull() || ppPeerFd.size() >= mMaxConn)
 	{
 		procWrnLog("dropping connection. Output queue full");
-#ifdef _WIN32
-		::closesocket(peerSocketFd);
-#else
-		::close(peerSocketFd);
-#endif
+		socketClose(peerSocketFd);
+
 		// give internal side of system time
 		// to consume queue -> Pending
 		return Pending;
 	}
 
+	if (!sourceAdmit(addr))
+	{
+		++mConnRejectedSource;
+		socketClose(peerSocketFd);
+
+		// Other sources may be waiting
+		return Positive;
+	}
+
+	string optsFailed;
+
+	if (!TcpTransfering::optionsApply(peerSocketFd, mOpts, optsFailed))
+		procWrnLog("could not set socket options:%s", optsFailed.c_str());
+
 	ppPeerFd.commit(peerSocketFd, nowMs());
 	++mConnCreated;
 
 	return Positive;
 }
 
+bool TcpListening::sourceAdmit(const struct sockaddr_storage &addr)
+{
+	if (!mMaxConnPerSource)
+		return true;
+
+	string source;
+
+	if (addr.ss_family == AF_INET)
+		source.assign((const char *)&((const struct sockaddr_in *)&addr)->sin_addr, 4);
+	else
+	if (addr.ss_family == AF_INET6)
+		source.assign((const char *)&((const struct sockaddr_in6 *)&addr)->sin6_addr, 16);
+
+	sourcesRelease();
+
+	size_t &numConn = mConnPerSource[source];
+
+	if (numConn >= mMaxConnPerSource)
+	{
+		if (!numConn)
+			mConnPerSource.erase(source);
+
+		procDbgLog("dropping connection. Too many from source");
+		return false;
+	}
+
+	++numConn;
+	mSourcesQueued.push_back(source);
+
+	return true;
+}
+
+/*
+ * ppPeerFd is a FIFO. Every entry taken by the consumer
+ * releases the oldest source still in the queue
+ */
+void TcpListening::sourcesRelease()
+{
+	size_t numQueued = ppPeerFd.size();
+	map<string, size_t>::iterator iter;
+
+	while (mSourcesQueued.size() > numQueued)
+	{
+		iter = mConnPerSource.find(mSourcesQueued.front());
+		mSourcesQueued.pop_front();
+
+		if (iter == mConnPerSource.end())
+			continue;
+
+		if (!--iter->second)
+			mConnPerSource.erase(iter);
+	}
+}
+
+void TcpListening::peerLog(struct sockaddr_storage &addr)
+{
+	string strAddr;
+	uint16_t numPort;
+	bool isIPv6, ok;
+
+	ok = TcpTransfering::sockaddrInfoGet(addr, strAddr, numPort, isIPv6);
+	if (!ok)
+		return;
+
+	procDbgLog("got peer %s%s%s:%u",
+			isIPv6 ? "[" : "",
+			strAddr.c_str(),
+			isIPv6 ? "]" : "",
+			numPort);
+}
+
 Success TcpListening::shutdown()
 {
 	PipeEntry<SOCKET> peerFd;
@@ -355,12 +651,27 @@ Success TcpListening::shutdown()
 	while (ppPeerFd.get(peerFd) > 0)
 		socketClose(peerFd.particle);
 
-	socketClose(mFdLstIPv4);
-	socketClose(mFdLstIPv6);
+	Reactor::slotRemove(mSlotLstIPv4);
+	Reactor::slotRemove(mSlotLstIPv6);
+
+	// Sockets owned by the ring are closed there
+	if (Uring::slotRemove(mpUringLstIPv4))
+		mFdLstIPv4 = INVALID_SOCKET;
+	if (Uring::slotRemove(mpUringLstIPv6))
+		mFdLstIPv6 = INVALID_SOCKET;
+
+	socketClose(mFdLstIPv4, mSlotLstIPv4);
+	socketClose(mFdLstIPv6, mSlotLstIPv6);
 
 	return Positive;
 }
 
+void TcpListening::socketClose(SOCKET &fd, ReactorSlot &slot)
+{
+	Reactor::slotRemove(slot);
+	socketClose(fd);
+}
+
 void TcpListening::socketClose(SOCKET &fd)
 {
 	if (fd == INVALID_SOCKET)
@@ -458,7 +769,17 @@ void TcpListening::processInfo(char *pBuf, char *pBufEnd)
 
 	dInfo("\n");
 
+	if (mReusePort)
+		dInfo("Shard\t\t\tSO_REUSEPORT%s\n", mSteerByCpu ? ", CPU steering" : "");
+
+	dInfo("Reactor\t\t\t%s\n", mpUringLstIPv4 ? "io_uring" :
+				Reactor::slotActive(mSlotLstIPv4) ? "epoll" : "none");
+	dInfo("Accept wakeups\t\t%d\n", (int)mWakeups);
 	dInfo("Connections created\t%d\n", (int)mConnCreated);
+
+	if (mMaxConnPerSource)
+		dInfo("Rejected by source\t%d\n", (int)mConnRejectedSource);
+
 	dInfo("Queue\t\t\t%zu\n", ppPeerFd.size());
 }
 
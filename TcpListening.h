@@ -33,6 +33,8 @@
 
 #include <string>
 #include <list>
+#include <map>
+#include <deque>
 
 #ifdef _WIN32
 // https://learn.microsoft.com/en-us/cpp/porting/modifying-winver-and-win32-winnt?view=msvc-170
@@ -57,6 +59,9 @@
 
 #include "Processing.h"
 #include "Pipe.h"
+#include "Reactor.h"
+#include "Uring.h"
+#include "TcpTransfering.h"
 
 /* Literature
  * - https://handsonnetworkprogramming.com/articles/differences-windows-winsock-linux-unix-bsd-sockets-compatibility/
@@ -81,6 +86,32 @@ public:
 
 	void portSet(uint16_t port, bool localOnly = false);
 	void maxConnSet(size_t maxConn);
+	void backlogSet(int backlog);
+	void deferAcceptSet(uint32_t timeoutSec);
+	void maxConnPerSourceSet(size_t maxConn);
+
+	/*
+	 * Sharding
+	 * - Several listeners with SO_REUSEPORT may bind the same port.
+	 *   The kernel balances new connections between them
+	 * - Usually each shard is started with its own driver and
+	 *   consumes its own ppPeerFd
+	 * - With CPU steering the connection is given to the shard
+	 *   with the index of the CPU which received it. Only useful
+	 *   if one shard per CPU is created and shards are started
+	 *   in the order of the CPUs. Linux only
+	 */
+	void reusePortSet(bool steerByCpu = false);
+
+	/*
+	 * Tuning profile for accepted sockets. Buffer sizes
+	 * are set on the listening sockets as well because
+	 * the window scale is announced in the handshake
+	 * - Quick ACK mode is only kept by the TcpTransfering
+	 *   profile. See options()
+	 */
+	void optionsSet(const TcpSocketOptions &opts);
+	const TcpSocketOptions &options() const;
 
 	SOCKET nextPeerFd();
 	Pipe<SOCKET> ppPeerFd;
@@ -97,13 +128,27 @@ private:
 		, mPort(0)
 		, mLocalOnly(false)
 		, mMaxConn(0)
+		, mReusePort(false)
+		, mSteerByCpu(false)
+		, mBacklog(0)
+		, mDeferAcceptSec(0)
+		, mMaxConnPerSource(0)
+		, mConnPerSource()
+		, mSourcesQueued()
 		, mInterrupted(false)
 		, mCntSkip(0)
+		, mOpts()
 		, mFdLstIPv4(INVALID_SOCKET)
 		, mFdLstIPv6(INVALID_SOCKET)
+		, mSlotLstIPv4()
+		, mSlotLstIPv6()
+		, mpUringLstIPv4(NULL)
+		, mpUringLstIPv6(NULL)
 		, mAddrIPv4("")
 		, mAddrIPv6("")
 		, mConnCreated(0)
+		, mWakeups(0)
+		, mConnRejectedSource(0)
 	{
 		mState = 0;
 	}
@@ -112,13 +157,27 @@ private:
 		mPort = 0;
 		mLocalOnly = false;
 		mMaxConn = 0;
+		mReusePort = false;
+		mSteerByCpu = false;
+		mBacklog = 0;
+		mDeferAcceptSec = 0;
+		mMaxConnPerSource = 0;
+		mConnPerSource.clear();
+		mSourcesQueued.clear();
 		mInterrupted = false;
 		mCntSkip = 0;
+		mOpts = TcpSocketOptions();
 		mFdLstIPv4 = INVALID_SOCKET;
 		mFdLstIPv6 = INVALID_SOCKET;
 		mAddrIPv4 = "";
+		mSlotLstIPv4 = ReactorSlot();
+		mSlotLstIPv6 = ReactorSlot();
+		mpUringLstIPv4 = NULL;
+		mpUringLstIPv6 = NULL;
 		mAddrIPv6 = "";
 		mConnCreated = 0;
+		mWakeups = 0;
+		mConnRejectedSource = 0;
 
 		mState = 0;
 
@@ -129,8 +188,15 @@ private:
 	Success shutdown();
 
 	Success socketCreate(bool isIPv6, SOCKET &fdLst, std::string &strAddr);
-	Success connectionsAccept(SOCKET &fdLst);
+	Success connectionsAccept(SOCKET &fdLst, ReactorSlot &slot);
+	Success connectionsTake(UringSlot *pSlot);
+	Success connectionAdmit(SOCKET peerSocketFd, struct sockaddr_storage &addr);
+	void socketClose(SOCKET &fd, ReactorSlot &slot);
 	void socketClose(SOCKET &fd);
+	bool steeringByCpuSet(SOCKET fd);
+	bool sourceAdmit(const struct sockaddr_storage &addr);
+	void sourcesRelease();
+	void peerLog(struct sockaddr_storage &addr);
 
 	int errGet();
 	std::string errnoToStr(int num);
@@ -140,17 +206,31 @@ private:
 	uint16_t mPort;
 	bool mLocalOnly;
 	size_t mMaxConn;
+	bool mReusePort;
+	bool mSteerByCpu;
+	int mBacklog;
+	uint32_t mDeferAcceptSec;
+	size_t mMaxConnPerSource;
+	std::map<std::string, size_t> mConnPerSource;
+	std::deque<std::string> mSourcesQueued;
 	bool mInterrupted;
 	uint32_t mCntSkip;
+	TcpSocketOptions mOpts;
 
 	SOCKET mFdLstIPv4;
 	SOCKET mFdLstIPv6;
+	ReactorSlot mSlotLstIPv4;
+	ReactorSlot mSlotLstIPv6;
+	UringSlot *mpUringLstIPv4;
+	UringSlot *mpUringLstIPv6;
 	std::string mAddress;
 	std::string mAddrIPv4;
 	std::string mAddrIPv6;
 
 	// statistics
 	uint32_t mConnCreated;
+	uint32_t mWakeups;
+	uint32_t mConnRejectedSource;
 };
 
 #endif
@@ -32,19 +32,30 @@
 #include <chrono>
 #ifndef _WIN32
 #include <unistd.h>
+#include <netinet/tcp.h>
 #include <sys/poll.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#endif
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
 #endif
 
 #include "TcpTransfering.h"
+#include "HostResolving.h"
 
 #define dForEach_ProcState(gen) \
 		gen(StSrvStart) \
 		gen(StSrvArgCheck) \
 		gen(StCltStart) \
 		gen(StCltArgCheck) \
+		gen(StCltResolveWait) \
+		gen(StCltConnStart) \
 		gen(StCltConnDoneWait) \
 		gen(StCltConnDone) \
 		gen(StConnMain) \
+		gen(StSendFlush) \
 		gen(StTmp) \
 
 #define dGenProcStateEnum(s) s,
@@ -69,7 +80,11 @@ mutex TcpTransfering::mtxGlobalInit;
 bool TcpTransfering::globalInitDone = false;
 #endif
 
-#define dTmoDefaultConnDoneMs			2000
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define dHaveZeroCopy				1
+#else
+#define dHaveZeroCopy				0
+#endif
 
 /*
  * Literature
@@ -82,25 +97,57 @@ TcpTransfering::TcpTransfering(SOCKET fd)
 	, mSocketFdMtx()
 #endif
 	, mSocketFd(fd)
+	, mSlot()
+	, mpUring(NULL)
 	, mHostAddrStr("")
 	, mHostPort(0)
 	, mpHostAddr(NULL)
+	, mpResolv(NULL)
+	, mAddrsHost()
+	, mIdxAddrHost(0)
+	, mAttempts()
+	, mTmoConnMs(CONFIG_TCP_TIMEOUT_CONNECT_MS)
+	, mDelayConnAttemptMs(CONFIG_TCP_DELAY_CONN_ATTEMPT_MS)
+	, mAttemptLastMs(0)
+	, mOpts()
 	, mErrno(0)
 	, mInfoSet(false)
 	, mIsIPv6Local(false)
 	, mIsIPv6Remote(false)
-	, mBytesReceived(0)
-	, mBytesSent(0)
+	, mBufRecv()
+	, mSizeBufRecv(CONFIG_TCP_SIZE_BUFFER_RECV_MIN)
+	, mIdxRecvStart(0)
+	, mIdxRecvEnd(0)
+	, mQueueSend()
+	, mIdxSendFront(0)
+	, mSizeQueueSend(0)
+	, mCorked(false)
+	, mZeroCopyPending()
+	, mZeroCopyState(0)
+	, mIdZeroCopyNext(0)
+	, mIdZeroCopyDone(0)
+	, mStats()
+	, mStatsLastMs(0)
+	, mBytesReceivedLast(0)
+	, mBytesSentLast(0)
+	, mZeroCopySent(0)
+	, mZeroCopyCopied(0)
+	, mConnStartMs(0)
+	, mConnDurationMs(0)
+	, mConnAttempts(0)
+	, mBucketSend()
+	, mBucketRecv()
+	, mpGroupSend(NULL)
+	, mpGroupRecv(NULL)
 {
 	mState = StSrvStart;
 	mSendReady = true;
-	addrInfoSet();
 }
 
 // strAddrHost can be
 // - IPv4
 // - IPv6
-// - Domain (TODO)
+// - Domain. Resolved by HostResolving
 TcpTransfering::TcpTransfering(const string &hostAddr, uint16_t hostPort)
 	: Transfering("TcpTransfering")
 	, mStartMs(0)
@@ -108,18 +155,53 @@ TcpTransfering::TcpTransfering(const string &hostAddr, uint16_t hostPort)
 	, mSocketFdMtx()
 #endif
 	, mSocketFd(INVALID_SOCKET)
+	, mSlot()
+	, mpUring(NULL)
 	, mHostAddrStr(hostAddr)
 	, mHostPort(hostPort)
 	, mpHostAddr(NULL)
+	, mpResolv(NULL)
+	, mAddrsHost()
+	, mIdxAddrHost(0)
+	, mAttempts()
+	, mTmoConnMs(CONFIG_TCP_TIMEOUT_CONNECT_MS)
+	, mDelayConnAttemptMs(CONFIG_TCP_DELAY_CONN_ATTEMPT_MS)
+	, mAttemptLastMs(0)
+	, mOpts()
 	, mErrno(0)
 	, mInfoSet(false)
 	, mIsIPv6Local(false)
 	, mIsIPv6Remote(false)
-	, mBytesReceived(0)
-	, mBytesSent(0)
+	, mBufRecv()
+	, mSizeBufRecv(CONFIG_TCP_SIZE_BUFFER_RECV_MIN)
+	, mIdxRecvStart(0)
+	, mIdxRecvEnd(0)
+	, mQueueSend()
+	, mIdxSendFront(0)
+	, mSizeQueueSend(0)
+	, mCorked(false)
+	, mZeroCopyPending()
+	, mZeroCopyState(0)
+	, mIdZeroCopyNext(0)
+	, mIdZeroCopyDone(0)
+	, mStats()
+	, mStatsLastMs(0)
+	, mBytesReceivedLast(0)
+	, mBytesSentLast(0)
+	, mZeroCopySent(0)
+	, mZeroCopyCopied(0)
+	, mConnStartMs(0)
+	, mConnDurationMs(0)
+	, mConnAttempts(0)
+	, mBucketSend()
+	, mBucketRecv()
+	, mpGroupSend(NULL)
+	, mpGroupRecv(NULL)
 {
 	mState = StCltStart;
 	mSendReady = false;
+
+	mOpts.keepAlive = 1;
 }
 
 /*
@@ -135,8 +217,8 @@ Success TcpTransfering::process()
 	uint32_t curTimeMs = millis();
 	uint32_t diffMs = curTimeMs - mStartMs;
 	Success success;
-	int res, numErr = 0;
 	ssize_t connCheck;
+	uint32_t events;
 #ifdef _WIN32
 	bool ok;
 #endif
@@ -159,6 +241,8 @@ Success TcpTransfering::process()
 		if (success != Positive)
 			return procErrLog(-1, "could not set socket options");
 
+		reactorRegister();
+
 		mState = StConnMain;
 
 		break;
@@ -174,72 +258,86 @@ Success TcpTransfering::process()
 		break;
 	case StCltArgCheck:
 
-		// create local address structure
+		mConnStartMs = curTimeMs;
 
 		if (mHostAddrStr == "localhost")
 			mHostAddrStr = "127.0.0.1";
 
 		mpHostAddr = addrStringToSock(mHostAddrStr, mHostPort);
-		if (!mpHostAddr)
-			return procErrLog(-1, "could not parse IP address. Given: '%s'",
-					mHostAddrStr.c_str());
+		if (mpHostAddr)
+		{
+			free(mpHostAddr);
+			mpHostAddr = NULL;
 
-		// create and configure socket
+			mAddrsHost.push_back(mHostAddrStr);
+			mState = StCltConnStart;
+			break;
+		}
 
-		mSocketFd = socket(mpHostAddr->ss_family, SOCK_STREAM, 0);
-		if (mSocketFd == INVALID_SOCKET)
-			return procErrLog(-1, "could not create socket: %s",
-							errnoToStr(errGet()).c_str());
+		// Repeated connects skip the resolver
+		if (HostResolving::cacheGet(mHostAddrStr, mAddrsHost))
+		{
+			mState = StCltConnStart;
+			break;
+		}
 
-		success = socketOptionsSet();
-		if (success != Positive)
-			return procErrLog(-1, "could not set socket options");
+		mpResolv = HostResolving::create(mHostAddrStr);
+		if (!mpResolv)
+			return procErrLog(-1, "could not create process");
 
-		res = connect(mSocketFd, (struct sockaddr *)mpHostAddr, sizeof(*mpHostAddr));
+		start(mpResolv);
 
-		free(mpHostAddr);
-		mpHostAddr = NULL;
+		mState = StCltResolveWait;
 
-		if (!res)
-		{
-			mState = StCltConnDone;
-			break;
-		}
+		break;
+	case StCltResolveWait:
 
-		numErr = errGet();
-#ifdef _WIN32
-		if (numErr == WSAEINPROGRESS)
-#else
-		if (numErr == EINPROGRESS)
-#endif
-		{
-			mStartMs = curTimeMs;
-			mState = StCltConnDoneWait;
+		success = mpResolv->success();
+		if (success == Pending)
 			break;
-		}
 
-		return procErrLog(-1, "could not connect to host: %s (%d)",
-						errnoToStr(numErr).c_str(), numErr);
+		if (success != Positive)
+			return procErrLog(-1, "could not resolve host '%s'",
+					mHostAddrStr.c_str());
+
+		mAddrsHost = mpResolv->addrs();
+
+		repel(mpResolv);
+		mpResolv = NULL;
+
+		mState = StCltConnStart;
 
 		break;
-	case StCltConnDoneWait:
+	case StCltConnStart:
+
+		addrsInterleave();
+
+		mState = StCltConnDoneWait;
 
-		if (diffMs > dTmoDefaultConnDoneMs)
-			return procErrLog(-1, "timeout connecting to host");
+		break;
+	case StCltConnDoneWait:
 
-		success = connClientDone();
+		success = connAttemptsCheck(curTimeMs);
 		if (success == Pending)
 			break;
 
 		if (success != Positive)
-			return procErrLog(-1, "client connect failed");
+			return procErrLog(-1, "could not connect to host '%s': %s",
+					mHostAddrStr.c_str(), errnoToStr(mErrno).c_str());
+
+		mConnDurationMs = curTimeMs - mConnStartMs;
+
+		// Tuning has been done before connect()
+		success = socketOptionsSet(false);
+		if (success != Positive)
+			return procErrLog(-1, "could not set socket options");
 
 		mState = StCltConnDone;
 
 		break;
 	case StCltConnDone:
 
-		addrInfoSet();
+		reactorRegister();
 		mSendReady = true;
 
 		mState = StConnMain;
@@ -248,7 +346,48 @@ Success TcpTransfering::process()
 	case StConnMain:
 
 		if (mDone)
-			return Positive;
+		{
+			mStartMs = curTimeMs;
+			mState = StSendFlush;
+			break;
+		}
+
+		if (mIdZeroCopyDone != mIdZeroCopyNext)
+			zeroCopyCompletionsRead();
+
+		if (curTimeMs - mStatsLastMs >= CONFIG_TCP_INTERVAL_STATS_MS)
+			statsUpdate(curTimeMs);
+
+		// Idle connections cost no syscall
+		if (mpUring)
+		{
+			// Paced data waits in the queue for tokens
+			if (mSizeQueueSend && !mCorked)
+			{
+#if CONFIG_PROC_HAVE_DRIVERS
+				Guard lock(mSocketFdMtx);
+#endif
+				sendFlush();
+			}
+
+			if (!uringPending())
+				break;
+		}
+		else
+		{
+			events = Reactor::eventsUpdate(mSlot);
+
+			if (events & RevWrite)
+			{
+#if CONFIG_PROC_HAVE_DRIVERS
+				Guard lock(mSocketFdMtx);
+#endif
+				sendFlush();
+			}
+
+			if (!(events & (RevRead | RevHangUp | RevError)))
+				break;
+		}
 
 		connCheck = read(NULL, 0);
 		if (connCheck >= 0)
@@ -260,6 +399,45 @@ Success TcpTransfering::process()
 
 		return Positive;
 
+		break;
+	case StSendFlush:
+
+		// Queued data is sent before the socket is closed
+		if (mpUring)
+		{
+			{
+#if CONFIG_PROC_HAVE_DRIVERS
+				Guard lock(mSocketFdMtx);
+#endif
+				mCorked = false;
+				sendFlush();
+			}
+
+			uringPending();
+		}
+		else
+		if (Reactor::eventsUpdate(mSlot) & RevWrite)
+		{
+#if CONFIG_PROC_HAVE_DRIVERS
+			Guard lock(mSocketFdMtx);
+#endif
+			mCorked = false;
+			sendFlush();
+		}
+
+		if (mIdZeroCopyDone != mIdZeroCopyNext)
+			zeroCopyCompletionsRead();
+
+		if (mSocketFd == INVALID_SOCKET)
+			return Positive;
+
+		// Kernel must be done with zero-copy buffers as well
+		if (!sendQueueBytes() && mIdZeroCopyDone == mIdZeroCopyNext)
+			return Positive;
+
+		if (diffMs > CONFIG_TCP_TIMEOUT_SEND_FLUSH_MS)
+			return procErrLog(-1, "could not send queued data");
+
 		break;
 	case StTmp:
 
@@ -281,6 +459,9 @@ Success TcpTransfering::shutdown()
 		mpHostAddr = NULL;
 	}
 
+	for (size_t i = 0; i < CONFIG_TCP_NUM_CONN_ATTEMPTS_MAX; ++i)
+		connAttemptClose(mAttempts[i]);
+
 #if CONFIG_PROC_HAVE_DRIVERS
 	Guard lock(mSocketFdMtx);
 #endif
@@ -317,30 +498,292 @@ ssize_t TcpTransfering::read(void *pBuf, size_t lenReq)
 	if (!mReadReady)
 		return 0;
 
+	size_t lenAvail = mIdxRecvEnd - mIdxRecvStart;
+	ssize_t numBytes;
+
+	// Connection check. Data is kept for the next read
+	if (!pBuf || !lenReq)
+	{
+		if (lenAvail)
+			return lenAvail;
+
+		return bufferFill();
+	}
+
+	// Large requests bypass the buffer
+	if (!lenAvail && lenReq >= mSizeBufRecv && !mpUring)
+	{
+		if (mSocketFd == INVALID_SOCKET)
+			return -1;
+
+		uint32_t eventsSeen = mSlot.eventsReady;
+
+		if (!(eventsSeen & (RevRead | RevHangUp | RevError)))
+			return 0;
+
+		lenReq = tokensTake(false, lenReq);
+		if (!lenReq)
+			return 0;
+#ifdef _WIN32
+		numBytes = ::recv(mSocketFd, (char *)pBuf, (int)lenReq, 0);
+#else
+		numBytes = ::recv(mSocketFd, (char *)pBuf, lenReq, 0);
+#endif
+		numBytes = recvCheck(numBytes, eventsSeen);
+		tokensReturn(false, lenReq - (numBytes > 0 ? numBytes : 0));
+
+		return numBytes;
+	}
+
+	if (!lenAvail)
+	{
+		numBytes = bufferFill();
+		if (numBytes <= 0)
+			return numBytes;
+
+		lenAvail = numBytes;
+	}
+
+	if (lenReq > lenAvail)
+		lenReq = lenAvail;
+
+	memcpy(pBuf, &mBufRecv[mIdxRecvStart], lenReq);
+	mIdxRecvStart += lenReq;
+
+	return lenReq;
+}
+
+ssize_t TcpTransfering::readFlush()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	ssize_t bytesRead, bytesSum;
+
+	bytesSum = mIdxRecvEnd - mIdxRecvStart;
+
+	while (1)
+	{
+		mIdxRecvStart = 0;
+		mIdxRecvEnd = 0;
+
+		bytesRead = bufferFill();
+		if (bytesRead <= 0)
+			break;
+
+		bytesSum += bytesRead;
+	}
+
+	mIdxRecvStart = 0;
+	mIdxRecvEnd = 0;
+
+	return bytesSum;
+}
+
+ssize_t TcpTransfering::peek(const uint8_t *&pData, size_t lenMin)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	ssize_t numBytes;
+
+	pData = NULL;
+
+	if (!mReadReady)
+		return 0;
+
+	// Requested data must fit into the buffer
+	if (lenMin > mSizeBufRecv)
+		mSizeBufRecv = lenMin;
+
+	while (mIdxRecvEnd - mIdxRecvStart < lenMin)
+	{
+		numBytes = bufferFill();
+		if (!numBytes)
+			break;
+
+		if (numBytes < 0)
+			return numBytes;
+	}
+
+	if (mIdxRecvStart == mIdxRecvEnd)
+		return 0;
+
+	pData = &mBufRecv[mIdxRecvStart];
+
+	return mIdxRecvEnd - mIdxRecvStart;
+}
+
+bool TcpTransfering::peekSupported() const
+{
+	return true;
+}
+
+void TcpTransfering::consume(size_t len)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	size_t lenAvail = mIdxRecvEnd - mIdxRecvStart;
+
+	if (len > lenAvail)
+		len = lenAvail;
+
+	mIdxRecvStart += len;
+}
+
+/*
+ * Received data not read yet. Unlike peek() the
+ * socket is not touched and no tokens are taken
+ */
+size_t TcpTransfering::recvQueueBytes()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	return mIdxRecvEnd - mIdxRecvStart + Uring::recvQueueBytes(mpUring);
+}
+
+Success TcpTransfering::exactRead(void *pBuf, size_t lenReq)
+{
+	if (!lenReq)
+		return Positive;
+
+	if (!pBuf)
+		return procErrLog(-1, "buffer not set");
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	if (!mReadReady)
+		return Pending;
+
+	// Message must fit into the buffer
+	if (lenReq > mSizeBufRecv)
+		mSizeBufRecv = lenReq;
+
+	ssize_t numBytes;
+
+	while (mIdxRecvEnd - mIdxRecvStart < lenReq)
+	{
+		numBytes = bufferFill();
+		if (!numBytes)
+			return Pending;
+
+		if (numBytes < 0)
+			return -2;
+	}
+
+	memcpy(pBuf, &mBufRecv[mIdxRecvStart], lenReq);
+	mIdxRecvStart += lenReq;
+
+	return Positive;
+}
+
+/*
+ * One recv() per call. Lock must be held by the caller
+ */
+ssize_t TcpTransfering::bufferFill()
+{
 	if (mSocketFd == INVALID_SOCKET)
 		return -1;
 
-	ssize_t numBytes = 0;
-	bool peek = false;
-	char buf[1];
+	size_t lenAvail = mIdxRecvEnd - mIdxRecvStart;
 
-	if (!pBuf || !lenReq)
+	if (!lenAvail)
+	{
+		mIdxRecvStart = 0;
+		mIdxRecvEnd = 0;
+	}
+
+	if (mBufRecv.size() < mSizeBufRecv)
+		mBufRecv.resize(mSizeBufRecv);
+
+	// Compact if less than half of the buffer is free at the end
+	if (mIdxRecvStart && mBufRecv.size() - mIdxRecvEnd < mBufRecv.size() / 2)
+	{
+		memmove(&mBufRecv[0], &mBufRecv[mIdxRecvStart], lenAvail);
+
+		mIdxRecvStart = 0;
+		mIdxRecvEnd = lenAvail;
+	}
+
+	size_t lenFree = mBufRecv.size() - mIdxRecvEnd;
+	ssize_t numBytes;
+
+	if (!lenFree)
+		return 0;
+
+	// Data has been received by the ring already
+	if (mpUring)
 	{
-		pBuf = buf;
-		lenReq = sizeof(buf);
-		peek = true;
+		lenFree = tokensTake(false, lenFree);
+		if (!lenFree)
+			return 0;
+
+		numBytes = Uring::dataGet(mpUring, &mBufRecv[mIdxRecvEnd], lenFree);
+		tokensReturn(false, lenFree - numBytes);
+
+		if (!numBytes && mpUring->err)
+		{
+			errno = mpUring->err;
+			numBytes = -1;
+		}
+		else
+		if (!numBytes && !mpUring->eof)
+			return 0;
+
+		numBytes = recvCheck(numBytes, mSlot.eventsReady);
+		if (numBytes > 0)
+			mIdxRecvEnd += numBytes;
+
+		return numBytes;
 	}
+
+	uint32_t eventsSeen = mSlot.eventsReady;
+
+	if (!(eventsSeen & (RevRead | RevHangUp | RevError)))
+		return 0;
+
+	// Without tokens the data stays in the kernel. Peer is throttled by TCP
+	lenFree = tokensTake(false, lenFree);
+	if (!lenFree)
+		return 0;
 #ifdef _WIN32
-	numBytes = ::recv(mSocketFd, (char *)pBuf, (int)lenReq, MSG_PEEK);
+	numBytes = ::recv(mSocketFd, (char *)&mBufRecv[mIdxRecvEnd], (int)lenFree, 0);
 #else
-	numBytes = ::recv(mSocketFd, (char *)pBuf, lenReq, MSG_PEEK);
+	numBytes = ::recv(mSocketFd, (char *)&mBufRecv[mIdxRecvEnd], lenFree, 0);
 #endif
+	numBytes = recvCheck(numBytes, eventsSeen);
+	if (numBytes > 0)
+		mIdxRecvEnd += numBytes;
+
+	tokensReturn(false, lenFree - (numBytes > 0 ? numBytes : 0));
+
+	// A short read drained the socket. Next data raises a new event
+	if (numBytes > 0 && (size_t)numBytes < lenFree)
+		Reactor::eventsClear(mSlot, RevRead, eventsSeen);
+
+	return numBytes;
+}
+
+/*
+ * Events must be read before the socket call. Data
+ * arriving meanwhile keeps them set
+ */
+ssize_t TcpTransfering::recvCheck(ssize_t numBytes, uint32_t eventsSeen)
+{
+	++mStats.callsRecv;
+
 	if (numBytes < 0)
 	{
 		int numErr = errGet();
 #ifdef _WIN32
 		if (numErr == WSAEWOULDBLOCK || numErr == WSAEINPROGRESS)
+		{
+			++mStats.wouldBlockRecv;
+			Reactor::eventsClear(mSlot, RevRead, eventsSeen);
 			return 0; // std case and ok
+		}
 
 		if (numErr == WSAECONNRESET)
 		{
@@ -350,7 +793,11 @@ ssize_t TcpTransfering::read(void *pBuf, size_t lenReq)
 		}
 #else
 		if (numErr == EWOULDBLOCK || numErr == EINPROGRESS || numErr == EAGAIN)
+		{
+			++mStats.wouldBlockRecv;
+			Reactor::eventsClear(mSlot, RevRead, eventsSeen);
 			return 0; // std case and ok
+		}
 
 		if (numErr == ECONNRESET)
 		{
@@ -372,34 +819,27 @@ ssize_t TcpTransfering::read(void *pBuf, size_t lenReq)
 		return -4;
 	}
 
-	if (peek)
-		return numBytes;
-#ifdef _WIN32
-	numBytes = ::recv(mSocketFd, (char *)pBuf, (int)numBytes, 0);
-#else
-	numBytes = ::recv(mSocketFd, (char *)pBuf, numBytes, 0);
-#endif
 	//procDbgLog("received data. len: %d", numBytes);
 
-	mBytesReceived += numBytes;
+	mStats.bytesReceived += numBytes;
+#ifdef TCP_QUICKACK
+	if (mOpts.quickAck > 0)
+		intOptionSet(mSocketFd, IPPROTO_TCP, TCP_QUICKACK, 1);
+#endif
 
 	return numBytes;
 }
 
-ssize_t TcpTransfering::readFlush()
-{
-	ssize_t bytesRead = 1, bytesSum = 0;
-	char buf[32];
-
-	while (bytesRead)
-	{
-		bytesRead = read(buf, sizeof(buf));
-		bytesSum += bytesRead;
-	}
-
-	return bytesSum;
-}
-
+/*
+ * Data is accepted entirely or not at all. What can't
+ * be sent at once is queued and sent in order when the
+ * socket is writable again
+ *
+ * Return value
+ *   > 0 number of bytes sent or queued
+ *   = 0 queue full. Nothing accepted
+ *   < 0 connection down
+ */
 ssize_t TcpTransfering::send(const void *pData, size_t lenReq)
 {
 	if (!mSendReady)
@@ -414,11 +854,29 @@ ssize_t TcpTransfering::send(const void *pData, size_t lenReq)
 	if (mSocketFd == INVALID_SOCKET)
 		return -1;
 
+	if (!pData || !lenReq)
+		return 0;
+
+	if (!sendQueueFits(lenReq))
+		return 0;
+
+	const uint8_t *pStart = (const uint8_t *)pData;
 	ssize_t res;
-	size_t lenBkup = lenReq;
-	size_t bytesSent = 0;
+	size_t lenDone = 0;
+	bool paced = sendPaced();
+
+	// Errors are reported by the process
+	if (mpUring && !mCorked && !mSizeQueueSend && !paced)
+	{
+		res = Uring::send(mpUring, pData, lenReq);
+		if (res > 0)
+			mStats.bytesSent += res;
+
+		return res;
+	}
 
-	while (lenReq)
+	// Nothing queued. Send directly
+	if (!mpUring && !mCorked && !mSizeQueueSend && !paced)
 	{
 		/* IMPORTANT:
 		  * Connection may be reset by remote peer already.
@@ -426,89 +884,911 @@ ssize_t TcpTransfering::send(const void *pData, size_t lenReq)
 		  * emit signal SIGPIPE and therefore kill the entire
 		  * application in this case.
 		  */
+		uint32_t eventsSeen = mSlot.eventsReady;
 #ifdef _WIN32
 		res = ::send(mSocketFd, (const char *)pData, (int)lenReq, MSG_NOSIGNAL);
 #else
 		res = ::send(mSocketFd, (const char *)pData, lenReq, MSG_NOSIGNAL);
 #endif
+		res = sendCheck(res, eventsSeen);
 		if (res < 0)
+			return res;
+
+		lenDone = res;
+		mStats.bytesSent += res;
+	}
+
+	queueAppend(pStart + lenDone, lenReq - lenDone);
+
+	// Full chunks of a corked message go out with MSG_MORE
+	if (mCorked && mSizeQueueSend >= CONFIG_TCP_SIZE_CHUNK_SEND)
+		sendFlush();
+
+	// Paced data is sent as far as the tokens allow
+	if (paced && !mCorked)
+		sendFlush();
+
+	return lenReq;
+}
+
+/*
+ * While corked data is only queued. Uncorking sends
+ * the whole message with as few segments as possible
+ */
+void TcpTransfering::corkSet(bool corked)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	mCorked = corked;
+
+	if (!corked)
+		sendFlush();
+}
+
+size_t TcpTransfering::sendQueueBytes()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	return mSizeQueueSend + Uring::sendQueueBytes(mpUring);
+}
+
+/*
+ * The buffer is taken over and buf is empty afterwards.
+ * Large buffers are sent with MSG_ZEROCOPY. They are kept
+ * until the kernel reports the completion
+ *
+Literature
+- https://docs.kernel.org/networking/msg_zerocopy.html
+*/
+ssize_t TcpTransfering::sendZeroCopy(VecByte &buf)
+{
+	if (!mSendReady)
+		return procErrLog(-1, "unable to send data. Not ready");
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	if (mSocketFd == INVALID_SOCKET)
+		return -1;
+
+	size_t len = buf.size();
+
+	if (!len)
+		return 0;
+
+	if (!sendQueueFits(len))
+		return 0;
+
+	mQueueSend.push_back(TcpSendChunk());
+	TcpSendChunk &chunk = mQueueSend.back();
+
+	chunk.data.swap(buf);
+
+	if (len >= CONFIG_TCP_SIZE_ZEROCOPY_MIN && !mpUring && zeroCopyEnable())
+		chunk.type = ChunkZeroCopy;
+
+	mSizeQueueSend += len;
+
+	if (!mCorked)
+		sendFlush();
+
+	return len;
+}
+
+/*
+ * Sends a region of a file without copying it to user
+ * space. The descriptor is duplicated and may be closed
+ * by the caller right away
+ * - The region must lie within the file
+ * - Where the kernel can't send files, the region is
+ *   read piece by piece while the queue drains
+ *
+Literature
+- https://man7.org/linux/man-pages/man2/sendfile.2.html
+- https://man7.org/linux/man-pages/man2/fstat.2.html
+*/
+ssize_t TcpTransfering::fileSend(int fdFile, int64_t offset, size_t len)
+{
+	if (!mSendReady)
+		return procErrLog(-1, "unable to send data. Not ready");
+#ifdef _WIN32
+	(void)fdFile;
+	(void)offset;
+	(void)len;
+	return procErrLog(-1, "sending files not supported");
+#else
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	if (mSocketFd == INVALID_SOCKET)
+		return -1;
+
+	if (fdFile < 0 || offset < 0)
+		return procErrLog(-1, "invalid file region");
+
+	if (!len)
+		return 0;
+
+	struct stat st;
+
+	if (::fstat(fdFile, &st))
+		return procErrLog(-1, "could not get file status");
+
+	if (S_ISREG(st.st_mode) &&
+			(offset > st.st_size || len > (uint64_t)(st.st_size - offset)))
+		return procErrLog(-1, "file region exceeds file");
+
+	// File data doesn't occupy memory. Only a full queue blocks
+	if (!sendQueueFits(0))
+		return 0;
+
+	mQueueSend.push_back(TcpSendChunk());
+	TcpSendChunk &chunk = mQueueSend.back();
+
+	chunk.type = ChunkFile;
+	chunk.fdFile = ::fcntl(fdFile, F_DUPFD_CLOEXEC, 0);
+	chunk.offFile = offset;
+	chunk.lenFile = len;
+
+	if (chunk.fdFile < 0)
+	{
+		mQueueSend.pop_back();
+		return procErrLog(-1, "could not duplicate file descriptor");
+	}
+
+	mSizeQueueSend += len;
+
+	if (!mCorked)
+		sendFlush();
+
+	return len;
+#endif
+}
+
+/*
+ * Sends queued chunks. Data chunks are combined
+ * to one sendmsg() per batch. Lock must be held
+ * by the caller
+ *
+Literature
+- https://man7.org/linux/man-pages/man2/sendmsg.2.html
+- https://man7.org/linux/man-pages/man7/tcp.7.html
+  - MSG_MORE, TCP_CORK
+*/
+ssize_t TcpTransfering::sendFlush()
+{
+	if (mSocketFd == INVALID_SOCKET)
+		return -1;
+
+	ssize_t res, bytesSum = 0;
+	size_t lenBatch, lenMax;
+	uint32_t eventsSeen;
+
+	// Ring takes over the queue. It sends copies only
+	while (mpUring && mQueueSend.size())
+	{
+		// File data is read as the ring drains
+		if (mQueueSend.front().type == ChunkFile &&
+				Uring::sendQueueBytes(mpUring) >= CONFIG_TCP_SIZE_QUEUE_SEND_MAX)
+			break;
+
+		if (!chunkFileRead())
+		{
+			disconnect(EIO);
+			return procErrLog(-1, "could not read file");
+		}
+
+		TcpSendChunk &chunk = mQueueSend.front();
+
+		chunk.type = ChunkData;
+
+		lenMax = tokensTake(true, chunk.data.size() - mIdxSendFront,
+						CONFIG_TCP_SIZE_SEND_PACED_MIN);
+		if (!lenMax)
+			break;
+
+		res = Uring::send(mpUring, &chunk.data[mIdxSendFront], lenMax);
+		if (res < 0)
+			return res;
+
+		queueConsume(res);
+		bytesSum += res;
+
+		mStats.bytesSent += res;
+	}
+
+	while (mSizeQueueSend)
+	{
+		// Empty bucket. Next try on a later tick without a syscall
+		lenMax = tokensTake(true, mSizeQueueSend, CONFIG_TCP_SIZE_SEND_PACED_MIN);
+		if (!lenMax)
+			break;
+#if !defined(__linux__)
+		if (!chunkFileRead())
+		{
+			disconnect(EIO);
+			return procErrLog(-1, "could not read file");
+		}
+#endif
+		eventsSeen = mSlot.eventsReady;
+		res = chunkSend(lenBatch, lenMax);
+
+		// Region ended early. File has been truncated
+		if (!res && lenBatch && mQueueSend.front().type == ChunkFile)
+		{
+			tokensReturn(true, lenMax);
+			disconnect(EIO);
+			return procErrLog(-1, "file region truncated");
+		}
+
+		res = sendCheck(res, eventsSeen);
+		if (res >= 0)
+			tokensReturn(true, lenMax - res);
+
+		if (res < 0)
+			return res;
+
+		if (!res)
+			break;
+
+		queueConsume(res);
+		bytesSum += res;
+
+		mStats.bytesSent += res;
+
+		// Socket buffer full
+		if ((size_t)res < lenBatch)
+			break;
+	}
+
+	return bytesSum;
+}
+
+/*
+ * Sends the first chunk of the queue. Data chunks
+ * following it are sent with the same call. At most
+ * lenMax bytes are sent
+ */
+ssize_t TcpTransfering::chunkSend(size_t &lenBatch, size_t lenMax)
+{
+	TcpSendChunk &chunk = mQueueSend.front();
+	ssize_t res;
+
+	lenBatch = chunk.size() - mIdxSendFront;
+
+	if (lenBatch > lenMax)
+		lenBatch = lenMax;
+#if defined(__linux__)
+	if (chunk.type == ChunkFile)
+	{
+		off_t offset = chunk.offFile + mIdxSendFront;
+
+		return ::sendfile(mSocketFd, chunk.fdFile, &offset, lenBatch);
+	}
+#endif
+#if dHaveZeroCopy
+	if (chunk.type == ChunkZeroCopy)
+	{
+		res = ::send(mSocketFd, &chunk.data[mIdxSendFront], lenBatch,
+						MSG_ZEROCOPY | MSG_NOSIGNAL);
+		if (res > 0)
+		{
+			// IDs start with one. Zero means not sent yet
+			chunk.idZeroCopy = ++mIdZeroCopyNext;
+			++mZeroCopySent;
+		}
+
+		// Socket option memory exhausted. Send a copy
+		if (res >= 0 || errno != ENOBUFS)
+			return res;
+	}
+#endif
+#ifdef _WIN32
+	res = ::send(mSocketFd, (const char *)&chunk.data[mIdxSendFront], (int)lenBatch, MSG_NOSIGNAL);
+#else
+	struct iovec iov[CONFIG_TCP_NUM_CHUNKS_SENDMSG];
+	struct msghdr msg;
+	deque<TcpSendChunk>::iterator iter;
+	size_t numIov = 1;
+	int flags = MSG_NOSIGNAL;
+
+	iov[0].iov_base = &chunk.data[mIdxSendFront];
+	iov[0].iov_len = lenBatch;
+
+	iter = mQueueSend.begin() + 1;
+	for (; iter != mQueueSend.end() && numIov < CONFIG_TCP_NUM_CHUNKS_SENDMSG; ++iter)
+	{
+		if (iter->type != ChunkData || lenBatch >= lenMax)
+			break;
+
+		iov[numIov].iov_base = &iter->data[0];
+		iov[numIov].iov_len = iter->data.size();
+
+		if (iov[numIov].iov_len > lenMax - lenBatch)
+			iov[numIov].iov_len = lenMax - lenBatch;
+
+		lenBatch += iov[numIov].iov_len;
+		++numIov;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = numIov;
+#ifdef MSG_MORE
+	// Paced remainder is sent later. Not held back by the kernel
+	if (mCorked || (iter != mQueueSend.end() && lenBatch < lenMax))
+		flags |= MSG_MORE;
+#endif
+	res = ::sendmsg(mSocketFd, &msg, flags);
+#endif
+	return res;
+}
+
+ssize_t TcpTransfering::sendCheck(ssize_t numBytes, uint32_t eventsSeen)
+{
+	++mStats.callsSend;
+
+	if (numBytes >= 0)
+		return numBytes;
+
+	int numErr = errGet();
+#ifdef _WIN32
+	if (numErr == WSAEWOULDBLOCK || numErr == WSAEINPROGRESS)
+	{
+		++mStats.wouldBlockSend;
+		Reactor::eventsClear(mSlot, RevWrite, eventsSeen);
+		return 0; // std case and ok
+	}
+#else
+	if (numErr == EWOULDBLOCK || numErr == EINPROGRESS || numErr == EAGAIN)
+	{
+		++mStats.wouldBlockSend;
+		Reactor::eventsClear(mSlot, RevWrite, eventsSeen);
+		return 0; // std case and ok
+	}
+#endif
+	disconnect(numErr);
+
+	return procErrLog(-1, "connection down: %s",
+					errnoToStr(numErr).c_str());
+}
+
+// An empty queue accepts anything
+bool TcpTransfering::sendQueueFits(size_t len)
+{
+	if (mSizeQueueSend + len > CONFIG_TCP_SIZE_QUEUE_SEND_MAX && !mCorked)
+		sendFlush();
+
+	// Data handed over to the ring counts as well
+	size_t sizeQueued = mSizeQueueSend + Uring::sendQueueBytes(mpUring);
+
+	return !sizeQueued || sizeQueued + len <= CONFIG_TCP_SIZE_QUEUE_SEND_MAX;
+}
+
+void TcpTransfering::queueAppend(const uint8_t *pData, size_t len)
+{
+	if (!len)
+		return;
+
+	if (!mQueueSend.size() ||
+			mQueueSend.back().type != ChunkData ||
+			mQueueSend.back().data.size() + len > CONFIG_TCP_SIZE_CHUNK_SEND)
+		mQueueSend.push_back(TcpSendChunk());
+
+	VecByte &data = mQueueSend.back().data;
+
+	data.insert(data.end(), pData, pData + len);
+	mSizeQueueSend += len;
+}
+
+void TcpTransfering::queueConsume(size_t len)
+{
+	size_t lenChunk;
+
+	mSizeQueueSend -= len;
+
+	while (len)
+	{
+		TcpSendChunk &chunk = mQueueSend.front();
+
+		lenChunk = chunk.size() - mIdxSendFront;
+
+		if (len < lenChunk)
+		{
+			mIdxSendFront += len;
+			return;
+		}
+
+		// Kernel may still read the data
+		if (chunk.type == ChunkZeroCopy && chunk.idZeroCopy)
+		{
+			mZeroCopyPending.push_back(TcpSendChunk());
+			mZeroCopyPending.back().data.swap(chunk.data);
+			mZeroCopyPending.back().idZeroCopy = chunk.idZeroCopy;
+		}
+
+		chunkRelease(chunk);
+		mQueueSend.pop_front();
+		mIdxSendFront = 0;
+
+		len -= lenChunk;
+	}
+}
+
+/*
+ * Reads the next piece of the file region at the front
+ * of the queue into a data chunk placed before it. At
+ * most one piece of the file occupies memory
+ */
+bool TcpTransfering::chunkFileRead()
+{
+	if (!mQueueSend.size() || mQueueSend.front().type != ChunkFile)
+		return true;
+#ifdef _WIN32
+	return false;
+#else
+	TcpSendChunk &chunkFile = mQueueSend.front();
+	int64_t offset = chunkFile.offFile + mIdxSendFront;
+	size_t lenPiece = chunkFile.lenFile - mIdxSendFront;
+	size_t lenDone = 0;
+	VecByte data;
+	ssize_t res;
+
+	if (lenPiece > CONFIG_TCP_SIZE_CHUNK_SEND)
+		lenPiece = CONFIG_TCP_SIZE_CHUNK_SEND;
+
+	data.resize(lenPiece);
+
+	while (lenDone < lenPiece)
+	{
+		res = ::pread(chunkFile.fdFile, &data[lenDone],
+				lenPiece - lenDone, offset + lenDone);
+		if (res <= 0)
+			return false;
+
+		lenDone += res;
+	}
+
+	chunkFile.offFile = offset + lenPiece;
+	chunkFile.lenFile -= mIdxSendFront + lenPiece;
+	mIdxSendFront = 0;
+
+	if (!chunkFile.lenFile)
+	{
+		chunkRelease(chunkFile);
+		mQueueSend.pop_front();
+	}
+
+	mQueueSend.push_front(TcpSendChunk());
+	mQueueSend.front().data.swap(data);
+
+	return true;
+#endif
+}
+
+void TcpTransfering::chunkRelease(TcpSendChunk &chunk)
+{
+	if (chunk.fdFile < 0)
+		return;
+#ifndef _WIN32
+	::close(chunk.fdFile);
+#endif
+	chunk.fdFile = -1;
+}
+
+bool TcpTransfering::zeroCopyEnable()
+{
+#if dHaveZeroCopy
+	int opt = 1;
+	int res;
+
+	if (!mZeroCopyState)
+	{
+		res = ::setsockopt(mSocketFd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt));
+		mZeroCopyState = res ? -1 : 1;
+	}
+
+	return mZeroCopyState > 0;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Completions are ranges of send IDs. Ranges of a TCP
+ * socket are reported in order
+ */
+void TcpTransfering::zeroCopyCompletionsRead()
+{
+#if dHaveZeroCopy
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	struct sock_extended_err *pErr;
+	struct cmsghdr *pCmsg;
+	struct msghdr msg;
+	char bufCtrl[128];
+	ssize_t res;
+
+	while (mSocketFd != INVALID_SOCKET)
+	{
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = bufCtrl;
+		msg.msg_controllen = sizeof(bufCtrl);
+
+		res = ::recvmsg(mSocketFd, &msg, MSG_ERRQUEUE);
+		if (res < 0)
+			break;
+
+		pCmsg = CMSG_FIRSTHDR(&msg);
+		for (; pCmsg; pCmsg = CMSG_NXTHDR(&msg, pCmsg))
 		{
-			int numErr = errGet();
+			if (!(pCmsg->cmsg_level == SOL_IP && pCmsg->cmsg_type == IP_RECVERR) &&
+				!(pCmsg->cmsg_level == SOL_IPV6 && pCmsg->cmsg_type == IPV6_RECVERR))
+				continue;
+
+			pErr = (struct sock_extended_err *)CMSG_DATA(pCmsg);
+
+			if (pErr->ee_errno || pErr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+
+			// Data has been copied anyway. Loopback for example
+			if (pErr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				++mZeroCopyCopied;
+
+			// ee_data is the last ID of the range. IDs start with one
+			if ((int32_t)(pErr->ee_data + 1 - mIdZeroCopyDone) > 0)
+				mIdZeroCopyDone = pErr->ee_data + 1;
+		}
+	}
+
+	while (mZeroCopyPending.size() &&
+			(int32_t)(mIdZeroCopyDone - mZeroCopyPending.front().idZeroCopy) >= 0)
+		mZeroCopyPending.pop_front();
+#endif
+}
+
+void TcpTransfering::disconnect(int err)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	//Guard lock(mSocketFdMtx); // every caller must lock in advance!
+#endif
+	if (mSocketFd == INVALID_SOCKET)
+	{
+		procDbgLog("socket closed already");
+		return;
+	}
+
+	procDbgLog("closing socket: %d", mSocketFd);
+	mErrno = err;
+
+	if (mSizeQueueSend)
+		procWrnLog("dropping %zu queued bytes", mSizeQueueSend);
+
+	while (mQueueSend.size())
+	{
+		chunkRelease(mQueueSend.front());
+		mQueueSend.pop_front();
+	}
+
+	mIdxSendFront = 0;
+	mSizeQueueSend = 0;
+
+	// Pages stay referenced by the kernel
+	mZeroCopyPending.clear();
+	mIdZeroCopyDone = mIdZeroCopyNext;
+
+	Reactor::slotRemove(mSlot);
+
+	// Sends in flight are canceled. The ring closes the socket afterwards
+	if (!Uring::slotRemove(mpUring))
+	{
+#ifdef _WIN32
+		::closesocket(mSocketFd);
+#else
+		::close(mSocketFd);
+#endif
+	}
+	mSocketFd = INVALID_SOCKET;
+	procDbgLog("closing socket: %d: done", mSocketFd);
+}
+
+/*
+ * Registering is optional. Without reactor the
+ * socket is probed on every tick. If enabled the
+ * io_uring is preferred
+ */
+void TcpTransfering::reactorRegister()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	mpUring = Uring::recvStart(mSocketFd);
+	if (mpUring)
+		return;
+
+	if (!Reactor::slotAdd(mSlot, mSocketFd, RevRead | RevWrite))
+		procDbgLog("transfering without reactor");
+}
+
+bool TcpTransfering::uringPending()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	Uring::update(mpUring);
+
+	return Uring::pending(mpUring);
+}
+
+Success TcpTransfering::socketOptionsSet(bool tuningSet)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	string optsFailed;
+	int opt;
+	int res;
+	bool ok;
+
+	// Tuning is optional. Connection works without it
+	if (tuningSet && !optionsApply(mSocketFd, mOpts, optsFailed))
+		procWrnLog("could not set socket options:%s", optsFailed.c_str());
+
+	ok = fileNonBlockingSet(mSocketFd);
+	if (!ok)
+		return procErrLog(-3, "could not set non blocking mode: %s",
+							errnoToStr(errGet()).c_str());
+
+	// Receive buffer is allocated on first use
+	opt = 0;
 #ifdef _WIN32
-			if (numErr == WSAEWOULDBLOCK || numErr == WSAEINPROGRESS)
-				return 0; // std case and ok
+	int lenOpt = sizeof(opt);
 #else
-			if (numErr == EWOULDBLOCK || numErr == EINPROGRESS || numErr == EAGAIN)
-				return 0; // std case and ok
+	socklen_t lenOpt = sizeof(opt);
 #endif
-			disconnect(numErr);
+	res = ::getsockopt(mSocketFd, SOL_SOCKET, SO_RCVBUF, (char *)&opt, &lenOpt);
+	if (!res && opt > 0)
+		mSizeBufRecv = opt;
 
-			return procErrLog(-1, "connection down: %s",
-							errnoToStr(numErr).c_str());
+	if (mSizeBufRecv < CONFIG_TCP_SIZE_BUFFER_RECV_MIN)
+		mSizeBufRecv = CONFIG_TCP_SIZE_BUFFER_RECV_MIN;
+
+	if (mSizeBufRecv > CONFIG_TCP_SIZE_BUFFER_RECV_MAX)
+		mSizeBufRecv = CONFIG_TCP_SIZE_BUFFER_RECV_MAX;
+
+	// Unlimited is the default already
+	if (mBucketSend.rate())
+		pacingRateApply();
+
+	mReadReady = true;
+
+	return Positive;
+}
+
+// Families alternate, starting with the preferred one. RFC 8305
+void TcpTransfering::addrsInterleave()
+{
+	vector<string> addrs4, addrs6, *pFirst, *pSecond;
+	vector<string>::const_iterator iter;
+	size_t idx;
+
+	if (!mAddrsHost.size())
+		return;
+
+	iter = mAddrsHost.begin();
+	for (; iter != mAddrsHost.end(); ++iter)
+	{
+		if (iter->find(':') != string::npos)
+			addrs6.push_back(*iter);
+		else
+			addrs4.push_back(*iter);
+	}
+
+	pFirst = &addrs4;
+	pSecond = &addrs6;
+
+	if (mAddrsHost[0].find(':') != string::npos)
+	{
+		pFirst = &addrs6;
+		pSecond = &addrs4;
+	}
+
+	mAddrsHost.clear();
+
+	for (idx = 0; idx < pFirst->size() || idx < pSecond->size(); ++idx)
+	{
+		if (idx < pFirst->size())
+			mAddrsHost.push_back((*pFirst)[idx]);
+
+		if (idx < pSecond->size())
+			mAddrsHost.push_back((*pSecond)[idx]);
+	}
+
+	mIdxAddrHost = 0;
+}
+
+/*
+ * Attempts run in parallel. A new one is started after
+ * the attempt delay or as soon as one fails. The first
+ * connected attempt wins
+ *
+Literature
+- https://datatracker.ietf.org/doc/html/rfc8305
+*/
+Success TcpTransfering::connAttemptsCheck(uint32_t curTimeMs)
+{
+	size_t numActive = 0;
+	bool attemptFailed = false;
+	uint32_t events;
+	Success success;
+	int numErr = 0;
+
+	for (size_t i = 0; i < CONFIG_TCP_NUM_CONN_ATTEMPTS_MAX; ++i)
+	{
+		TcpConnAttempt &attempt = mAttempts[i];
+
+		if (attempt.fd == INVALID_SOCKET)
+			continue;
+
+		if (!attempt.connected)
+		{
+			events = Reactor::eventsUpdate(attempt.slot);
+
+			if (!(events & (RevWrite | RevHangUp | RevError)))
+				success = Pending;
+			else
+				success = connClientDone(attempt.fd, numErr);
+
+			if (success == Pending &&
+					curTimeMs - attempt.startMs > mTmoConnMs)
+			{
+				success = -1;
+				numErr = ETIMEDOUT;
+			}
+
+			if (success == Pending)
+			{
+				// Wait for the next edge
+				Reactor::eventsClear(attempt.slot, RevAll);
+				++numActive;
+				continue;
+			}
+
+			if (success != Positive)
+			{
+				procDbgLog("attempt failed: %s", errnoToStr(numErr).c_str());
+
+				mErrno = numErr;
+				connAttemptClose(attempt);
+				attemptFailed = true;
+				continue;
+			}
 		}
 
-		if (!res)
-			break;
+		// Winner. Reactor slot of the connection is added later
+		Reactor::slotRemove(attempt.slot);
+		mSocketFd = attempt.fd;
+		attempt.fd = INVALID_SOCKET;
 
-		pData = ((const uint8_t *)pData) + res;
-		lenReq -= res;
+		for (size_t k = 0; k < CONFIG_TCP_NUM_CONN_ATTEMPTS_MAX; ++k)
+			connAttemptClose(mAttempts[k]);
 
-		bytesSent += res;
+		return Positive;
 	}
 
-	if (bytesSent != lenBkup)
-		procWrnLog("not all data has been sent");
+	if (mIdxAddrHost >= mAddrsHost.size())
+		return numActive ? Pending : -1;
+
+	if (numActive >= CONFIG_TCP_NUM_CONN_ATTEMPTS_MAX)
+		return Pending;
+
+	if (numActive && !attemptFailed &&
+			curTimeMs - mAttemptLastMs < mDelayConnAttemptMs)
+		return Pending;
 
-	mBytesSent += bytesSent;
+	connAttemptStart(curTimeMs);
 
-	return bytesSent;
+	return Pending;
 }
 
-void TcpTransfering::disconnect(int err)
+Success TcpTransfering::connAttemptStart(uint32_t curTimeMs)
 {
-#if CONFIG_PROC_HAVE_DRIVERS
-	//Guard lock(mSocketFdMtx); // every caller must lock in advance!
-#endif
-	if (mSocketFd == INVALID_SOCKET)
+	TcpConnAttempt *pAttempt = NULL;
+	string optsFailed;
+	int res, numErr;
+
+	for (size_t i = 0; i < CONFIG_TCP_NUM_CONN_ATTEMPTS_MAX; ++i)
 	{
-		procDbgLog("socket closed already");
-		return;
+		if (mAttempts[i].fd != INVALID_SOCKET)
+			continue;
+
+		pAttempt = &mAttempts[i];
+		break;
 	}
 
-	procDbgLog("closing socket: %d", mSocketFd);
-	mErrno = err;
+	if (!pAttempt)
+		return Pending;
+
+	const string &strAddr = mAddrsHost[mIdxAddrHost++];
+
+	mAttemptLastMs = curTimeMs;
+	++mConnAttempts;
+
+	// create local address structure
+
+	mpHostAddr = addrStringToSock(strAddr, mHostPort);
+	if (!mpHostAddr)
+		return procErrLog(-1, "could not parse IP address. Given: '%s'",
+				strAddr.c_str());
+
+	// create and configure socket
+
+	pAttempt->fd = socket(mpHostAddr->ss_family, SOCK_STREAM, 0);
+	pAttempt->startMs = curTimeMs;
+
+	if (pAttempt->fd == INVALID_SOCKET || !fileNonBlockingSet(pAttempt->fd))
+	{
+		mErrno = errGet();
+		free(mpHostAddr);
+		mpHostAddr = NULL;
+		connAttemptClose(*pAttempt);
+		return procErrLog(-1, "could not create socket: %s",
+						errnoToStr(mErrno).c_str());
+	}
+
+	// Buffer sizes must be known before the handshake
+	if (!optionsApply(pAttempt->fd, mOpts, optsFailed))
+		procWrnLog("could not set socket options:%s", optsFailed.c_str());
+
+	res = connect(pAttempt->fd, (struct sockaddr *)mpHostAddr, sizeof(*mpHostAddr));
+
+	free(mpHostAddr);
+	mpHostAddr = NULL;
+
+	if (!res)
+	{
+		pAttempt->connected = true;
+		return Positive;
+	}
+
+	numErr = errGet();
 #ifdef _WIN32
-	::closesocket(mSocketFd);
+	if (numErr == WSAEWOULDBLOCK || numErr == WSAEINPROGRESS)
 #else
-	::close(mSocketFd);
+	if (numErr == EINPROGRESS)
 #endif
-	mSocketFd = INVALID_SOCKET;
-	procDbgLog("closing socket: %d: done", mSocketFd);
-}
+	{
+		if (!Reactor::slotAdd(pAttempt->slot, pAttempt->fd, RevWrite))
+			procDbgLog("connecting without reactor");
 
-Success TcpTransfering::socketOptionsSet()
-{
-#if CONFIG_PROC_HAVE_DRIVERS
-	Guard lock(mSocketFdMtx);
-#endif
-	int opt;
-	int res;
-	bool ok;
+		return Positive;
+	}
 
-	opt = 1;
-	res = ::setsockopt(mSocketFd, SOL_SOCKET, SO_KEEPALIVE, (const char *)&opt, sizeof(opt));
-	if (res)
-		return procErrLog(-2, "setsockopt(SO_KEEPALIVE) failed: %s",
-							errnoToStr(errGet()).c_str());
+	// Unreachable address family for example
+	procDbgLog("could not connect to %s: %s",
+			strAddr.c_str(), errnoToStr(numErr).c_str());
 
-	ok = fileNonBlockingSet(mSocketFd);
-	if (!ok)
-		return procErrLog(-3, "could not set non blocking mode: %s",
-							errnoToStr(errGet()).c_str());
+	mErrno = numErr;
+	connAttemptClose(*pAttempt);
 
-	mReadReady = true;
+	return -1;
+}
 
-	return Positive;
+void TcpTransfering::connAttemptClose(TcpConnAttempt &attempt)
+{
+	if (attempt.fd == INVALID_SOCKET)
+		return;
+
+	Reactor::slotRemove(attempt.slot);
+#ifdef _WIN32
+	::closesocket(attempt.fd);
+#else
+	::close(attempt.fd);
+#endif
+	attempt.fd = INVALID_SOCKET;
+	attempt.connected = false;
 }
 
 /* Literature
@@ -520,7 +1800,7 @@ Success TcpTransfering::socketOptionsSet()
  * - https://learn.microsoft.com/en-us/windows/win32/api/winsock2/nf-winsock2-wsapoll
  * - https://learn.microsoft.com/en-us/windows/win32/api/winsock/nf-winsock-getsockopt
  */
-Success TcpTransfering::connClientDone()
+Success TcpTransfering::connClientDone(SOCKET fd, int &numErr)
 {
 #ifdef _WIN32
 	WSAPOLLFD fds[1];
@@ -529,7 +1809,7 @@ Success TcpTransfering::connClientDone()
 #endif
 	int res;
 
-	fds[0].fd = mSocketFd;
+	fds[0].fd = fd;
 	fds[0].events = POLLOUT;
 #ifdef _WIN32
 	res = WSAPoll(fds, 1, 0);
@@ -540,27 +1820,36 @@ Success TcpTransfering::connClientDone()
 		return Pending;
 
 	if (res < 0)
-		return procErrLog(-1, "could not poll socket: %s",
-						errnoToStr(errGet()).c_str());
-
-	if (!(fds[0].revents & POLLOUT))
-		return procErrLog(-1, "didn't get POLLOUT event");
+	{
+		numErr = errGet();
+		return -1;
+	}
 
 	int errSock;
 #ifdef _WIN32
 	int len = sizeof(errSock);
-	res = ::getsockopt(mSocketFd, SOL_SOCKET, SO_ERROR, (char *)&errSock, &len);
+	res = ::getsockopt(fd, SOL_SOCKET, SO_ERROR, (char *)&errSock, &len);
 #else
 	socklen_t len = sizeof(errSock);
-	res = ::getsockopt(mSocketFd, SOL_SOCKET, SO_ERROR, &errSock, &len);
+	res = ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &errSock, &len);
 #endif
 	if (res)
-		return procErrLog(-2, "getsockopt(SO_ERROR) failed: %s",
-							errnoToStr(errGet()).c_str());
+	{
+		numErr = errGet();
+		return -2;
+	}
 
 	if (errSock)
-		return procErrLog(-2, "socket error: %s",
-							errnoToStr(errSock).c_str());
+	{
+		numErr = errSock;
+		return -2;
+	}
+
+	if (!(fds[0].revents & POLLOUT))
+	{
+		numErr = ECONNREFUSED;
+		return -1;
+	}
 
 	return Positive;
 }
@@ -577,6 +1866,9 @@ Success TcpTransfering::connClientDone()
  */
 void TcpTransfering::addrInfoSet()
 {
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
 	if (mInfoSet)
 		return;
 
@@ -623,6 +1915,90 @@ void TcpTransfering::addrInfoSet()
 	mInfoSet = true;
 }
 
+// Addresses are resolved on first use only
+const string &TcpTransfering::addrRemote() const
+{
+	((TcpTransfering *)this)->addrInfoSet();
+	return mAddrRemote;
+}
+
+void TcpTransfering::connTimeoutSet(uint32_t tmoMs)
+{
+	mTmoConnMs = tmoMs;
+}
+
+void TcpTransfering::connAttemptDelaySet(uint32_t delayMs)
+{
+	mDelayConnAttemptMs = delayMs;
+}
+
+// Sockets in use are changed immediately
+void TcpTransfering::optionsSet(const TcpSocketOptions &opts)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	string optsFailed;
+
+	mOpts = opts;
+
+	if (!mReadReady || mSocketFd == INVALID_SOCKET)
+		return;
+
+	if (!optionsApply(mSocketFd, mOpts, optsFailed))
+		procWrnLog("could not set socket options:%s", optsFailed.c_str());
+}
+
+/*
+ * Rate limits in bytes per second. Zero removes the limit
+ * - Limited data always passes the send queue. It is sent
+ *   as far as the tokens allow and continued on later ticks
+ * - Received data is left in the kernel while no tokens
+ *   are available. TCP flow control throttles the peer
+ * - The send rate is also given to the kernel with
+ *   SO_MAX_PACING_RATE (Linux). Segments are then spread
+ *   over time instead of being sent in bursts
+ *
+Literature
+- https://en.wikipedia.org/wiki/Token_bucket
+- https://man7.org/linux/man-pages/man7/socket.7.html
+  - SO_MAX_PACING_RATE
+- https://man7.org/linux/man-pages/man8/tc-fq.8.html
+*/
+void TcpTransfering::sendRateSet(uint64_t bytesPerSec, uint64_t burst)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	mBucketSend.rateSet(bytesPerSec, burst);
+
+	if (!mReadReady || mSocketFd == INVALID_SOCKET)
+		return;
+
+	pacingRateApply();
+}
+
+void TcpTransfering::recvRateSet(uint64_t bytesPerSec, uint64_t burst)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	mBucketRecv.rateSet(bytesPerSec, burst);
+}
+
+/*
+ * Shared limits for a group of connections. Buckets must
+ * outlive the connections. NULL removes the group limit
+ */
+void TcpTransfering::rateGroupSet(TokenBucket *pBucketSend, TokenBucket *pBucketRecv)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	mpGroupSend = pBucketSend;
+	mpGroupRecv = pBucketRecv;
+}
+
 struct sockaddr_storage *TcpTransfering::addrStringToSock(const string &strAddr, uint16_t numPort)
 {
 	struct sockaddr_storage *pAddr;
@@ -689,10 +2065,182 @@ string TcpTransfering::errnoToStr(int num)
 	return string(pBuf);
 }
 
+TcpStats TcpTransfering::stats()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	return mStats;
+}
+
+/*
+ * Rates are smoothed with a weight of one quarter per sample.
+ * TCP_INFO costs a syscall and is read at the same low rate
+ */
+void TcpTransfering::statsUpdate(uint32_t curTimeMs)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	uint32_t diffMs = curTimeMs - mStatsLastMs;
+	bool isFirst = !mStatsLastMs;
+	uint64_t rateRecv, rateSend;
+
+	mStatsLastMs = curTimeMs;
+
+	if (!isFirst && diffMs)
+	{
+		rateRecv = (mStats.bytesReceived - mBytesReceivedLast) * 1000 / diffMs;
+		rateSend = (mStats.bytesSent - mBytesSentLast) * 1000 / diffMs;
+
+		// No history yet. Sample is taken as it is
+		if (!mStats.rateRecvBps)
+			mStats.rateRecvBps = rateRecv;
+
+		if (!mStats.rateSendBps)
+			mStats.rateSendBps = rateSend;
+
+		mStats.rateRecvBps = (3 * mStats.rateRecvBps + rateRecv) / 4;
+		mStats.rateSendBps = (3 * mStats.rateSendBps + rateSend) / 4;
+	}
+
+	mBytesReceivedLast = mStats.bytesReceived;
+	mBytesSentLast = mStats.bytesSent;
+#if defined(__linux__) && defined(TCP_INFO)
+	if (mSocketFd == INVALID_SOCKET)
+		return;
+
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+
+	memset(&info, 0, sizeof(info));
+
+	if (::getsockopt(mSocketFd, IPPROTO_TCP, TCP_INFO, &info, &len))
+		return;
+
+	mStats.rttUs = info.tcpi_rtt;
+	mStats.rttVarUs = info.tcpi_rttvar;
+	mStats.cwnd = info.tcpi_snd_cwnd;
+	mStats.retransmits = info.tcpi_total_retrans;
+#endif
+}
+
+bool TcpTransfering::sendPaced()
+{
+	return mBucketSend.rate() || (mpGroupSend && mpGroupSend->rate());
+}
+
+/*
+ * Tokens are taken from the own bucket first. The
+ * group bucket may grant less. The rest is returned
+ */
+size_t TcpTransfering::tokensTake(bool isSend, size_t len, size_t lenMin)
+{
+	TokenBucket &bucket = isSend ? mBucketSend : mBucketRecv;
+	TokenBucket *pGroup = isSend ? mpGroupSend : mpGroupRecv;
+	size_t lenOwn, lenGroup;
+
+	lenOwn = bucket.tokensTake(len, lenMin);
+	if (!lenOwn || !pGroup)
+		return lenOwn;
+
+	lenGroup = pGroup->tokensTake(lenOwn, lenMin, this);
+	bucket.tokensReturn(lenOwn - lenGroup);
+
+	return lenGroup;
+}
+
+void TcpTransfering::tokensReturn(bool isSend, size_t len)
+{
+	if (!len)
+		return;
+
+	if (isSend)
+	{
+		mBucketSend.tokensReturn(len);
+		if (mpGroupSend)
+			mpGroupSend->tokensReturn(len);
+
+		return;
+	}
+
+	mBucketRecv.tokensReturn(len);
+	if (mpGroupRecv)
+		mpGroupRecv->tokensReturn(len);
+}
+
+/*
+ * Group limits stay in user space only. The kernel
+ * paces each socket on its own
+ */
+void TcpTransfering::pacingRateApply()
+{
+#ifdef SO_MAX_PACING_RATE
+	uint64_t rate = mBucketSend.rate();
+	unsigned int opt = ~0U;
+
+	// Unlimited is ~0U
+	if (rate && rate < opt)
+		opt = (unsigned int)rate;
+
+	int res = ::setsockopt(mSocketFd, SOL_SOCKET, SO_MAX_PACING_RATE,
+						(const char *)&opt, sizeof(opt));
+	if (res)
+		procWrnLog("could not set pacing rate: %s",
+						errnoToStr(errGet()).c_str());
+#endif
+}
+
 void TcpTransfering::processInfo(char *pBuf, char *pBufEnd)
 {
 	//dInfo("State\t\t\t%s\n", ProcStateString[mState]);
-	dInfo("Bytes received\t\t%d\n", (int)mBytesReceived);
+	TcpStats st = stats();
+
+	dInfo("Bytes received\t\t%llu (%llu calls, %llu would block)\n",
+			(unsigned long long)st.bytesReceived,
+			(unsigned long long)st.callsRecv,
+			(unsigned long long)st.wouldBlockRecv);
+	dInfo("Bytes sent\t\t%llu (%llu calls, %llu would block)\n",
+			(unsigned long long)st.bytesSent,
+			(unsigned long long)st.callsSend,
+			(unsigned long long)st.wouldBlockSend);
+	dInfo("Bytes queued\t\t%zu\n", sendQueueBytes());
+	dInfo("Throughput\t\tin %llu B/s, out %llu B/s\n",
+			(unsigned long long)st.rateRecvBps,
+			(unsigned long long)st.rateSendBps);
+
+	if (st.rttUs)
+		dInfo("RTT\t\t\t%u.%03ums (var %u.%03ums)\n",
+				st.rttUs / 1000, st.rttUs % 1000,
+				st.rttVarUs / 1000, st.rttVarUs % 1000);
+
+	if (st.cwnd)
+		dInfo("Congestion window\t%u (%u retransmits)\n",
+				st.cwnd, st.retransmits);
+
+	uint64_t rateSend = mBucketSend.rate();
+	uint64_t rateRecv = mBucketRecv.rate();
+
+	if (rateSend || rateRecv)
+		dInfo("Rate limit\t\tin %llu B/s, out %llu B/s\n",
+				(unsigned long long)rateRecv,
+				(unsigned long long)rateSend);
+
+	if (mpGroupSend || mpGroupRecv)
+		dInfo("Rate limit group\tin %llu B/s, out %llu B/s\n",
+				(unsigned long long)(mpGroupRecv ? mpGroupRecv->rate() : 0),
+				(unsigned long long)(mpGroupSend ? mpGroupSend->rate() : 0));
+
+	if (mConnDurationMs || mConnAttempts)
+		dInfo("Time to connect\t\t%ums (%u attempts)\n",
+				(unsigned)mConnDurationMs, (unsigned)mConnAttempts);
+
+	if (mZeroCopySent)
+		dInfo("Zero-copy sends\t\t%u (copied %u)\n",
+				(unsigned)mZeroCopySent, (unsigned)mZeroCopyCopied);
+
+	if (mSendReady)
+		addrInfoSet();
 
 	if (!mInfoSet)
 		return;
@@ -772,6 +2320,10 @@ bool TcpTransfering::fileNonBlockingSet(SOCKET fd)
 	if (opt == -1)
 		return false;
 
+	// Sockets from accept4() are non-blocking already
+	if (opt & O_NONBLOCK)
+		return true;
+
 	opt |= O_NONBLOCK;
 
 	opt = fcntl(fd, F_SETFL, opt);
@@ -781,6 +2333,64 @@ bool TcpTransfering::fileNonBlockingSet(SOCKET fd)
 	return true;
 }
 
+// Names of failed options are appended to optsFailed
+#define dOptionApply(cond, level, name, val) \
+	if ((cond) && !intOptionSet(fd, level, name, val)) \
+		optsFailed += " " #name;
+
+#define dOptionUnsupported(cond, name) \
+	if (cond) \
+		optsFailed += " " #name;
+
+bool TcpTransfering::optionsApply(SOCKET fd, const TcpSocketOptions &opts,
+							string &optsFailed)
+{
+	optsFailed = "";
+
+	dOptionApply(opts.noDelay >= 0, IPPROTO_TCP, TCP_NODELAY, opts.noDelay)
+	dOptionApply(opts.keepAlive >= 0, SOL_SOCKET, SO_KEEPALIVE, opts.keepAlive)
+	dOptionApply(opts.sizeBufSend > 0, SOL_SOCKET, SO_SNDBUF, opts.sizeBufSend)
+	dOptionApply(opts.sizeBufRecv > 0, SOL_SOCKET, SO_RCVBUF, opts.sizeBufRecv)
+#if defined(TCP_KEEPIDLE)
+	dOptionApply(opts.keepIdleS > 0, IPPROTO_TCP, TCP_KEEPIDLE, opts.keepIdleS)
+#elif defined(TCP_KEEPALIVE)
+	dOptionApply(opts.keepIdleS > 0, IPPROTO_TCP, TCP_KEEPALIVE, opts.keepIdleS)
+#else
+	dOptionUnsupported(opts.keepIdleS > 0, TCP_KEEPIDLE)
+#endif
+#if defined(TCP_KEEPINTVL)
+	dOptionApply(opts.keepIntvlS > 0, IPPROTO_TCP, TCP_KEEPINTVL, opts.keepIntvlS)
+#else
+	dOptionUnsupported(opts.keepIntvlS > 0, TCP_KEEPINTVL)
+#endif
+#if defined(TCP_KEEPCNT)
+	dOptionApply(opts.keepCnt > 0, IPPROTO_TCP, TCP_KEEPCNT, opts.keepCnt)
+#else
+	dOptionUnsupported(opts.keepCnt > 0, TCP_KEEPCNT)
+#endif
+#if defined(TCP_QUICKACK)
+	dOptionApply(opts.quickAck >= 0, IPPROTO_TCP, TCP_QUICKACK, opts.quickAck)
+#else
+	dOptionUnsupported(opts.quickAck > 0, TCP_QUICKACK)
+#endif
+#if defined(SO_BUSY_POLL)
+	dOptionApply(opts.busyPollUs > 0, SOL_SOCKET, SO_BUSY_POLL, opts.busyPollUs)
+#else
+	dOptionUnsupported(opts.busyPollUs > 0, SO_BUSY_POLL)
+#endif
+#if defined(TCP_USER_TIMEOUT)
+	dOptionApply(opts.userTimeoutMs > 0, IPPROTO_TCP, TCP_USER_TIMEOUT, opts.userTimeoutMs)
+#else
+	dOptionUnsupported(opts.userTimeoutMs > 0, TCP_USER_TIMEOUT)
+#endif
+	return !optsFailed.size();
+}
+
+bool TcpTransfering::intOptionSet(SOCKET fd, int level, int name, int val)
+{
+	return !::setsockopt(fd, level, name, (const char *)&val, sizeof(val));
+}
+
 #ifdef _WIN32
 bool TcpTransfering::wsaInit()
 {
@@ -32,6 +32,8 @@
 #define TCP_TRANSFERING_H
 
 #include <string>
+#include <vector>
+#include <deque>
 
 #ifdef _WIN32
 // https://learn.microsoft.com/en-us/cpp/porting/modifying-winver-and-win32-winnt?view=msvc-170
@@ -66,6 +68,210 @@
 #endif
 
 #include "Transfering.h"
+#include "Reactor.h"
+#include "Uring.h"
+#include "TokenBucket.h"
+
+class HostResolving;
+
+// The receive buffer follows SO_RCVBUF within these limits
+#ifndef CONFIG_TCP_SIZE_BUFFER_RECV_MIN
+#define CONFIG_TCP_SIZE_BUFFER_RECV_MIN		1024
+#endif
+
+#ifndef CONFIG_TCP_SIZE_BUFFER_RECV_MAX
+#define CONFIG_TCP_SIZE_BUFFER_RECV_MAX		(64 * 1024)
+#endif
+
+// Data which can't be sent at once is queued up to this size
+#ifndef CONFIG_TCP_SIZE_QUEUE_SEND_MAX
+#define CONFIG_TCP_SIZE_QUEUE_SEND_MAX		(1024 * 1024)
+#endif
+
+// Small sends are merged into chunks of this size
+#ifndef CONFIG_TCP_SIZE_CHUNK_SEND
+#define CONFIG_TCP_SIZE_CHUNK_SEND		(16 * 1024)
+#endif
+
+#ifndef CONFIG_TCP_NUM_CHUNKS_SENDMSG
+#define CONFIG_TCP_NUM_CHUNKS_SENDMSG		16
+#endif
+
+// Time for sending the queue after doneSet()
+#ifndef CONFIG_TCP_TIMEOUT_SEND_FLUSH_MS
+#define CONFIG_TCP_TIMEOUT_SEND_FLUSH_MS	3000
+#endif
+
+// Smaller buffers are sent with a copy. Pinning pages costs more
+#ifndef CONFIG_TCP_SIZE_ZEROCOPY_MIN
+#define CONFIG_TCP_SIZE_ZEROCOPY_MIN		(16 * 1024)
+#endif
+
+// Each connection attempt is given up after this time
+#ifndef CONFIG_TCP_TIMEOUT_CONNECT_MS
+#define CONFIG_TCP_TIMEOUT_CONNECT_MS		2000
+#endif
+
+// Next address is tried in parallel after this time. RFC 8305
+#ifndef CONFIG_TCP_DELAY_CONN_ATTEMPT_MS
+#define CONFIG_TCP_DELAY_CONN_ATTEMPT_MS	250
+#endif
+
+// Rates and TCP_INFO are sampled at this interval
+#ifndef CONFIG_TCP_INTERVAL_STATS_MS
+#define CONFIG_TCP_INTERVAL_STATS_MS		1000
+#endif
+
+// Paced sends wait for tokens of at least one segment
+#ifndef CONFIG_TCP_SIZE_SEND_PACED_MIN
+#define CONFIG_TCP_SIZE_SEND_PACED_MIN		1448
+#endif
+
+#ifndef CONFIG_TCP_NUM_CONN_ATTEMPTS_MAX
+#define CONFIG_TCP_NUM_CONN_ATTEMPTS_MAX	4
+#endif
+
+enum TcpSendChunkType
+{
+	ChunkData = 0,
+	ChunkZeroCopy,
+	ChunkFile,
+};
+
+struct TcpSendChunk
+{
+	TcpSendChunk()
+		: type(ChunkData)
+		, data()
+		, fdFile(-1)
+		, offFile(0)
+		, lenFile(0)
+		, idZeroCopy(0)
+	{}
+
+	size_t size() const
+	{
+		return type == ChunkFile ? lenFile : data.size();
+	}
+
+	int type;
+	VecByte data;
+
+	// File region. Descriptor is owned by the chunk
+	int fdFile;
+	int64_t offFile;
+	size_t lenFile;
+
+	// Last MSG_ZEROCOPY send which used the data
+	uint32_t idZeroCopy;
+};
+
+/*
+ * Tuning profile of a socket. Negative values and zero
+ * keep the system default
+ * - Quick ACK mode is left by the kernel on its own.
+ *   It is set again after each receive
+ * - Options unknown to the platform are reported as failed
+ * - A new profile replaces the old one. Including the
+ *   keepalive default of clients and listeners
+ *
+Literature
+- https://man7.org/linux/man-pages/man7/tcp.7.html
+- https://man7.org/linux/man-pages/man7/socket.7.html
+- https://datatracker.ietf.org/doc/html/rfc5482
+  - TCP_USER_TIMEOUT
+*/
+struct TcpSocketOptions
+{
+	TcpSocketOptions()
+		: noDelay(-1)
+		, keepAlive(-1)
+		, quickAck(-1)
+		, sizeBufSend(0)
+		, sizeBufRecv(0)
+		, keepIdleS(0)
+		, keepIntvlS(0)
+		, keepCnt(0)
+		, busyPollUs(0)
+		, userTimeoutMs(0)
+	{}
+
+	// -1 .. unchanged, 0 .. off, 1 .. on
+	int noDelay;
+	int keepAlive;
+	int quickAck;
+
+	// 0 .. unchanged
+	int sizeBufSend;
+	int sizeBufRecv;
+	int keepIdleS;
+	int keepIntvlS;
+	int keepCnt;
+	int busyPollUs;
+	int userTimeoutMs;
+};
+
+/*
+ * Statistics of a connection
+ * - Calls count receive and send operations. Would block
+ *   counts those returning EAGAIN
+ * - Rates are moving averages over the last samples
+ * - RTT, congestion window and retransmits are read from
+ *   TCP_INFO (Linux). They stay zero elsewhere
+ *
+Literature
+- https://man7.org/linux/man-pages/man7/tcp.7.html
+- https://en.wikipedia.org/wiki/Moving_average#Exponential_moving_average
+*/
+struct TcpStats
+{
+	TcpStats()
+		: bytesReceived(0)
+		, bytesSent(0)
+		, callsRecv(0)
+		, callsSend(0)
+		, wouldBlockRecv(0)
+		, wouldBlockSend(0)
+		, rateRecvBps(0)
+		, rateSendBps(0)
+		, rttUs(0)
+		, rttVarUs(0)
+		, cwnd(0)
+		, retransmits(0)
+	{}
+
+	uint64_t bytesReceived;
+	uint64_t bytesSent;
+	uint64_t callsRecv;
+	uint64_t callsSend;
+	uint64_t wouldBlockRecv;
+	uint64_t wouldBlockSend;
+
+	// Bytes per second
+	uint64_t rateRecvBps;
+	uint64_t rateSendBps;
+
+	uint32_t rttUs;
+	uint32_t rttVarUs;
+	uint32_t cwnd; // Segments
+	uint32_t retransmits;
+};
+
+// Slot is registered at the reactor and must not move
+struct TcpConnAttempt
+{
+	TcpConnAttempt()
+		: fd(INVALID_SOCKET)
+		, slot()
+		, startMs(0)
+		, connected(false)
+	{}
+
+	SOCKET fd;
+	ReactorSlot slot;
+	uint32_t startMs;
+	bool connected;
+};
 
 class TcpTransfering : public Transfering
 {
@@ -84,7 +290,26 @@ public:
 
 	ssize_t read(void *pBuf, size_t lenReq);
 	ssize_t readFlush();
+	ssize_t peek(const uint8_t *&pData, size_t lenMin = 1);
+	bool peekSupported() const;
+	void consume(size_t len);
+	size_t recvQueueBytes();
+	Success exactRead(void *pBuf, size_t lenReq);
 	ssize_t send(const void *pData, size_t lenReq);
+	void corkSet(bool corked);
+	size_t sendQueueBytes();
+	ssize_t sendZeroCopy(VecByte &buf);
+	ssize_t fileSend(int fdFile, int64_t offset, size_t len);
+	const std::string &addrRemote() const;
+	void connTimeoutSet(uint32_t tmoMs);
+	TcpStats stats();
+	void optionsSet(const TcpSocketOptions &opts);
+	static bool optionsApply(SOCKET fd, const TcpSocketOptions &opts,
+							std::string &optsFailed);
+	void connAttemptDelaySet(uint32_t delayMs);
+	void sendRateSet(uint64_t bytesPerSec, uint64_t burst = 0);
+	void recvRateSet(uint64_t bytesPerSec, uint64_t burst = 0);
+	void rateGroupSet(TokenBucket *pBucketSend, TokenBucket *pBucketRecv = NULL);
 #ifdef _WIN32
 	static bool wsaInit();
 #endif
@@ -108,15 +333,48 @@ private:
 		, mSocketFdMtx()
 #endif
 		, mSocketFd(INVALID_SOCKET)
+		, mSlot()
+		, mpUring(NULL)
 		, mHostAddrStr("")
 		, mHostPort(0)
 		, mpHostAddr(NULL)
+		, mpResolv(NULL)
+		, mAddrsHost()
+		, mIdxAddrHost(0)
+		, mAttempts()
+		, mTmoConnMs(0)
+		, mDelayConnAttemptMs(0)
+		, mAttemptLastMs(0)
+		, mOpts()
 		, mErrno(0)
 		, mInfoSet(false)
 		, mIsIPv6Local(false)
 		, mIsIPv6Remote(false)
-		, mBytesReceived(0)
-		, mBytesSent(0)
+		, mBufRecv()
+		, mSizeBufRecv(0)
+		, mIdxRecvStart(0)
+		, mIdxRecvEnd(0)
+		, mQueueSend()
+		, mIdxSendFront(0)
+		, mSizeQueueSend(0)
+		, mCorked(false)
+		, mZeroCopyPending()
+		, mZeroCopyState(0)
+		, mIdZeroCopyNext(0)
+		, mIdZeroCopyDone(0)
+		, mStats()
+		, mStatsLastMs(0)
+		, mBytesReceivedLast(0)
+		, mBytesSentLast(0)
+		, mZeroCopySent(0)
+		, mZeroCopyCopied(0)
+		, mConnStartMs(0)
+		, mConnDurationMs(0)
+		, mConnAttempts(0)
+		, mBucketSend()
+		, mBucketRecv()
+		, mpGroupSend(NULL)
+		, mpGroupRecv(NULL)
 	{
 		mState = 0;
 		mSendReady = false;
@@ -128,15 +386,48 @@ private:
 		, mSocketFdMtx()
 #endif
 		, mSocketFd(INVALID_SOCKET)
+		, mSlot()
+		, mpUring(NULL)
 		, mHostAddrStr("")
 		, mHostPort(0)
 		, mpHostAddr(NULL)
+		, mpResolv(NULL)
+		, mAddrsHost()
+		, mIdxAddrHost(0)
+		, mAttempts()
+		, mTmoConnMs(0)
+		, mDelayConnAttemptMs(0)
+		, mAttemptLastMs(0)
+		, mOpts()
 		, mErrno(0)
 		, mInfoSet(false)
 		, mIsIPv6Local(false)
 		, mIsIPv6Remote(false)
-		, mBytesReceived(0)
-		, mBytesSent(0)
+		, mBufRecv()
+		, mSizeBufRecv(0)
+		, mIdxRecvStart(0)
+		, mIdxRecvEnd(0)
+		, mQueueSend()
+		, mIdxSendFront(0)
+		, mSizeQueueSend(0)
+		, mCorked(false)
+		, mZeroCopyPending()
+		, mZeroCopyState(0)
+		, mIdZeroCopyNext(0)
+		, mIdZeroCopyDone(0)
+		, mStats()
+		, mStatsLastMs(0)
+		, mBytesReceivedLast(0)
+		, mBytesSentLast(0)
+		, mZeroCopySent(0)
+		, mZeroCopyCopied(0)
+		, mConnStartMs(0)
+		, mConnDurationMs(0)
+		, mConnAttempts(0)
+		, mBucketSend()
+		, mBucketRecv()
+		, mpGroupSend(NULL)
+		, mpGroupRecv(NULL)
 	{
 		mState = 0;
 		mSendReady = false;
@@ -145,15 +436,49 @@ private:
 	{
 		mStartMs = 0;
 		mSocketFd = INVALID_SOCKET;
+		mSlot = ReactorSlot();
+		mpUring = NULL;
 		mHostAddrStr = "";
 		mHostPort = 0;
 		mpHostAddr = NULL;
+		mpResolv = NULL;
+		mAddrsHost.clear();
+		mIdxAddrHost = 0;
+		for (size_t i = 0; i < CONFIG_TCP_NUM_CONN_ATTEMPTS_MAX; ++i)
+			mAttempts[i] = TcpConnAttempt();
+		mTmoConnMs = 0;
+		mDelayConnAttemptMs = 0;
+		mAttemptLastMs = 0;
+		mOpts = TcpSocketOptions();
 		mErrno = 0;
 		mInfoSet = false;
 		mIsIPv6Local = false;
 		mIsIPv6Remote = false;
-		mBytesReceived = 0;
-		mBytesSent = 0;
+		mBufRecv.clear();
+		mSizeBufRecv = 0;
+		mIdxRecvStart = 0;
+		mIdxRecvEnd = 0;
+		mQueueSend.clear();
+		mIdxSendFront = 0;
+		mSizeQueueSend = 0;
+		mCorked = false;
+		mZeroCopyPending.clear();
+		mZeroCopyState = 0;
+		mIdZeroCopyNext = 0;
+		mIdZeroCopyDone = 0;
+		mStats = TcpStats();
+		mStatsLastMs = 0;
+		mBytesReceivedLast = 0;
+		mBytesSentLast = 0;
+		mZeroCopySent = 0;
+		mZeroCopyCopied = 0;
+		mConnStartMs = 0;
+		mConnDurationMs = 0;
+		mConnAttempts = 0;
+		mBucketSend.rateSet(0);
+		mBucketRecv.rateSet(0);
+		mpGroupSend = NULL;
+		mpGroupRecv = NULL;
 
 		mState = 0;
 		mSendReady = false;
@@ -171,8 +496,31 @@ private:
 	Success shutdown();
 
 	void disconnect(int err = 0);
-	Success socketOptionsSet();
-	Success connClientDone();
+	ssize_t bufferFill();
+	ssize_t recvCheck(ssize_t numBytes, uint32_t eventsSeen);
+	ssize_t sendFlush();
+	ssize_t chunkSend(size_t &lenBatch, size_t lenMax);
+	ssize_t sendCheck(ssize_t numBytes, uint32_t eventsSeen);
+	bool sendQueueFits(size_t len);
+	void queueAppend(const uint8_t *pData, size_t len);
+	void queueConsume(size_t len);
+	bool chunkFileRead();
+	void chunkRelease(TcpSendChunk &chunk);
+	bool zeroCopyEnable();
+	void zeroCopyCompletionsRead();
+	void statsUpdate(uint32_t curTimeMs);
+	bool sendPaced();
+	size_t tokensTake(bool isSend, size_t len, size_t lenMin = 1);
+	void tokensReturn(bool isSend, size_t len);
+	void pacingRateApply();
+	Success socketOptionsSet(bool tuningSet = true);
+	void reactorRegister();
+	bool uringPending();
+	void addrsInterleave();
+	Success connAttemptsCheck(uint32_t curTimeMs);
+	Success connAttemptStart(uint32_t curTimeMs);
+	void connAttemptClose(TcpConnAttempt &attempt);
+	Success connClientDone(SOCKET fd, int &numErr);
 	void addrInfoSet();
 	struct sockaddr_storage *addrStringToSock(const std::string &strAddr, uint16_t numPort);
 
@@ -186,21 +534,67 @@ private:
 	std::mutex mSocketFdMtx;
 #endif
 	SOCKET mSocketFd;
+	ReactorSlot mSlot;
+	UringSlot *mpUring;
 	std::string mHostAddrStr;
 	uint16_t mHostPort;
 	struct sockaddr_storage *mpHostAddr;
+	HostResolving *mpResolv;
+	std::vector<std::string> mAddrsHost;
+	size_t mIdxAddrHost;
+
+	// Connection attempts in parallel
+	TcpConnAttempt mAttempts[CONFIG_TCP_NUM_CONN_ATTEMPTS_MAX];
+	uint32_t mTmoConnMs;
+	uint32_t mDelayConnAttemptMs;
+	uint32_t mAttemptLastMs;
+
+	TcpSocketOptions mOpts;
 	int mErrno;
 	bool mInfoSet;
 	bool mIsIPv6Local;
 	bool mIsIPv6Remote;
 
+	// Received data in [mIdxRecvStart, mIdxRecvEnd)
+	std::vector<uint8_t> mBufRecv;
+	size_t mSizeBufRecv;
+	size_t mIdxRecvStart;
+	size_t mIdxRecvEnd;
+
+	// Unsent data. Starts at mIdxSendFront of the first chunk
+	std::deque<TcpSendChunk> mQueueSend;
+	size_t mIdxSendFront;
+	size_t mSizeQueueSend;
+	bool mCorked;
+
+	// Sent with MSG_ZEROCOPY. Kept until the kernel is done
+	std::deque<TcpSendChunk> mZeroCopyPending;
+	int mZeroCopyState;
+	uint32_t mIdZeroCopyNext;
+	uint32_t mIdZeroCopyDone;
+
 	// statistics
-	size_t mBytesReceived;
-	size_t mBytesSent;
+	TcpStats mStats;
+	uint32_t mStatsLastMs;
+	uint64_t mBytesReceivedLast;
+	uint64_t mBytesSentLast;
+
+	uint32_t mZeroCopySent;
+	uint32_t mZeroCopyCopied;
+	uint32_t mConnStartMs;
+	uint32_t mConnDurationMs;
+	uint32_t mConnAttempts;
+
+	// Rate limits. Group buckets are owned by the application
+	TokenBucket mBucketSend;
+	TokenBucket mBucketRecv;
+	TokenBucket *mpGroupSend;
+	TokenBucket *mpGroupRecv;
 
 	/* static functions */
 	static uint32_t millis();
 	static bool fileNonBlockingSet(SOCKET fd);
+	static bool intOptionSet(SOCKET fd, int level, int name, int val);
 #ifdef _WIN32
 	static void globalWsaDestruct();
 
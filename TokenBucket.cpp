@@ -0,0 +1,201 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <chrono>
+
+#include "TokenBucket.h"
+
+using namespace std;
+using namespace chrono;
+
+#define dUsPerSec			1000000ULL
+
+// Waiters which stopped asking lose their turn
+#define dTimeoutWaiterUs		100000ULL
+
+TokenBucket::TokenBucket()
+	: mRate(0)
+	, mBurst(0)
+	, mTokensUs(0)
+	, mLastUs(0)
+	, mpWaiter(NULL)
+	, mWaiterUs(0)
+	, mpTakerLast(NULL)
+{
+}
+
+TokenBucket::TokenBucket(uint64_t ratePerSec, uint64_t burst)
+	: mRate(0)
+	, mBurst(0)
+	, mTokensUs(0)
+	, mLastUs(0)
+	, mpWaiter(NULL)
+	, mWaiterUs(0)
+	, mpTakerLast(NULL)
+{
+	rateSet(ratePerSec, burst);
+}
+
+/* member functions */
+
+void TokenBucket::rateSet(uint64_t ratePerSec, uint64_t burst)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mMtx);
+#endif
+	if (!burst)
+		burst = ratePerSec / 10;
+
+	if (burst < CONFIG_RATE_SIZE_BURST_MIN)
+		burst = CONFIG_RATE_SIZE_BURST_MIN;
+
+	mRate = ratePerSec;
+	mBurst = burst;
+
+	mTokensUs = mBurst * dUsPerSec;
+	mLastUs = microsMono();
+
+	mpWaiter = NULL;
+	mpTakerLast = NULL;
+}
+
+uint64_t TokenBucket::rate()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mMtx);
+#endif
+	return mRate;
+}
+
+uint64_t TokenBucket::burst()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mMtx);
+#endif
+	return mBurst;
+}
+
+/*
+ * The waiter is the first user who found the bucket empty
+ * since the last turn. Others get nothing until the waiter
+ * has been served. Retries of the last taker don't wait
+ */
+size_t TokenBucket::tokensTake(size_t len, size_t lenMin, const void *pUser)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mMtx);
+#endif
+	if (!mRate)
+		return len;
+
+	refill();
+
+	uint64_t numTokens = mTokensUs / dUsPerSec;
+
+	if (lenMin > len)
+		lenMin = len;
+
+	if (mpWaiter && mLastUs - mWaiterUs > dTimeoutWaiterUs)
+		mpWaiter = NULL;
+
+	if (mpWaiter && pUser != mpWaiter)
+		return 0;
+
+	if (mpWaiter)
+		mWaiterUs = mLastUs;
+
+	if (numTokens < lenMin)
+	{
+		if (!mpWaiter && pUser != mpTakerLast)
+		{
+			mpWaiter = pUser;
+			mWaiterUs = mLastUs;
+		}
+
+		return 0;
+	}
+
+	mpWaiter = NULL;
+	mpTakerLast = pUser;
+
+	if (numTokens < len)
+		len = numTokens;
+
+	mTokensUs -= len * dUsPerSec;
+
+	return len;
+}
+
+// Unused tokens. E.g. after a short send
+void TokenBucket::tokensReturn(size_t len)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mMtx);
+#endif
+	if (!mRate || !len)
+		return;
+
+	mTokensUs += len * dUsPerSec;
+
+	if (mTokensUs > mBurst * dUsPerSec)
+		mTokensUs = mBurst * dUsPerSec;
+}
+
+/*
+ * Lock must be held by the caller
+ */
+void TokenBucket::refill()
+{
+	uint64_t curUs = microsMono();
+	uint64_t diffUs = curUs - mLastUs;
+	uint64_t tokensMaxUs = mBurst * dUsPerSec;
+
+	mLastUs = curUs;
+
+	// Also prevents overflows after long pauses
+	if (diffUs >= tokensMaxUs / mRate + 1)
+	{
+		mTokensUs = tokensMaxUs;
+		return;
+	}
+
+	mTokensUs += diffUs * mRate;
+
+	if (mTokensUs > tokensMaxUs)
+		mTokensUs = tokensMaxUs;
+}
+
+/* static functions */
+
+uint64_t TokenBucket::microsMono()
+{
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
@@ -0,0 +1,127 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Processing.h"
+
+// Smallest burst if none is given
+#ifndef CONFIG_RATE_SIZE_BURST_MIN
+#define CONFIG_RATE_SIZE_BURST_MIN		(16 * 1024)
+#endif
+
+/*
+ * Rate limiter for byte streams
+ * - Tokens are bytes. They are refilled continuously with
+ *   ratePerSec up to burst. The bucket starts full
+ * - Without burst a tenth of a second is used
+ * - One bucket can be shared by a group of transfers.
+ *   Access is locked. Users are served in turns. A user
+ *   waiting for tokens is served before the others
+ * - Rate 0 disables the limit
+ *
+Literature
+- https://en.wikipedia.org/wiki/Token_bucket
+*/
+class TokenBucket
+{
+
+public:
+
+	TokenBucket();
+	TokenBucket(uint64_t ratePerSec, uint64_t burst = 0);
+	virtual ~TokenBucket() {}
+
+	void rateSet(uint64_t ratePerSec, uint64_t burst = 0);
+	uint64_t rate();
+	uint64_t burst();
+
+	/*
+	 * Takes up to len tokens. Nothing is taken while
+	 * fewer than lenMin are available. The user is any
+	 * address identifying the caller in a group
+	 */
+	size_t tokensTake(size_t len, size_t lenMin = 1, const void *pUser = NULL);
+	void tokensReturn(size_t len);
+
+private:
+
+	TokenBucket(const TokenBucket &)
+		: mRate(0)
+		, mBurst(0)
+		, mTokensUs(0)
+		, mLastUs(0)
+		, mpWaiter(NULL)
+		, mWaiterUs(0)
+		, mpTakerLast(NULL)
+	{}
+	TokenBucket &operator=(const TokenBucket &)
+	{
+		mRate = 0;
+		mBurst = 0;
+		mTokensUs = 0;
+		mLastUs = 0;
+		mpWaiter = NULL;
+		mWaiterUs = 0;
+		mpTakerLast = NULL;
+
+		return *this;
+	}
+
+	/* member functions */
+	void refill();
+
+	/* member variables */
+#if CONFIG_PROC_HAVE_DRIVERS
+	std::mutex mMtx;
+#endif
+	uint64_t mRate;
+	uint64_t mBurst;
+
+	// Scaled by one million. Keeps fractions of slow rates
+	uint64_t mTokensUs;
+	uint64_t mLastUs;
+
+	// Turns of a group
+	const void *mpWaiter;
+	uint64_t mWaiterUs;
+	const void *mpTakerLast;
+
+	/* static functions */
+	static uint64_t microsMono();
+
+};
+
+#endif
+
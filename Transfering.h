@@ -28,6 +28,7 @@
 
 #include <string>
 #include <vector>
+#include <cstring>
 
 #include "Processing.h"
 
@@ -54,7 +55,36 @@ public:
 	 *   < 0 no data can be expected in the future
 	 */
 	virtual ssize_t read(void *pBuf, size_t lenReq) = 0;
-	Success exactRead(void *pBuf, size_t lenReq)
+
+	/*
+	 * Zero-copy access to received data
+	 * - peek() sets pData to the buffered bytes and returns
+	 *   their number like read(). The view is valid until the
+	 *   next call of read(), peek() or consume()
+	 * - With lenMin the transfer tries to buffer at least this
+	 *   many bytes. Fewer may be returned. If lenMin can't be
+	 *   reached anymore a negative value is returned
+	 * - consume() drops bytes from the front of the view
+	 * - Transfers without receive buffer return -1
+	 */
+	virtual ssize_t peek(const uint8_t *&pData, size_t lenMin = 1)
+	{
+		(void)lenMin;
+		pData = NULL;
+		return -1;
+	}
+
+	virtual bool peekSupported() const
+	{
+		return false;
+	}
+
+	virtual void consume(size_t len)
+	{
+		(void)len;
+	}
+
+	virtual Success exactRead(void *pBuf, size_t lenReq)
 	{
 		if (!lenReq)
 			return Positive;
@@ -62,16 +92,41 @@ public:
 		if (!pBuf)
 			return procErrLog(-1, "buffer not set");
 
-		ssize_t lenRead = read(pBuf, lenReq);
+		// Short reads are collected until the message is complete
+		size_t lenDone = mBufExact.size();
 
-		if (!lenRead)
-			return Pending;
+		if (lenDone > lenReq)
+		{
+			mBufExact.clear();
+			return procErrLog(-3, "requested length changed. Had %zu, got %zu", lenDone, lenReq);
+		}
+
+		mBufExact.resize(lenReq);
+
+		ssize_t lenRead;
 
-		if (lenRead < 0)
-			return -2;
+		while (lenDone < lenReq)
+		{
+			lenRead = read(&mBufExact[lenDone], lenReq - lenDone);
+			if (!lenRead)
+				break;
+
+			if (lenRead < 0)
+			{
+				mBufExact.clear();
+				return -2;
+			}
+
+			lenDone += lenRead;
+		}
+
+		mBufExact.resize(lenDone);
+
+		if (lenDone < lenReq)
+			return Pending;
 
-		if ((size_t)lenRead != lenReq)
-			return procErrLog(-3, "read data len does not match. Requested %d, got %d", lenReq, lenRead);
+		memcpy(pBuf, mBufExact.data(), lenReq);
+		mBufExact.clear();
 
 		return Positive;
 	}
@@ -97,6 +152,7 @@ protected:
 		, mAddrLocal(""), mPortLocal(0)
 		, mAddrRemote(""), mPortRemote(0)
 		, mDone(false)
+		, mBufExact()
 	{}
 	Transfering(const char *name)
 		: Processing(name)
@@ -104,6 +160,7 @@ protected:
 		, mAddrLocal(""), mPortLocal(0)
 		, mAddrRemote(""), mPortRemote(0)
 		, mDone(false)
+		, mBufExact()
 	{}
 	virtual ~Transfering() {}
 
@@ -122,6 +179,7 @@ private:
 		, mAddrLocal(""), mPortLocal(0)
 		, mAddrRemote(""), mPortRemote(0)
 		, mDone(false)
+		, mBufExact()
 	{}
 	Transfering &operator=(const Transfering &)
 	{
@@ -132,6 +190,7 @@ private:
 		mAddrRemote = "";
 		mPortRemote = 0;
 		mDone = false;
+		mBufExact.clear();
 
 		return *this;
 	}
@@ -144,6 +203,7 @@ private:
 	/* member functions */
 
 	/* member variables */
+	VecByte mBufExact;
 
 	/* static functions */
 
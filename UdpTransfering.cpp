@@ -0,0 +1,1070 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <netinet/udp.h>
+
+#include "UdpTransfering.h"
+#include "TcpTransfering.h"
+
+#define dForEach_ProcState(gen) \
+		gen(StStart) \
+		gen(StMain) \
+
+#define dGenProcStateEnum(s) s,
+dProcessStateEnum(ProcState);
+
+#if 0
+#define dGenProcStateString(s) #s,
+dProcessStateStr(ProcState);
+#endif
+
+using namespace std;
+
+#ifndef SOCK_CLOEXEC
+#define SOCK_CLOEXEC 0
+#endif
+
+#if defined(__linux__)
+#define dHaveMmsg			1
+#else
+#define dHaveMmsg			0
+#endif
+
+#if defined(__linux__) && defined(UDP_SEGMENT)
+#define dHaveGso			1
+#else
+#define dHaveGso			0
+#endif
+
+#if defined(__linux__) && defined(UDP_GRO)
+#define dHaveGro			1
+#else
+#define dHaveGro			0
+#endif
+
+#define dSizeDatagramMax		65507
+#define dSizeBufGro			65535
+// Fits into an Ethernet frame for IPv4 and IPv6
+#define dSizeSegmentMax			1452
+// UDP_MAX_SEGMENTS of the kernel
+#define dNumSegmentsMax			64
+#define dSizeCtrlRecv			(CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(uint32_t)))
+#define dSizeCtrlSend			CMSG_SPACE(sizeof(uint16_t))
+
+#if !dHaveMmsg
+struct mmsghdr
+{
+	struct msghdr msg_hdr;
+	unsigned int msg_len;
+};
+#endif
+
+/*
+ * Same semantics as recvmmsg() and sendmmsg().
+ * Other platforms move one datagram per system call
+ */
+static int mmsgRecv(SOCKET fd, struct mmsghdr *pMsgs, unsigned int numMsgs)
+{
+#if dHaveMmsg
+	return ::recvmmsg(fd, pMsgs, numMsgs, 0, NULL);
+#else
+	unsigned int i;
+	ssize_t res;
+
+	for (i = 0; i < numMsgs; ++i)
+	{
+		res = ::recvmsg(fd, &pMsgs[i].msg_hdr, 0);
+		if (res < 0)
+			break;
+
+		pMsgs[i].msg_len = (unsigned int)res;
+	}
+
+	return i ? (int)i : -1;
+#endif
+}
+
+static int mmsgSend(SOCKET fd, struct mmsghdr *pMsgs, unsigned int numMsgs)
+{
+#if dHaveMmsg
+	return ::sendmmsg(fd, pMsgs, numMsgs, 0);
+#else
+	unsigned int i;
+	ssize_t res;
+
+	for (i = 0; i < numMsgs; ++i)
+	{
+		res = ::sendmsg(fd, &pMsgs[i].msg_hdr, 0);
+		if (res < 0)
+			break;
+
+		pMsgs[i].msg_len = (unsigned int)res;
+	}
+
+	return i ? (int)i : -1;
+#endif
+}
+
+UdpTransfering::UdpTransfering()
+	: Transfering("UdpTransfering")
+#if CONFIG_PROC_HAVE_DRIVERS
+	, mSocketFdMtx()
+#endif
+	, mSocketFd(INVALID_SOCKET)
+	, mSlot()
+	, mFamily(0)
+	, mConnected(false)
+	, mGroups()
+	, mNumBatch(CONFIG_UDP_NUM_BATCH)
+	, mOffload(false)
+	, mGsoActive(false)
+	, mGroActive(false)
+	, mBufRecv()
+	, mDgRecv()
+	, mIdxDgRecv(0)
+	, mAddrPeer()
+	, mLenAddrPeer(0)
+	, mBufSend()
+	, mDgSend()
+	, mErrno(0)
+	, mDgReceived(0)
+	, mDgSent(0)
+	, mBytesReceived(0)
+	, mBytesSent(0)
+	, mCallsRecv(0)
+	, mCallsSend(0)
+	, mBatchRecvMax(0)
+	, mBatchSendMax(0)
+	, mDropsKernel(0)
+	, mDropsTruncated(0)
+	, mDropsSend(0)
+{
+	mState = StStart;
+}
+
+/* member functions */
+
+/*
+ * Setters must be used before the process is started.
+ * Only multicast groups can be joined later
+ */
+void UdpTransfering::localSet(uint16_t port, const string &addr)
+{
+	mPortLocal = port;
+	mAddrLocal = addr;
+}
+
+void UdpTransfering::remoteSet(const string &addr, uint16_t port)
+{
+	mAddrRemote = addr;
+	mPortRemote = port;
+	mConnected = true;
+}
+
+void UdpTransfering::multicastJoin(const string &group, const string &iface)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	mGroups.push_back(make_pair(group, iface));
+
+	if (mSocketFd == INVALID_SOCKET)
+		return;
+
+	if (!groupJoin(group, iface))
+		procWrnLog("could not join multicast group '%s': %s",
+					group.c_str(), errnoToStr(errno).c_str());
+}
+
+void UdpTransfering::batchSizeSet(size_t numDatagrams)
+{
+	if (!numDatagrams)
+		numDatagrams = 1;
+
+	if (numDatagrams > CONFIG_UDP_NUM_BATCH)
+		numDatagrams = CONFIG_UDP_NUM_BATCH;
+
+	mNumBatch = numDatagrams;
+}
+
+void UdpTransfering::offloadSet(bool enable)
+{
+	mOffload = enable;
+}
+
+uint16_t UdpTransfering::portLocal() const
+{
+	return mPortLocal;
+}
+
+Success UdpTransfering::process()
+{
+	Success success;
+#if 0
+	dStateTrace;
+#endif
+	switch (mState)
+	{
+	case StStart:
+
+		success = socketCreate();
+		if (success != Positive)
+			return success;
+
+		mState = StMain;
+
+		break;
+	case StMain:
+
+		if (mDone)
+			return Positive;
+
+		Reactor::eventsUpdate(mSlot);
+
+		if (mSocketFd == INVALID_SOCKET)
+		{
+			if (mErrno)
+				return procErrLog(-1, "socket error occured: %s",
+								errnoToStr(mErrno).c_str());
+
+			return Positive;
+		}
+
+		// Datagrams queued during the last tick
+		flush();
+
+		break;
+	default:
+		break;
+	}
+
+	return Pending;
+}
+
+Success UdpTransfering::shutdown()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	if (mDgSend.size())
+		batchSend();
+
+	if (mDgSend.size())
+		procWrnLog("dropping %zu queued datagrams", mDgSend.size());
+
+	disconnect();
+
+	return Positive;
+}
+
+Success UdpTransfering::socketCreate()
+{
+	struct sockaddr_storage addrLocal, addrRemote, addrGroup;
+	socklen_t lenLocal = 0, lenRemote = 0, lenAddr;
+	int family = AF_INET6;
+	bool isIPv6;
+	int opt, res;
+
+	if (mConnected)
+	{
+		lenRemote = addrParse(mAddrRemote, mPortRemote, addrRemote);
+		if (!lenRemote)
+			return procErrLog(-1, "invalid remote address '%s'", mAddrRemote.c_str());
+
+		family = addrRemote.ss_family;
+	}
+
+	if (mAddrLocal.size())
+	{
+		lenLocal = addrParse(mAddrLocal, mPortLocal, addrLocal);
+		if (!lenLocal)
+			return procErrLog(-1, "invalid local address '%s'", mAddrLocal.c_str());
+
+		if (mConnected && addrLocal.ss_family != family)
+			return procErrLog(-1, "address families of local and remote address differ");
+
+		family = addrLocal.ss_family;
+	}
+	else
+	if (!mConnected && mGroups.size() &&
+			addrParse(mGroups.front().first, 0, addrGroup))
+		family = addrGroup.ss_family;
+
+	if (!lenLocal)
+		lenLocal = addrParse(family == AF_INET ? "0.0.0.0" : "::", mPortLocal, addrLocal);
+
+	mSocketFd = ::socket(family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (mSocketFd == INVALID_SOCKET)
+		return procErrLog(-1, "could not create socket: %s",
+						errnoToStr(errno).c_str());
+
+	mFamily = family;
+
+	if (!fileNonBlockingSet(mSocketFd))
+		return procErrLog(-1, "could not set non blocking mode: %s",
+						errnoToStr(errno).c_str());
+
+	// Dual stack for wildcard addresses
+	opt = 0;
+	if (family == AF_INET6)
+		::setsockopt(mSocketFd, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt));
+
+	// Multiple receivers of the same group on this host
+	opt = 1;
+	if (mGroups.size())
+		::setsockopt(mSocketFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+	res = ::bind(mSocketFd, (struct sockaddr *)&addrLocal, lenLocal);
+	if (res)
+		return procErrLog(-1, "could not bind to port %u: %s",
+						mPortLocal, errnoToStr(errno).c_str());
+
+	lenAddr = sizeof(addrLocal);
+	if (!::getsockname(mSocketFd, (struct sockaddr *)&addrLocal, &lenAddr))
+		TcpTransfering::sockaddrInfoGet(addrLocal, mAddrLocal, mPortLocal, isIPv6);
+
+	if (mConnected)
+	{
+		res = ::connect(mSocketFd, (struct sockaddr *)&addrRemote, lenRemote);
+		if (res)
+			return procErrLog(-1, "could not connect to %s:%u: %s",
+							mAddrRemote.c_str(), mPortRemote,
+							errnoToStr(errno).c_str());
+	}
+
+	list<pair<string, string> >::iterator iter;
+
+	for (iter = mGroups.begin(); iter != mGroups.end(); ++iter)
+	{
+		if (groupJoin(iter->first, iter->second))
+			continue;
+
+		return procErrLog(-1, "could not join multicast group '%s': %s",
+						iter->first.c_str(), errnoToStr(errno).c_str());
+	}
+#ifdef SO_RXQ_OVFL
+	// Drops of the kernel are reported with each datagram
+	opt = 1;
+	::setsockopt(mSocketFd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt));
+#endif
+	if (mOffload)
+	{
+		opt = 0;
+#if dHaveGso
+		// Only probed. Segment sizes are given per message
+		mGsoActive = !::setsockopt(mSocketFd, IPPROTO_UDP, UDP_SEGMENT, &opt, sizeof(opt));
+#endif
+		opt = 1;
+#if dHaveGro
+		mGroActive = !::setsockopt(mSocketFd, IPPROTO_UDP, UDP_GRO, &opt, sizeof(opt));
+#endif
+		if (!mGsoActive || !mGroActive)
+			procWrnLog("segmentation offload not fully supported");
+	}
+
+	// Coalesced datagrams of GRO need the maximum size
+	mBufRecv.resize(mNumBatch * (mGroActive ? dSizeBufGro : CONFIG_UDP_SIZE_DATAGRAM_MAX));
+
+	Reactor::slotAdd(mSlot, mSocketFd, RevRead | RevWrite);
+
+	mReadReady = true;
+	mSendReady = true;
+
+	return Positive;
+}
+
+/*
+Literature
+- https://man7.org/linux/man-pages/man7/ip.7.html
+- https://man7.org/linux/man-pages/man7/ipv6.7.html
+- https://man7.org/linux/man-pages/man3/if_nametoindex.3.html
+*/
+bool UdpTransfering::groupJoin(const string &group, const string &iface)
+{
+	struct sockaddr_storage addr;
+	unsigned int idxIf = 0;
+
+	if (!addrParse(group, 0, addr))
+	{
+		errno = EINVAL;
+		return false;
+	}
+
+	if (iface.size())
+	{
+		idxIf = ::if_nametoindex(iface.c_str());
+		if (!idxIf)
+			return false;
+	}
+
+	if (addr.ss_family == AF_INET)
+	{
+#if defined(__linux__)
+		struct ip_mreqn req;
+
+		memset(&req, 0, sizeof(req));
+		req.imr_multiaddr = ((struct sockaddr_in *)&addr)->sin_addr;
+		req.imr_address.s_addr = htonl(INADDR_ANY);
+		req.imr_ifindex = idxIf;
+#else
+		// Interface is chosen by the routing table
+		struct ip_mreq req;
+
+		memset(&req, 0, sizeof(req));
+		req.imr_multiaddr = ((struct sockaddr_in *)&addr)->sin_addr;
+		req.imr_interface.s_addr = htonl(INADDR_ANY);
+#endif
+		return !::setsockopt(mSocketFd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &req, sizeof(req));
+	}
+
+	struct ipv6_mreq req;
+
+	memset(&req, 0, sizeof(req));
+	req.ipv6mr_multiaddr = ((struct sockaddr_in6 *)&addr)->sin6_addr;
+	req.ipv6mr_interface = idxIf;
+
+	return !::setsockopt(mSocketFd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &req, sizeof(req));
+}
+
+ssize_t UdpTransfering::read(void *pBuf, size_t lenReq)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	if (!mReadReady)
+		return 0;
+
+	if (mSocketFd == INVALID_SOCKET)
+		return -1;
+
+	if (!pBuf || !lenReq)
+		return 0;
+
+	ssize_t res;
+
+	if (mIdxDgRecv == mDgRecv.size())
+	{
+		mDgRecv.clear();
+		mIdxDgRecv = 0;
+
+		res = batchRecv();
+		if (res <= 0)
+			return res;
+
+		if (mDgRecv.empty())
+			return 0;
+	}
+
+	UdpDatagram &dg = mDgRecv[mIdxDgRecv++];
+	bool isIPv6;
+
+	if (dg.lenAddr != mLenAddrPeer || memcmp(&dg.addr, &mAddrPeer, dg.lenAddr))
+	{
+		memcpy(&mAddrPeer, &dg.addr, dg.lenAddr);
+		mLenAddrPeer = dg.lenAddr;
+
+		if (!mConnected)
+			TcpTransfering::sockaddrInfoGet(mAddrPeer, mAddrRemote, mPortRemote, isIPv6);
+	}
+
+	if (lenReq > dg.len)
+		lenReq = dg.len;
+
+	memcpy(pBuf, &mBufRecv[dg.idx], lenReq);
+
+	return lenReq;
+}
+
+/*
+ * Lock must be held by the caller
+ */
+ssize_t UdpTransfering::batchRecv()
+{
+	uint32_t eventsSeen = mSlot.eventsReady;
+
+	if (!(eventsSeen & (RevRead | RevHangUp | RevError)))
+		return 0;
+
+	struct mmsghdr msgs[CONFIG_UDP_NUM_BATCH];
+	struct iovec iovs[CONFIG_UDP_NUM_BATCH];
+	struct sockaddr_storage addrs[CONFIG_UDP_NUM_BATCH];
+	union
+	{
+		char buf[dSizeCtrlRecv];
+		struct cmsghdr align;
+	} ctrls[CONFIG_UDP_NUM_BATCH];
+	size_t sizeSlot = mBufRecv.size() / mNumBatch;
+	int numMsgs, numErr;
+
+	memset(msgs, 0, mNumBatch * sizeof(msgs[0]));
+
+	for (size_t i = 0; i < mNumBatch; ++i)
+	{
+		iovs[i].iov_base = &mBufRecv[i * sizeSlot];
+		iovs[i].iov_len = sizeSlot;
+
+		msgs[i].msg_hdr.msg_name = &addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = ctrls[i].buf;
+		msgs[i].msg_hdr.msg_controllen = sizeof(ctrls[i].buf);
+	}
+
+	numMsgs = mmsgRecv(mSocketFd, msgs, mNumBatch);
+	if (numMsgs < 0)
+	{
+		numErr = errno;
+
+		if (numErr == EWOULDBLOCK || numErr == EAGAIN)
+		{
+			Reactor::eventsClear(mSlot, RevRead, eventsSeen);
+			return 0; // std case and ok
+		}
+
+		if (numErr == EINTR)
+			return 0;
+
+		// ICMP error of a previous datagram. Socket stays usable
+		if (numErr == ECONNREFUSED)
+		{
+			procDbgLog("port unreachable");
+			return 0;
+		}
+
+		disconnect(numErr);
+
+		return procErrLog(-3, "recvmmsg() failed: %s", errnoToStr(numErr).c_str());
+	}
+
+	// Queue of the socket drained
+	if ((size_t)numMsgs < mNumBatch)
+		Reactor::eventsClear(mSlot, RevRead, eventsSeen);
+
+	++mCallsRecv;
+
+	size_t numBefore = mDgRecv.size();
+
+	for (int i = 0; i < numMsgs; ++i)
+	{
+		if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+		{
+			++mDropsTruncated;
+			continue;
+		}
+
+		mBytesReceived += msgs[i].msg_len;
+		datagramsSplit(msgs[i].msg_hdr, i * sizeSlot, msgs[i].msg_len);
+	}
+
+	size_t numDgs = mDgRecv.size() - numBefore;
+
+	mDgReceived += numDgs;
+
+	if (numDgs > mBatchRecvMax)
+		mBatchRecvMax = numDgs;
+
+	return numDgs;
+}
+
+/*
+ * Buffers coalesced by GRO contain multiple datagrams
+ * of the segment size. Only the last one may be shorter
+ */
+void UdpTransfering::datagramsSplit(struct msghdr &msg, size_t idxSlot, size_t len)
+{
+	struct cmsghdr *pCmsg;
+	size_t sizeSeg = len;
+	uint32_t numDrops;
+	int val;
+
+	for (pCmsg = CMSG_FIRSTHDR(&msg); pCmsg; pCmsg = CMSG_NXTHDR(&msg, pCmsg))
+	{
+#ifdef SO_RXQ_OVFL
+		if (pCmsg->cmsg_level == SOL_SOCKET && pCmsg->cmsg_type == SO_RXQ_OVFL)
+		{
+			// Counter of the socket. Not per message
+			memcpy(&numDrops, CMSG_DATA(pCmsg), sizeof(numDrops));
+			mDropsKernel = numDrops;
+			continue;
+		}
+#else
+		(void)numDrops;
+#endif
+#if dHaveGro
+		if (pCmsg->cmsg_level == IPPROTO_UDP && pCmsg->cmsg_type == UDP_GRO)
+		{
+			memcpy(&val, CMSG_DATA(pCmsg), sizeof(val));
+			if (val > 0)
+				sizeSeg = val;
+			continue;
+		}
+#else
+		(void)val;
+#endif
+	}
+
+	UdpDatagram dg;
+	size_t idx;
+
+	memcpy(&dg.addr, msg.msg_name, msg.msg_namelen);
+	dg.lenAddr = msg.msg_namelen;
+
+	for (idx = 0; idx < len; idx += sizeSeg)
+	{
+		dg.idx = idxSlot + idx;
+		dg.len = len - idx < sizeSeg ? len - idx : sizeSeg;
+
+		mDgRecv.push_back(dg);
+	}
+}
+
+ssize_t UdpTransfering::send(const void *pData, size_t lenReq)
+{
+	if (!mSendReady)
+		return procErrLog(-1, "unable to send data. Not ready");
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	// No error message here. See TcpTransfering::send()
+	if (mSocketFd == INVALID_SOCKET)
+		return -1;
+
+	if (mConnected)
+		return datagramQueue(pData, lenReq, NULL, 0);
+
+	if (!mLenAddrPeer)
+		return procErrLog(-2, "no peer known yet. Use sendTo()");
+
+	return datagramQueue(pData, lenReq, &mAddrPeer, mLenAddrPeer);
+}
+
+ssize_t UdpTransfering::sendTo(const void *pData, size_t lenReq,
+					const string &addr, uint16_t port)
+{
+	if (!mSendReady)
+		return procErrLog(-1, "unable to send data. Not ready");
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	if (mSocketFd == INVALID_SOCKET)
+		return -1;
+
+	struct sockaddr_storage addrDest;
+	socklen_t lenAddr;
+
+	lenAddr = addrParse(addr, port, addrDest);
+	if (!lenAddr)
+		return procErrLog(-2, "invalid address '%s'", addr.c_str());
+
+	// Dual stack sockets need IPv4-mapped addresses
+	if (mFamily == AF_INET6 && addrDest.ss_family == AF_INET)
+	{
+		lenAddr = addrParse("::ffff:" + addr, port, addrDest);
+		if (!lenAddr)
+			return procErrLog(-2, "invalid address '%s'", addr.c_str());
+	}
+
+	return datagramQueue(pData, lenReq, &addrDest, lenAddr);
+}
+
+ssize_t UdpTransfering::flush()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	if (mSocketFd == INVALID_SOCKET)
+		return -1;
+
+	if (!mDgSend.size())
+		return 0;
+
+	return batchSend();
+}
+
+/*
+ * Lock must be held by the caller
+ */
+ssize_t UdpTransfering::datagramQueue(const void *pData, size_t lenReq,
+					const struct sockaddr_storage *pAddr, socklen_t lenAddr)
+{
+	if (!pData || !lenReq)
+		return 0;
+
+	if (lenReq > dSizeDatagramMax)
+		return procErrLog(-3, "datagram too large: %zu bytes", lenReq);
+
+	size_t numQueueMax = mNumBatch;
+
+	if (mGsoActive)
+		numQueueMax *= dNumSegmentsMax;
+
+	if (mDgSend.size() >= numQueueMax)
+		batchSend();
+
+	if (mDgSend.size() >= numQueueMax)
+		return 0;
+
+	UdpDatagram dg;
+
+	dg.idx = mBufSend.size();
+	dg.len = lenReq;
+	dg.lenAddr = lenAddr;
+
+	if (pAddr)
+		memcpy(&dg.addr, pAddr, lenAddr);
+
+	mBufSend.insert(mBufSend.end(), (const uint8_t *)pData, (const uint8_t *)pData + lenReq);
+	mDgSend.push_back(dg);
+
+	return lenReq;
+}
+
+/*
+ * Lock must be held by the caller.
+ * Returns the number of datagrams sent
+ */
+ssize_t UdpTransfering::batchSend()
+{
+	uint32_t eventsSeen = mSlot.eventsReady;
+
+	if (!(eventsSeen & RevWrite))
+		return 0;
+
+	struct mmsghdr msgs[CONFIG_UDP_NUM_BATCH];
+	struct iovec iovs[CONFIG_UDP_NUM_BATCH];
+	union
+	{
+		char buf[dSizeCtrlSend];
+		struct cmsghdr align;
+	} ctrls[CONFIG_UDP_NUM_BATCH];
+	size_t numSegsMsg[CONFIG_UDP_NUM_BATCH];
+	size_t idxDg = 0, idxStart, numMsgs, numSegs, numDgs;
+	size_t numDgsSent = 0;
+	struct cmsghdr *pCmsg;
+	uint16_t sizeSeg;
+	int res, numErr;
+
+	while (idxDg < mDgSend.size())
+	{
+		idxStart = idxDg;
+		numMsgs = 0;
+
+		memset(msgs, 0, mNumBatch * sizeof(msgs[0]));
+
+		for (; numMsgs < mNumBatch && idxDg < mDgSend.size(); ++numMsgs)
+		{
+			UdpDatagram &dg = mDgSend[idxDg];
+
+			numSegs = groupSegmentsCount(idxDg);
+			UdpDatagram &dgLast = mDgSend[idxDg + numSegs - 1];
+
+			iovs[numMsgs].iov_base = &mBufSend[dg.idx];
+			iovs[numMsgs].iov_len = dgLast.idx + dgLast.len - dg.idx;
+
+			struct msghdr &msg = msgs[numMsgs].msg_hdr;
+
+			msg.msg_name = dg.lenAddr ? &dg.addr : NULL;
+			msg.msg_namelen = dg.lenAddr;
+			msg.msg_iov = &iovs[numMsgs];
+			msg.msg_iovlen = 1;
+#if dHaveGso
+			if (numSegs > 1)
+			{
+				memset(ctrls[numMsgs].buf, 0, sizeof(ctrls[numMsgs].buf));
+				msg.msg_control = ctrls[numMsgs].buf;
+				msg.msg_controllen = sizeof(ctrls[numMsgs].buf);
+
+				sizeSeg = (uint16_t)dg.len;
+
+				pCmsg = CMSG_FIRSTHDR(&msg);
+				pCmsg->cmsg_level = IPPROTO_UDP;
+				pCmsg->cmsg_type = UDP_SEGMENT;
+				pCmsg->cmsg_len = CMSG_LEN(sizeof(sizeSeg));
+				memcpy(CMSG_DATA(pCmsg), &sizeSeg, sizeof(sizeSeg));
+			}
+#else
+			(void)ctrls;
+			(void)pCmsg;
+			(void)sizeSeg;
+#endif
+			numSegsMsg[numMsgs] = numSegs;
+			idxDg += numSegs;
+		}
+
+		res = mmsgSend(mSocketFd, msgs, numMsgs);
+		if (res < 0)
+		{
+			numErr = errno;
+			idxDg = idxStart;
+
+			// Writable again on next edge. ENOBUFS raises none and drops
+			if (numErr == EWOULDBLOCK || numErr == EAGAIN)
+			{
+				Reactor::eventsClear(mSlot, RevWrite, eventsSeen);
+				break;
+			}
+
+			if (numErr == EINTR)
+				break;
+
+			// Device can't segment. Send the datagrams separately
+			if (mGsoActive && numSegsMsg[0] > 1 &&
+					(numErr == EIO || numErr == EINVAL))
+			{
+				procWrnLog("segmentation offload failed: %s",
+							errnoToStr(numErr).c_str());
+				mGsoActive = false;
+				continue;
+			}
+
+			// Datagram is lost. Others are still sent
+			procDbgLog("could not send datagram: %s", errnoToStr(numErr).c_str());
+
+			mDropsSend += numSegsMsg[0];
+			idxDg = idxStart + numSegsMsg[0];
+
+			continue;
+		}
+
+		++mCallsSend;
+
+		idxDg = idxStart;
+		numDgs = 0;
+
+		for (int i = 0; i < res; ++i)
+		{
+			idxDg += numSegsMsg[i];
+			numDgs += numSegsMsg[i];
+			mBytesSent += msgs[i].msg_len;
+		}
+
+		numDgsSent += numDgs;
+
+		if (numDgs > mBatchSendMax)
+			mBatchSendMax = numDgs;
+
+		if ((size_t)res < numMsgs)
+			break;
+	}
+
+	mDgSent += numDgsSent;
+
+	if (idxDg == mDgSend.size())
+	{
+		mBufSend.clear();
+		mDgSend.clear();
+
+		return numDgsSent;
+	}
+
+	size_t lenDone = mDgSend[idxDg].idx;
+
+	mBufSend.erase(mBufSend.begin(), mBufSend.begin() + lenDone);
+	mDgSend.erase(mDgSend.begin(), mDgSend.begin() + idxDg);
+
+	for (size_t i = 0; i < mDgSend.size(); ++i)
+		mDgSend[i].idx -= lenDone;
+
+	return numDgsSent;
+}
+
+/*
+ * Number of queued datagrams starting at idxDg which
+ * can be sent as one buffer with UDP_SEGMENT
+ */
+size_t UdpTransfering::groupSegmentsCount(size_t idxDg)
+{
+	UdpDatagram &dg = mDgSend[idxDg];
+	size_t numSegs = 1;
+	size_t lenSum = dg.len;
+	size_t i;
+
+	if (!mGsoActive || dg.len > dSizeSegmentMax)
+		return 1;
+
+	for (i = idxDg + 1; i < mDgSend.size() && numSegs < dNumSegmentsMax; ++i)
+	{
+		UdpDatagram &dgNext = mDgSend[i];
+
+		if (dgNext.lenAddr != dg.lenAddr || memcmp(&dgNext.addr, &dg.addr, dg.lenAddr))
+			break;
+
+		if (dgNext.len > dg.len || lenSum + dgNext.len > dSizeDatagramMax)
+			break;
+
+		lenSum += dgNext.len;
+		++numSegs;
+
+		// Only the last segment may be shorter
+		if (dgNext.len < dg.len)
+			break;
+	}
+
+	return numSegs;
+}
+
+void UdpTransfering::disconnect(int err)
+{
+	// every caller must lock in advance!
+	if (mSocketFd == INVALID_SOCKET)
+		return;
+
+	mErrno = err;
+
+	Reactor::slotRemove(mSlot);
+	::close(mSocketFd);
+	mSocketFd = INVALID_SOCKET;
+
+	mBufSend.clear();
+	mDgSend.clear();
+}
+
+string UdpTransfering::errnoToStr(int num)
+{
+	char buf[64];
+	size_t len = sizeof(buf) - 1;
+	char *pBuf;
+
+	buf[0] = 0;
+	buf[len] = 0;
+
+#if defined(__FreeBSD__) || defined(__APPLE__)
+	int res;
+
+	pBuf = buf;
+	res = ::strerror_r(num, buf, len);
+	if (res)
+		*pBuf = 0;
+#else
+	pBuf = ::strerror_r(num, buf, len);
+#endif
+	return string(pBuf);
+}
+
+void UdpTransfering::processInfo(char *pBuf, char *pBufEnd)
+{
+	bool isIPv6 = mAddrLocal.find(':') != string::npos;
+
+	dInfo("Local\t\t\t%s%s%s:%u\n",
+			isIPv6 ? "[" : "",
+			mAddrLocal.c_str(),
+			isIPv6 ? "]" : "",
+			mPortLocal);
+
+	isIPv6 = mAddrRemote.find(':') != string::npos;
+
+	if (mConnected || mLenAddrPeer)
+		dInfo("%s\t\t\t%s%s%s:%u\n",
+				mConnected ? "Remote" : "Peer",
+				isIPv6 ? "[" : "",
+				mAddrRemote.c_str(),
+				isIPv6 ? "]" : "",
+				mPortRemote);
+
+	list<pair<string, string> >::const_iterator iter;
+
+	for (iter = mGroups.begin(); iter != mGroups.end(); ++iter)
+		dInfo("Multicast group\t\t%s\n", iter->first.c_str());
+
+	if (mOffload)
+		dInfo("Offload\t\t\tGSO %s, GRO %s\n",
+				mGsoActive ? "on" : "off",
+				mGroActive ? "on" : "off");
+
+	dInfo("Datagrams received\t%zu (%zu bytes)\n", mDgReceived, mBytesReceived);
+	dInfo("Datagrams sent\t\t%zu (%zu bytes)\n", mDgSent, mBytesSent);
+	dInfo("Datagrams queued\t%zu\n", mDgSend.size());
+	dInfo("Batch receive\t\tavg %zu, max %zu\n",
+			mCallsRecv ? mDgReceived / mCallsRecv : 0, mBatchRecvMax);
+	dInfo("Batch send\t\tavg %zu, max %zu\n",
+			mCallsSend ? mDgSent / mCallsSend : 0, mBatchSendMax);
+	dInfo("Drops\t\t\tkernel %u, truncated %zu, send %zu\n",
+			mDropsKernel, mDropsTruncated, mDropsSend);
+}
+
+/* static functions */
+
+/*
+ * Returns the length of the address or 0 on error
+ */
+socklen_t UdpTransfering::addrParse(const string &strAddr, uint16_t port,
+					struct sockaddr_storage &addr)
+{
+	struct sockaddr_in *pAddr4 = (struct sockaddr_in *)&addr;
+	struct sockaddr_in6 *pAddr6 = (struct sockaddr_in6 *)&addr;
+
+	memset(&addr, 0, sizeof(addr));
+
+	if (inet_pton(AF_INET, strAddr.c_str(), &pAddr4->sin_addr) == 1)
+	{
+		pAddr4->sin_family = AF_INET;
+		pAddr4->sin_port = htons(port);
+
+		return sizeof(*pAddr4);
+	}
+
+	if (inet_pton(AF_INET6, strAddr.c_str(), &pAddr6->sin6_addr) == 1)
+	{
+		pAddr6->sin6_family = AF_INET6;
+		pAddr6->sin6_port = htons(port);
+
+		return sizeof(*pAddr6);
+	}
+
+	return 0;
+}
+
+bool UdpTransfering::fileNonBlockingSet(SOCKET fd)
+{
+	int opt;
+
+	opt = fcntl(fd, F_GETFL, 0);
+	if (opt == -1)
+		return false;
+
+	if (opt & O_NONBLOCK)
+		return true;
+
+	opt |= O_NONBLOCK;
+
+	opt = fcntl(fd, F_SETFL, opt);
+	if (opt == -1)
+		return false;
+
+	return true;
+}
+
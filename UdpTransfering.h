@@ -0,0 +1,272 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef UDP_TRANSFERING_H
+#define UDP_TRANSFERING_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#ifndef SOCKET
+#define SOCKET int
+#define INVALID_SOCKET -1
+#endif
+
+#include "Transfering.h"
+#include "Reactor.h"
+
+// Datagrams moved per system call
+#ifndef CONFIG_UDP_NUM_BATCH
+#define CONFIG_UDP_NUM_BATCH			16
+#endif
+
+// Larger datagrams are truncated and counted as dropped
+#ifndef CONFIG_UDP_SIZE_DATAGRAM_MAX
+#define CONFIG_UDP_SIZE_DATAGRAM_MAX		2048
+#endif
+
+struct UdpDatagram
+{
+	size_t idx;
+	size_t len;
+	struct sockaddr_storage addr;
+	socklen_t lenAddr;
+};
+
+/*
+ * Datagram transfer. POSIX only
+ * - Bind mode: localSet(). Datagrams of any peer are
+ *   received. send() replies to the sender of the last
+ *   datagram read, sendTo() to any address
+ * - Connect mode: remoteSet(). Only datagrams of the remote
+ *   peer are received. Both modes can be combined
+ * - read() returns one datagram per call. Remaining bytes of
+ *   datagrams larger than the buffer are discarded
+ * - Datagrams are moved in batches with recvmmsg() and
+ *   sendmmsg() on Linux. Sent datagrams are queued and
+ *   flushed once per tick, by flush() or by a full batch
+ * - offloadSet() enables UDP_SEGMENT and UDP_GRO where
+ *   available. Equal sized datagrams to the same peer are
+ *   then handed to the kernel as one buffer
+ * - Addresses must be numeric. Use HostResolving for names
+ *
+Literature
+- https://man7.org/linux/man-pages/man7/udp.7.html
+- https://man7.org/linux/man-pages/man2/recvmmsg.2.html
+- https://man7.org/linux/man-pages/man2/sendmmsg.2.html
+- https://man7.org/linux/man-pages/man7/ip.7.html
+  - IP_ADD_MEMBERSHIP
+- https://man7.org/linux/man-pages/man7/ipv6.7.html
+  - IPV6_ADD_MEMBERSHIP
+- https://blog.cloudflare.com/accelerating-udp-packet-transmission-for-quic/
+- https://lwn.net/Articles/768995/
+  - UDP GRO
+*/
+class UdpTransfering : public Transfering
+{
+
+public:
+
+	static UdpTransfering *create()
+	{
+		return new (std::nothrow) UdpTransfering;
+	}
+
+	void localSet(uint16_t port, const std::string &addr = "");
+	void remoteSet(const std::string &addr, uint16_t port);
+	void multicastJoin(const std::string &group, const std::string &iface = "");
+	void batchSizeSet(size_t numDatagrams);
+	void offloadSet(bool enable);
+
+	using Transfering::send;
+
+	ssize_t read(void *pBuf, size_t lenReq);
+	ssize_t send(const void *pData, size_t lenReq);
+	ssize_t sendTo(const void *pData, size_t lenReq,
+					const std::string &addr, uint16_t port);
+	ssize_t flush();
+
+	uint16_t portLocal() const;
+
+protected:
+
+	virtual ~UdpTransfering() {}
+
+private:
+
+	UdpTransfering();
+	UdpTransfering(const UdpTransfering &)
+		: Transfering("")
+#if CONFIG_PROC_HAVE_DRIVERS
+		, mSocketFdMtx()
+#endif
+		, mSocketFd(INVALID_SOCKET)
+		, mSlot()
+		, mFamily(0)
+		, mConnected(false)
+		, mGroups()
+		, mNumBatch(0)
+		, mOffload(false)
+		, mGsoActive(false)
+		, mGroActive(false)
+		, mBufRecv()
+		, mDgRecv()
+		, mIdxDgRecv(0)
+		, mAddrPeer()
+		, mLenAddrPeer(0)
+		, mBufSend()
+		, mDgSend()
+		, mErrno(0)
+		, mDgReceived(0)
+		, mDgSent(0)
+		, mBytesReceived(0)
+		, mBytesSent(0)
+		, mCallsRecv(0)
+		, mCallsSend(0)
+		, mBatchRecvMax(0)
+		, mBatchSendMax(0)
+		, mDropsKernel(0)
+		, mDropsTruncated(0)
+		, mDropsSend(0)
+	{
+		mState = 0;
+	}
+	UdpTransfering &operator=(const UdpTransfering &)
+	{
+		mSocketFd = INVALID_SOCKET;
+		mSlot = ReactorSlot();
+		mFamily = 0;
+		mConnected = false;
+		mGroups.clear();
+		mNumBatch = 0;
+		mOffload = false;
+		mGsoActive = false;
+		mGroActive = false;
+		mBufRecv.clear();
+		mDgRecv.clear();
+		mIdxDgRecv = 0;
+		mLenAddrPeer = 0;
+		mBufSend.clear();
+		mDgSend.clear();
+		mErrno = 0;
+		mDgReceived = 0;
+		mDgSent = 0;
+		mBytesReceived = 0;
+		mBytesSent = 0;
+		mCallsRecv = 0;
+		mCallsSend = 0;
+		mBatchRecvMax = 0;
+		mBatchSendMax = 0;
+		mDropsKernel = 0;
+		mDropsTruncated = 0;
+		mDropsSend = 0;
+
+		mState = 0;
+
+		return *this;
+	}
+
+	/*
+	 * Naming of functions:  objectVerb()
+	 * Example:              peerAdd()
+	 */
+
+	/* member functions */
+	Success process();
+	Success shutdown();
+
+	Success socketCreate();
+	bool groupJoin(const std::string &group, const std::string &iface);
+	ssize_t batchRecv();
+	void datagramsSplit(struct msghdr &msg, size_t idxSlot, size_t len);
+	ssize_t datagramQueue(const void *pData, size_t lenReq,
+					const struct sockaddr_storage *pAddr, socklen_t lenAddr);
+	ssize_t batchSend();
+	size_t groupSegmentsCount(size_t idxDg);
+	void disconnect(int err = 0);
+	std::string errnoToStr(int num);
+	void processInfo(char *pBuf, char *pBufEnd);
+
+	/* member variables */
+#if CONFIG_PROC_HAVE_DRIVERS
+	std::mutex mSocketFdMtx;
+#endif
+	SOCKET mSocketFd;
+	ReactorSlot mSlot;
+	int mFamily;
+	bool mConnected;
+	std::list<std::pair<std::string, std::string> > mGroups;
+	size_t mNumBatch;
+	bool mOffload;
+	bool mGsoActive;
+	bool mGroActive;
+
+	// One slot per datagram of a batch
+	VecByte mBufRecv;
+	std::vector<UdpDatagram> mDgRecv;
+	size_t mIdxDgRecv;
+	struct sockaddr_storage mAddrPeer;
+	socklen_t mLenAddrPeer;
+
+	// Queued datagrams are stored back to back
+	VecByte mBufSend;
+	std::vector<UdpDatagram> mDgSend;
+
+	int mErrno;
+
+	// statistics
+	size_t mDgReceived;
+	size_t mDgSent;
+	size_t mBytesReceived;
+	size_t mBytesSent;
+	size_t mCallsRecv;
+	size_t mCallsSend;
+	size_t mBatchRecvMax;
+	size_t mBatchSendMax;
+	uint32_t mDropsKernel;
+	size_t mDropsTruncated;
+	size_t mDropsSend;
+
+	/* static functions */
+	static socklen_t addrParse(const std::string &strAddr, uint16_t port,
+					struct sockaddr_storage &addr);
+	static bool fileNonBlockingSet(SOCKET fd);
+
+	/* static variables */
+
+	/* constants */
+
+};
+
+#endif
+
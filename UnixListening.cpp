@@ -0,0 +1,297 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "UnixListening.h"
+
+#define dForEach_ProcState(gen) \
+		gen(StStart) \
+		gen(StMain) \
+
+#define dGenProcStateEnum(s) s,
+dProcessStateEnum(ProcState);
+
+#if 0
+#define dGenProcStateString(s) #s,
+dProcessStateStr(ProcState);
+#endif
+
+using namespace std;
+
+#ifndef SOCK_CLOEXEC
+#define SOCK_CLOEXEC 0
+#endif
+
+#ifndef SOCK_NONBLOCK
+#define SOCK_NONBLOCK 0
+#endif
+
+UnixListening::UnixListening()
+	: Processing("UnixListening")
+	, mPath("")
+	, mMaxConn(200)
+	, mBacklog(128)
+	, mFdLst(INVALID_SOCKET)
+	, mSlotLst()
+	, mFileCreated(false)
+	, mConnCreated(0)
+{
+	mState = StStart;
+}
+
+/* member functions */
+
+void UnixListening::pathSet(const string &path)
+{
+	mPath = path;
+}
+
+void UnixListening::maxConnSet(size_t maxConn)
+{
+	mMaxConn = maxConn;
+}
+
+void UnixListening::backlogSet(int backlog)
+{
+	mBacklog = backlog;
+}
+
+SOCKET UnixListening::nextPeerFd()
+{
+	PipeEntry<SOCKET> peerFdEntry;
+
+	if (ppPeerFd.get(peerFdEntry) < 1)
+		return INVALID_SOCKET;
+
+	return peerFdEntry.particle;
+}
+
+Success UnixListening::process()
+{
+	Success success;
+#if 0
+	dStateTrace;
+#endif
+	switch (mState)
+	{
+	case StStart:
+
+		if (!mPath.size())
+			return procErrLog(-1, "path not set");
+
+		success = socketCreate();
+		if (success != Positive)
+			return procErrLog(-1, "could not create socket");
+
+		if (!Reactor::slotAdd(mSlotLst, mFdLst))
+			procDbgLog("accepting without reactor");
+
+		mState = StMain;
+
+		break;
+	case StMain:
+
+		if (!(Reactor::eventsUpdate(mSlotLst) & RevRead))
+			break;
+
+		while (1)
+		{
+			success = connectionsAccept();
+			if (success != Positive)
+				break;
+		}
+
+		break;
+	default:
+		break;
+	}
+
+	return Pending;
+}
+
+/*
+Literature
+- https://man7.org/linux/man-pages/man7/unix.7.html
+*/
+Success UnixListening::socketCreate()
+{
+	struct sockaddr_un addr;
+	socklen_t addrLen;
+
+	addrLen = UnixTransfering::addrUnixSet(addr, mPath);
+	if (!addrLen)
+		return procErrLog(-1, "invalid socket path '%s'", mPath.c_str());
+
+	// IMPORTANT
+	// No need to close socket in case of error
+	// This is done in function shutdown()
+
+	mFdLst = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (mFdLst == INVALID_SOCKET)
+		return procErrLog(-1, "socket() failed: %s", strerror(errno));
+
+	if (mPath[0] != '@' && socketFileStaleRemove(addr, addrLen) != Positive)
+		return -1;
+
+	if (::bind(mFdLst, (struct sockaddr *)&addr, addrLen) < 0)
+		return procErrLog(-1, "bind(%s) failed: %s", mPath.c_str(), strerror(errno));
+
+	mFileCreated = mPath[0] != '@';
+
+	if (::listen(mFdLst, mBacklog) < 0)
+		return procErrLog(-1, "listen() failed: %s", strerror(errno));
+
+	int opt = fcntl(mFdLst, F_GETFL, 0);
+
+	if (opt == -1 || fcntl(mFdLst, F_SETFL, opt | O_NONBLOCK) == -1)
+		return procErrLog(-1, "could not set non blocking mode: %s", strerror(errno));
+
+	return Positive;
+}
+
+/*
+ * Socket file of a previous run. Only removed if nobody
+ * listens on it anymore. Other files are never touched
+ */
+Success UnixListening::socketFileStaleRemove(const struct sockaddr_un &addr, socklen_t addrLen)
+{
+	struct stat st;
+	SOCKET fdProbe;
+	int res, numErr;
+
+	if (::lstat(mPath.c_str(), &st))
+	{
+		if (errno == ENOENT)
+			return Positive;
+
+		return procErrLog(-1, "could not check '%s': %s", mPath.c_str(), strerror(errno));
+	}
+
+	if (!S_ISSOCK(st.st_mode))
+		return procErrLog(-1, "'%s' exists and is no socket", mPath.c_str());
+
+	// Never blocks. A full backlog means somebody listens
+	fdProbe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fdProbe == INVALID_SOCKET)
+		return procErrLog(-1, "socket() failed: %s", strerror(errno));
+
+	res = ::connect(fdProbe, (const struct sockaddr *)&addr, addrLen);
+	numErr = errno;
+
+	::close(fdProbe);
+
+	if (!res || numErr == EAGAIN || numErr == EWOULDBLOCK)
+		return procErrLog(-1, "'%s' is in use", mPath.c_str());
+
+	if (numErr != ECONNREFUSED)
+		return procErrLog(-1, "could not probe '%s': %s", mPath.c_str(), strerror(numErr));
+
+	if (::unlink(mPath.c_str()) && errno != ENOENT)
+		return procErrLog(-1, "could not remove '%s': %s", mPath.c_str(), strerror(errno));
+
+	return Positive;
+}
+
+Success UnixListening::connectionsAccept()
+{
+	SOCKET peerSocketFd;
+	int numErr;
+
+	if (!(mSlotLst.eventsReady & RevRead))
+		return Pending;
+#if defined(__linux__)
+	peerSocketFd = ::accept4(mFdLst, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+	peerSocketFd = ::accept(mFdLst, NULL, NULL);
+#endif
+	if (peerSocketFd == INVALID_SOCKET)
+	{
+		numErr = errno;
+
+		if (numErr == EWOULDBLOCK || numErr == EAGAIN)
+		{
+			Reactor::eventsClear(mSlotLst, RevRead);
+			return Pending;
+		}
+
+		procWrnLog("accept() failed: %s (%d)", strerror(numErr), numErr);
+		return Pending;
+	}
+
+	if (ppPeerFd.isFull() || ppPeerFd.size() >= mMaxConn)
+	{
+		procWrnLog("dropping connection. Output queue full");
+		::close(peerSocketFd);
+
+		return Pending;
+	}
+
+	ppPeerFd.commit(peerSocketFd, nowMs());
+	++mConnCreated;
+
+	return Positive;
+}
+
+Success UnixListening::shutdown()
+{
+	PipeEntry<SOCKET> peerFd;
+
+	while (ppPeerFd.get(peerFd) > 0)
+		::close(peerFd.particle);
+
+	Reactor::slotRemove(mSlotLst);
+
+	if (mFdLst != INVALID_SOCKET)
+	{
+		::close(mFdLst);
+		mFdLst = INVALID_SOCKET;
+	}
+
+	if (mFileCreated)
+	{
+		::unlink(mPath.c_str());
+		mFileCreated = false;
+	}
+
+	return Positive;
+}
+
+void UnixListening::processInfo(char *pBuf, char *pBufEnd)
+{
+	dInfo("Path\t\t\t%s\n", mPath.c_str());
+	dInfo("Reactor\t\t\t%s\n", Reactor::slotActive(mSlotLst) ? "epoll" : "none");
+	dInfo("Connections created\t%d\n", (int)mConnCreated);
+	dInfo("Queue\t\t\t%zu\n", ppPeerFd.size());
+}
+
@@ -0,0 +1,133 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef UNIX_LISTENING_H
+#define UNIX_LISTENING_H
+
+#include <string>
+
+#include "Processing.h"
+#include "Pipe.h"
+#include "Reactor.h"
+#include "UnixTransfering.h"
+
+/*
+ * Counterpart of TcpListening for same-host peers. POSIX only
+ * - Accepted descriptors are committed to ppPeerFd and
+ *   are usually given to UnixTransfering::create()
+ * - Paths starting with '@' are in the abstract namespace (Linux).
+ *   Otherwise a stale socket file is removed before binding
+ */
+class UnixListening : public Processing
+{
+
+public:
+
+	static UnixListening *create()
+	{
+		return new (std::nothrow) UnixListening;
+	}
+
+	void pathSet(const std::string &path);
+	void maxConnSet(size_t maxConn);
+	void backlogSet(int backlog);
+
+	SOCKET nextPeerFd();
+	Pipe<SOCKET> ppPeerFd;
+
+protected:
+
+	virtual ~UnixListening() {}
+
+private:
+
+	UnixListening();
+	UnixListening(const UnixListening &)
+		: Processing("")
+		, mPath("")
+		, mMaxConn(0)
+		, mBacklog(0)
+		, mFdLst(INVALID_SOCKET)
+		, mSlotLst()
+		, mFileCreated(false)
+		, mConnCreated(0)
+	{
+		mState = 0;
+	}
+	UnixListening &operator=(const UnixListening &)
+	{
+		mPath = "";
+		mMaxConn = 0;
+		mBacklog = 0;
+		mFdLst = INVALID_SOCKET;
+		mSlotLst = ReactorSlot();
+		mFileCreated = false;
+		mConnCreated = 0;
+
+		mState = 0;
+
+		return *this;
+	}
+
+	/*
+	 * Naming of functions:  objectVerb()
+	 * Example:              peerAdd()
+	 */
+
+	/* member functions */
+	Success process();
+	Success shutdown();
+
+	Success socketCreate();
+	Success socketFileStaleRemove(const struct sockaddr_un &addr, socklen_t addrLen);
+	Success connectionsAccept();
+	void processInfo(char *pBuf, char *pBufEnd);
+
+	/* member variables */
+	std::string mPath;
+	size_t mMaxConn;
+	int mBacklog;
+	SOCKET mFdLst;
+	ReactorSlot mSlotLst;
+	bool mFileCreated;
+
+	// statistics
+	uint32_t mConnCreated;
+
+	/* static functions */
+
+	/* static variables */
+
+	/* constants */
+
+};
+
+#endif
+
@@ -0,0 +1,723 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <errno.h>
+#include <chrono>
+
+#include "UnixTransfering.h"
+
+#define dForEach_ProcState(gen) \
+		gen(StSrvStart) \
+		gen(StCltStart) \
+		gen(StCltConnect) \
+		gen(StConnMain) \
+		gen(StSendFlush) \
+
+#define dGenProcStateEnum(s) s,
+dProcessStateEnum(ProcState);
+
+#if 0
+#define dGenProcStateString(s) #s,
+dProcessStateStr(ProcState);
+#endif
+
+using namespace std;
+using namespace chrono;
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#ifndef SOCK_CLOEXEC
+#define SOCK_CLOEXEC 0
+#endif
+
+#ifndef SOCK_NONBLOCK
+#define SOCK_NONBLOCK 0
+#endif
+
+#ifndef MSG_CMSG_CLOEXEC
+#define MSG_CMSG_CLOEXEC 0
+#endif
+
+// Maximum number of descriptors taken from a single message
+#define dNumFdsPerMsgMax		4
+
+UnixTransfering::UnixTransfering(SOCKET fd)
+	: Transfering("UnixTransfering")
+#if CONFIG_PROC_HAVE_DRIVERS
+	, mSocketFdMtx()
+#endif
+	, mSocketFd(fd)
+	, mSlot()
+	, mPath("")
+	, mErrno(0)
+	, mFdPassing(false)
+	, mFdsReceived()
+	, mBufSend()
+	, mIdxSend(0)
+	, mStartMs(0)
+	, mBytesReceived(0)
+	, mBytesSent(0)
+	, mFdsPassed(0)
+{
+	mState = StSrvStart;
+	mSendReady = true;
+}
+
+UnixTransfering::UnixTransfering(const string &path)
+	: Transfering("UnixTransfering")
+#if CONFIG_PROC_HAVE_DRIVERS
+	, mSocketFdMtx()
+#endif
+	, mSocketFd(INVALID_SOCKET)
+	, mSlot()
+	, mPath(path)
+	, mErrno(0)
+	, mFdPassing(false)
+	, mFdsReceived()
+	, mBufSend()
+	, mIdxSend(0)
+	, mStartMs(0)
+	, mBytesReceived(0)
+	, mBytesSent(0)
+	, mFdsPassed(0)
+{
+	mState = StCltStart;
+	mSendReady = false;
+}
+
+/* member functions */
+
+void UnixTransfering::fdPassingSet()
+{
+	mFdPassing = true;
+}
+
+SOCKET UnixTransfering::nextFdReceived()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	if (mFdsReceived.empty())
+		return INVALID_SOCKET;
+
+	SOCKET fd = mFdsReceived.front();
+	mFdsReceived.pop();
+
+	return fd;
+}
+
+/*
+ * Connecting to a local socket completes at once or fails
+ * with EAGAIN if the backlog of the listener is full. The
+ * attempt is repeated on the next tick until the timeout
+ *
+Literature
+- https://man7.org/linux/man-pages/man7/unix.7.html
+*/
+Success UnixTransfering::process()
+{
+	struct sockaddr_un addr;
+	socklen_t addrLen;
+	ssize_t connCheck;
+	uint32_t events;
+	bool ok;
+#if 0
+	dStateTrace;
+#endif
+	switch (mState)
+	{
+	case StSrvStart:
+
+		if (mSocketFd == INVALID_SOCKET)
+			return procErrLog(-1, "socket file descriptor not set");
+
+		ok = fileNonBlockingSet(mSocketFd);
+		if (!ok)
+			return procErrLog(-1, "could not set non blocking mode: %s",
+							errnoToStr(errno).c_str());
+
+		Reactor::slotAdd(mSlot, mSocketFd, RevRead | RevWrite);
+
+		mReadReady = true;
+		mState = StConnMain;
+
+		break;
+	case StCltStart:
+
+		addrLen = addrUnixSet(addr, mPath);
+		if (!addrLen)
+			return procErrLog(-1, "invalid socket path '%s'", mPath.c_str());
+
+		mSocketFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (mSocketFd == INVALID_SOCKET)
+			return procErrLog(-1, "could not create socket: %s",
+							errnoToStr(errno).c_str());
+
+		ok = fileNonBlockingSet(mSocketFd);
+		if (!ok)
+			return procErrLog(-1, "could not set non blocking mode: %s",
+							errnoToStr(errno).c_str());
+
+		mStartMs = millis();
+		mState = StCltConnect;
+
+		break;
+	case StCltConnect:
+
+		addrLen = addrUnixSet(addr, mPath);
+
+		if (::connect(mSocketFd, (struct sockaddr *)&addr, addrLen))
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				return procErrLog(-1, "could not connect to '%s': %s",
+								mPath.c_str(), errnoToStr(errno).c_str());
+
+			if (millis() - mStartMs > CONFIG_UNIX_TIMEOUT_CONNECT_MS)
+				return procErrLog(-1, "could not connect to '%s': backlog full",
+								mPath.c_str());
+			break;
+		}
+
+		Reactor::slotAdd(mSlot, mSocketFd, RevRead | RevWrite);
+
+		mReadReady = true;
+		mSendReady = true;
+
+		mState = StConnMain;
+
+		break;
+	case StConnMain:
+
+		if (mDone)
+		{
+			mStartMs = millis();
+			mState = StSendFlush;
+			break;
+		}
+
+		events = Reactor::eventsUpdate(mSlot);
+
+		if (events & RevWrite)
+		{
+#if CONFIG_PROC_HAVE_DRIVERS
+			Guard lock(mSocketFdMtx);
+#endif
+			sendFlush();
+		}
+
+		if (!(events & (RevRead | RevHangUp | RevError)))
+			break;
+
+		connCheck = read(NULL, 0);
+		if (connCheck >= 0)
+			break;
+
+		if (mErrno)
+			return procErrLog(-1, "connection error occured: %s",
+							errnoToStr(mErrno).c_str());
+
+		return Positive;
+
+		break;
+	case StSendFlush:
+
+		// Queued data is sent before the socket is closed
+		if (Reactor::eventsUpdate(mSlot) & RevWrite)
+		{
+#if CONFIG_PROC_HAVE_DRIVERS
+			Guard lock(mSocketFdMtx);
+#endif
+			sendFlush();
+		}
+
+		if (mSocketFd == INVALID_SOCKET || !sendQueueBytes())
+			return Positive;
+
+		if (millis() - mStartMs > CONFIG_UNIX_TIMEOUT_SEND_FLUSH_MS)
+			return procErrLog(-1, "could not send queued data");
+
+		break;
+	default:
+		break;
+	}
+
+	return Pending;
+}
+
+Success UnixTransfering::shutdown()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	disconnect();
+
+	while (!mFdsReceived.empty())
+	{
+		::close(mFdsReceived.front());
+		mFdsReceived.pop();
+	}
+
+	return Positive;
+}
+
+/*
+Literature
+- https://man7.org/linux/man-pages/man2/recvmsg.2.html
+- https://man7.org/linux/man-pages/man3/cmsg.3.html
+*/
+ssize_t UnixTransfering::read(void *pBuf, size_t lenReq)
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	if (!mReadReady)
+		return 0;
+
+	if (mSocketFd == INVALID_SOCKET)
+		return -1;
+
+	uint32_t eventsSeen = mSlot.eventsReady;
+	ssize_t numBytes;
+	char buf[1];
+
+	if (!(eventsSeen & (RevRead | RevHangUp | RevError)))
+		return 0;
+
+	if (!pBuf || !lenReq)
+	{
+		numBytes = ::recv(mSocketFd, buf, sizeof(buf), MSG_PEEK);
+		if (numBytes <= 0)
+			return recvFailed(numBytes < 0 ? errno : 0, eventsSeen);
+
+		return numBytes;
+	}
+
+	if (!mFdPassing)
+	{
+		numBytes = ::recv(mSocketFd, pBuf, lenReq, 0);
+		if (numBytes <= 0)
+			return recvFailed(numBytes < 0 ? errno : 0, eventsSeen);
+
+		if ((size_t)numBytes < lenReq)
+			Reactor::eventsClear(mSlot, RevRead, eventsSeen);
+
+		mBytesReceived += numBytes;
+
+		return numBytes;
+	}
+
+	union
+	{
+		char buf[CMSG_SPACE(dNumFdsPerMsgMax * sizeof(int))];
+		struct cmsghdr align;
+	} ctrl;
+	struct msghdr msg;
+	struct iovec iov;
+
+	iov.iov_base = pBuf;
+	iov.iov_len = lenReq;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctrl.buf;
+	msg.msg_controllen = sizeof(ctrl.buf);
+
+	numBytes = ::recvmsg(mSocketFd, &msg, MSG_CMSG_CLOEXEC);
+	if (numBytes <= 0)
+		return recvFailed(numBytes < 0 ? errno : 0, eventsSeen);
+
+	fdsReceivedStore(msg);
+
+	if (msg.msg_flags & MSG_CTRUNC)
+		procWrnLog("passed descriptors truncated");
+
+	/*
+	 * No eventsClear() on short reads here. The kernel ends a read
+	 * before data carrying descriptors, even with more data queued.
+	 * Only EAGAIN tells the socket is empty
+	 */
+
+	mBytesReceived += numBytes;
+
+	return numBytes;
+}
+
+ssize_t UnixTransfering::recvFailed(int numErr, uint32_t eventsSeen)
+{
+	if (!numErr)
+	{
+		procDbgLog("connection reset by peer");
+		disconnect();
+		return -4;
+	}
+
+	if (numErr == EWOULDBLOCK || numErr == EAGAIN)
+	{
+		Reactor::eventsClear(mSlot, RevRead, eventsSeen);
+		return 0; // std case and ok
+	}
+
+	if (numErr == EINTR)
+		return 0;
+
+	if (numErr == ECONNRESET)
+	{
+		procDbgLog("connection reset by peer");
+		disconnect();
+		return -2;
+	}
+
+	disconnect(numErr);
+
+	return procErrLog(-3, "recv() failed: %s", errnoToStr(numErr).c_str());
+}
+
+void UnixTransfering::fdsReceivedStore(struct msghdr &msg)
+{
+	struct cmsghdr *pCmsg;
+	size_t numFds;
+	int fd;
+
+	for (pCmsg = CMSG_FIRSTHDR(&msg); pCmsg; pCmsg = CMSG_NXTHDR(&msg, pCmsg))
+	{
+		if (pCmsg->cmsg_level != SOL_SOCKET || pCmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		numFds = (pCmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+		for (size_t i = 0; i < numFds; ++i)
+		{
+			memcpy(&fd, CMSG_DATA(pCmsg) + i * sizeof(int), sizeof(int));
+			mFdsReceived.push(fd);
+			++mFdsPassed;
+		}
+	}
+}
+
+ssize_t UnixTransfering::send(const void *pData, size_t lenReq)
+{
+	return send(pData, lenReq, INVALID_SOCKET);
+}
+
+/*
+ * Data is accepted all or nothing. What the socket doesn't
+ * take at once is queued and sent on the next write event
+ * - At least one byte of data is required to pass a descriptor.
+ *   The descriptor is passed with the first byte. This
+ *   requires an empty queue
+ *
+ * Return value
+ *   > 0 number of bytes sent or queued
+ *   = 0 queue full or descriptor not passed. Nothing accepted
+ *   < 0 connection down
+ */
+ssize_t UnixTransfering::send(const void *pData, size_t lenReq, SOCKET fdPass)
+{
+	if (!mSendReady)
+		return procErrLog(-1, "unable to send data. Not ready");
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	// No error message here. See TcpTransfering::send()
+	if (mSocketFd == INVALID_SOCKET)
+		return -1;
+
+	if (!pData || !lenReq)
+		return 0;
+
+	const uint8_t *pStart = (const uint8_t *)pData;
+	size_t lenQueued = mBufSend.size() - mIdxSend;
+	size_t lenDone = 0;
+	ssize_t res;
+
+	// Queued data first. Keeps the stream in order
+	if (lenQueued)
+	{
+		res = sendFlush();
+		if (res < 0)
+			return res;
+
+		lenQueued = mBufSend.size() - mIdxSend;
+	}
+
+	// An empty queue accepts anything
+	if (lenQueued && (fdPass != INVALID_SOCKET ||
+				lenQueued + lenReq > CONFIG_UNIX_SIZE_QUEUE_SEND_MAX))
+		return 0;
+
+	if (!lenQueued)
+	{
+		res = dataSend(pStart, lenReq, fdPass);
+		if (res < 0)
+			return res;
+
+		// Descriptor must not be passed later without the caller knowing
+		if (!res && fdPass != INVALID_SOCKET)
+			return 0;
+
+		lenDone = res;
+	}
+
+	if (lenDone == lenReq)
+		return lenReq;
+
+	if (!lenQueued)
+	{
+		mBufSend.clear();
+		mIdxSend = 0;
+	}
+
+	mBufSend.insert(mBufSend.end(), pStart + lenDone, pStart + lenReq);
+
+	return lenReq;
+}
+
+size_t UnixTransfering::sendQueueBytes()
+{
+#if CONFIG_PROC_HAVE_DRIVERS
+	Guard lock(mSocketFdMtx);
+#endif
+	return mBufSend.size() - mIdxSend;
+}
+
+/*
+ * Lock must be held by the caller
+ */
+ssize_t UnixTransfering::sendFlush()
+{
+	ssize_t res, bytesSum = 0;
+
+	while (mIdxSend < mBufSend.size())
+	{
+		res = dataSend(&mBufSend[mIdxSend], mBufSend.size() - mIdxSend, INVALID_SOCKET);
+		if (res < 0)
+			return res;
+
+		if (!res)
+			break;
+
+		mIdxSend += res;
+		bytesSum += res;
+	}
+
+	if (mIdxSend == mBufSend.size())
+	{
+		mBufSend.clear();
+		mIdxSend = 0;
+	}
+
+	return bytesSum;
+}
+
+/*
+ * Return value
+ *   >= 0 number of bytes sent. Zero if the socket is full
+ *   < 0  connection down
+ */
+ssize_t UnixTransfering::dataSend(const void *pData, size_t len, SOCKET fdPass)
+{
+	union
+	{
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} ctrl;
+	struct cmsghdr *pCmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	uint32_t eventsSeen;
+	ssize_t res;
+	int numErr;
+
+	if (mSocketFd == INVALID_SOCKET)
+		return -1;
+
+	iov.iov_base = (void *)pData;
+	iov.iov_len = len;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (fdPass != INVALID_SOCKET)
+	{
+		memset(ctrl.buf, 0, sizeof(ctrl.buf));
+		msg.msg_control = ctrl.buf;
+		msg.msg_controllen = sizeof(ctrl.buf);
+
+		pCmsg = CMSG_FIRSTHDR(&msg);
+		pCmsg->cmsg_level = SOL_SOCKET;
+		pCmsg->cmsg_type = SCM_RIGHTS;
+		pCmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(pCmsg), &fdPass, sizeof(int));
+	}
+
+	eventsSeen = mSlot.eventsReady;
+
+	res = ::sendmsg(mSocketFd, &msg, MSG_NOSIGNAL);
+	if (res >= 0)
+	{
+		mBytesSent += res;
+		return res;
+	}
+
+	numErr = errno;
+
+	if (numErr == EWOULDBLOCK || numErr == EAGAIN)
+	{
+		Reactor::eventsClear(mSlot, RevWrite, eventsSeen);
+		return 0; // std case and ok
+	}
+
+	if (numErr == EINTR)
+		return 0;
+
+	disconnect(numErr);
+
+	return procErrLog(-1, "connection down: %s",
+					errnoToStr(numErr).c_str());
+}
+
+void UnixTransfering::disconnect(int err)
+{
+	// every caller must lock in advance!
+	if (mSocketFd == INVALID_SOCKET)
+		return;
+
+	mErrno = err;
+
+	Reactor::slotRemove(mSlot);
+	::close(mSocketFd);
+	mSocketFd = INVALID_SOCKET;
+}
+
+string UnixTransfering::errnoToStr(int num)
+{
+	char buf[64];
+	size_t len = sizeof(buf) - 1;
+	char *pBuf;
+
+	buf[0] = 0;
+	buf[len] = 0;
+
+#if defined(__FreeBSD__) || defined(__APPLE__)
+	int res;
+
+	pBuf = buf;
+	res = ::strerror_r(num, buf, len);
+	if (res)
+		*pBuf = 0;
+#else
+	pBuf = ::strerror_r(num, buf, len);
+#endif
+	return string(pBuf);
+}
+
+void UnixTransfering::processInfo(char *pBuf, char *pBufEnd)
+{
+	if (mPath.size())
+		dInfo("Path\t\t\t%s\n", mPath.c_str());
+#if defined(__linux__)
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (mSocketFd != INVALID_SOCKET &&
+			!::getsockopt(mSocketFd, SOL_SOCKET, SO_PEERCRED, &cred, &len))
+		dInfo("Peer\t\t\tpid %d, uid %d\n", (int)cred.pid, (int)cred.uid);
+#endif
+	dInfo("Bytes received\t\t%zu\n", mBytesReceived);
+	dInfo("Bytes sent\t\t%zu\n", mBytesSent);
+	dInfo("Bytes queued\t\t%zu\n", sendQueueBytes());
+
+	if (mFdPassing)
+		dInfo("Descriptors received\t%u\n", mFdsPassed);
+}
+
+/* static functions */
+
+uint32_t UnixTransfering::millis()
+{
+	auto now = steady_clock::now();
+	auto nowMs = time_point_cast<milliseconds>(now);
+	return (uint32_t)nowMs.time_since_epoch().count();
+}
+
+/*
+ * Returns the length of the address or 0 on error
+ */
+socklen_t UnixTransfering::addrUnixSet(struct sockaddr_un &addr, const string &path)
+{
+	size_t lenPath = path.size();
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+
+	if (!lenPath || lenPath >= sizeof(addr.sun_path))
+		return 0;
+
+	memcpy(addr.sun_path, path.data(), lenPath);
+
+	if (path[0] != '@')
+		return sizeof(addr);
+#if defined(__linux__)
+	// Abstract namespace. Length must not include trailing zeros
+	addr.sun_path[0] = 0;
+
+	return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + lenPath);
+#else
+	return 0;
+#endif
+}
+
+bool UnixTransfering::fileNonBlockingSet(SOCKET fd)
+{
+	int opt;
+
+	opt = fcntl(fd, F_GETFL, 0);
+	if (opt == -1)
+		return false;
+
+	if (opt & O_NONBLOCK)
+		return true;
+
+	opt |= O_NONBLOCK;
+
+	opt = fcntl(fd, F_SETFL, opt);
+	if (opt == -1)
+		return false;
+
+	return true;
+}
+
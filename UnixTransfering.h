@@ -0,0 +1,216 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef UNIX_TRANSFERING_H
+#define UNIX_TRANSFERING_H
+
+#include <string>
+#include <queue>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+
+#ifndef SOCKET
+#define SOCKET int
+#define INVALID_SOCKET -1
+#endif
+
+#include "Transfering.h"
+#include "Reactor.h"
+
+// Data which can't be sent at once is queued up to this size
+#ifndef CONFIG_UNIX_SIZE_QUEUE_SEND_MAX
+#define CONFIG_UNIX_SIZE_QUEUE_SEND_MAX		(1024 * 1024)
+#endif
+
+// Time for retrying while the backlog of the listener is full
+#ifndef CONFIG_UNIX_TIMEOUT_CONNECT_MS
+#define CONFIG_UNIX_TIMEOUT_CONNECT_MS		2000
+#endif
+
+// Time for sending the queue after doneSet()
+#ifndef CONFIG_UNIX_TIMEOUT_SEND_FLUSH_MS
+#define CONFIG_UNIX_TIMEOUT_SEND_FLUSH_MS	3000
+#endif
+
+/*
+ * Stream transfer over Unix domain sockets. POSIX only
+ * - Paths starting with '@' are in the abstract namespace (Linux)
+ * - Descriptors can be passed with SCM_RIGHTS. Receiving
+ *   must be enabled with fdPassingSet()
+ * - Sends are all or nothing. The rest is queued
+ */
+class UnixTransfering : public Transfering
+{
+
+public:
+
+	static UnixTransfering *create(SOCKET fd)
+	{
+		return new (std::nothrow) UnixTransfering(fd);
+	}
+
+	static UnixTransfering *create(const std::string &path)
+	{
+		return new (std::nothrow) UnixTransfering(path);
+	}
+
+	using Transfering::send;
+
+	ssize_t read(void *pBuf, size_t lenReq);
+	ssize_t send(const void *pData, size_t lenReq);
+	ssize_t send(const void *pData, size_t lenReq, SOCKET fdPass);
+	size_t sendQueueBytes();
+
+	void fdPassingSet();
+	SOCKET nextFdReceived();
+
+	static socklen_t addrUnixSet(struct sockaddr_un &addr, const std::string &path);
+
+protected:
+
+	virtual ~UnixTransfering() {}
+
+private:
+
+	UnixTransfering(SOCKET fd);
+	UnixTransfering(const std::string &path);
+	UnixTransfering()
+		: Transfering("")
+#if CONFIG_PROC_HAVE_DRIVERS
+		, mSocketFdMtx()
+#endif
+		, mSocketFd(INVALID_SOCKET)
+		, mSlot()
+		, mPath("")
+		, mErrno(0)
+		, mFdPassing(false)
+		, mFdsReceived()
+		, mBufSend()
+		, mIdxSend(0)
+		, mStartMs(0)
+		, mBytesReceived(0)
+		, mBytesSent(0)
+		, mFdsPassed(0)
+	{
+		mState = 0;
+		mSendReady = false;
+	}
+	UnixTransfering(const UnixTransfering &)
+		: Transfering("")
+#if CONFIG_PROC_HAVE_DRIVERS
+		, mSocketFdMtx()
+#endif
+		, mSocketFd(INVALID_SOCKET)
+		, mSlot()
+		, mPath("")
+		, mErrno(0)
+		, mFdPassing(false)
+		, mFdsReceived()
+		, mBufSend()
+		, mIdxSend(0)
+		, mStartMs(0)
+		, mBytesReceived(0)
+		, mBytesSent(0)
+		, mFdsPassed(0)
+	{
+		mState = 0;
+		mSendReady = false;
+	}
+	UnixTransfering &operator=(const UnixTransfering &)
+	{
+		mSocketFd = INVALID_SOCKET;
+		mSlot = ReactorSlot();
+		mPath = "";
+		mErrno = 0;
+		mFdPassing = false;
+		mBufSend.clear();
+		mIdxSend = 0;
+		mStartMs = 0;
+		mBytesReceived = 0;
+		mBytesSent = 0;
+		mFdsPassed = 0;
+
+		mState = 0;
+		mSendReady = false;
+
+		return *this;
+	}
+
+	/*
+	 * Naming of functions:  objectVerb()
+	 * Example:              peerAdd()
+	 */
+
+	/* member functions */
+	Success process();
+	Success shutdown();
+
+	void disconnect(int err = 0);
+	ssize_t recvFailed(int numErr, uint32_t eventsSeen);
+	void fdsReceivedStore(struct msghdr &msg);
+	ssize_t sendFlush();
+	ssize_t dataSend(const void *pData, size_t len, SOCKET fdPass);
+	std::string errnoToStr(int num);
+	void processInfo(char *pBuf, char *pBufEnd);
+
+	/* member variables */
+#if CONFIG_PROC_HAVE_DRIVERS
+	std::mutex mSocketFdMtx;
+#endif
+	SOCKET mSocketFd;
+	ReactorSlot mSlot;
+	std::string mPath;
+	int mErrno;
+	bool mFdPassing;
+	std::queue<SOCKET> mFdsReceived;
+
+	// Unsent data starts at mIdxSend
+	VecByte mBufSend;
+	size_t mIdxSend;
+	uint32_t mStartMs;
+
+	// statistics
+	size_t mBytesReceived;
+	size_t mBytesSent;
+	uint32_t mFdsPassed;
+
+	/* static functions */
+	static uint32_t millis();
+	static bool fileNonBlockingSet(SOCKET fd);
+
+	/* static variables */
+
+	/* constants */
+
+};
+
+#endif
+
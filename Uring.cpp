@@ -0,0 +1,941 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "Uring.h"
+
+#if CONFIG_PROC_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <atomic>
+#endif
+
+using namespace std;
+
+#if CONFIG_PROC_HAVE_IO_URING
+#if CONFIG_PROC_HAVE_DRIVERS
+#define dThreadLocal thread_local
+#else
+#define dThreadLocal
+#endif
+
+enum UringOp
+{
+	OpNone = 0,
+	OpAccept,
+	OpRecv,
+	OpSend,
+	OpMask = 7,
+};
+
+const uint16_t cIdBufGroup = 1;
+
+/*
+ * Rings are mapped by hand. liburing is not required
+ */
+struct UringThread
+{
+	UringThread()
+		: fd(-1)
+		, initDone(false)
+		, pRingSq(NULL)
+		, pRingCq(NULL)
+		, sizeRingSq(0)
+		, sizeRingCq(0)
+		, pSqes(NULL)
+		, sizeSqes(0)
+		, pSqHead(NULL)
+		, pSqTail(NULL)
+		, pSqFlags(NULL)
+		, pSqArray(NULL)
+		, sqMask(0)
+		, sqEntries(0)
+		, sqTail(0)
+		, sqTailSubmitted(0)
+		, pCqHead(NULL)
+		, pCqTail(NULL)
+		, pCqes(NULL)
+		, cqMask(0)
+		, pBufRing(NULL)
+		, sizeBufRing(0)
+		, pBufs(NULL)
+		, bufTail(0)
+#if CONFIG_PROC_HAVE_DRIVERS
+		, mtxRemoved()
+#endif
+		, slotsRemoved()
+		, numSlotsRemoved(0)
+		, idPoll(1)
+		, numEnters(0)
+	{}
+	~UringThread()
+	{
+		slotsRemovedDelete();
+
+		if (pBufs)
+			delete[] pBufs;
+
+		if (pBufRing)
+			::munmap(pBufRing, sizeBufRing);
+
+		if (pSqes)
+			::munmap(pSqes, sizeSqes);
+
+		if (pRingCq && pRingCq != pRingSq)
+			::munmap(pRingCq, sizeRingCq);
+
+		if (pRingSq)
+			::munmap(pRingSq, sizeRingSq);
+
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	int fd;
+	bool initDone;
+
+	void *pRingSq;
+	void *pRingCq;
+	size_t sizeRingSq;
+	size_t sizeRingCq;
+	struct io_uring_sqe *pSqes;
+	size_t sizeSqes;
+
+	uint32_t *pSqHead;
+	uint32_t *pSqTail;
+	uint32_t *pSqFlags;
+	uint32_t *pSqArray;
+	uint32_t sqMask;
+	uint32_t sqEntries;
+	uint32_t sqTail;
+	uint32_t sqTailSubmitted;
+
+	uint32_t *pCqHead;
+	uint32_t *pCqTail;
+	struct io_uring_cqe *pCqes;
+	uint32_t cqMask;
+
+	struct io_uring_buf *pBufRing;
+	size_t sizeBufRing;
+	uint8_t *pBufs;
+	uint16_t bufTail;
+
+	// Slots removed by other threads
+#if CONFIG_PROC_HAVE_DRIVERS
+	mutex mtxRemoved;
+#endif
+	vector<UringSlot *> slotsRemoved;
+	atomic<uint32_t> numSlotsRemoved;
+
+	uint32_t idPoll;
+	uint32_t numEnters;
+
+private:
+
+	// Thread ends. Operations die with the ring
+	void slotsRemovedDelete()
+	{
+		vector<UringSlot *>::iterator iter;
+
+		for (iter = slotsRemoved.begin(); iter != slotsRemoved.end(); ++iter)
+		{
+			while ((*iter)->fdsReaped.size())
+			{
+				::close((*iter)->fdsReaped.front());
+				(*iter)->fdsReaped.pop_front();
+			}
+
+			::close((*iter)->fd);
+			delete *iter;
+		}
+
+		slotsRemoved.clear();
+	}
+};
+
+static bool uringEnabled = false;
+static dThreadLocal UringThread uringThread;
+
+static int uringEnter(UringThread &ut, uint32_t numSubmit, uint32_t flags)
+{
+	++ut.numEnters;
+	return (int)::syscall(__NR_io_uring_enter, ut.fd, numSubmit, 0, flags, NULL, 0);
+}
+
+static void bufferRecycle(UringThread &ut, uint16_t idBuf)
+{
+	struct io_uring_buf *pBuf;
+
+	pBuf = &ut.pBufRing[ut.bufTail & (CONFIG_PROC_URING_NUM_BUFFERS - 1)];
+
+	pBuf->addr = (uint64_t)(uintptr_t)(ut.pBufs + (size_t)idBuf * CONFIG_PROC_URING_SIZE_BUFFER);
+	pBuf->len = CONFIG_PROC_URING_SIZE_BUFFER;
+	pBuf->bid = idBuf;
+
+	// Tail overlays the reserved field of the first entry
+	++ut.bufTail;
+	__atomic_store_n(&ut.pBufRing[0].resv, ut.bufTail, __ATOMIC_RELEASE);
+}
+
+/*
+Literature
+- https://man7.org/linux/man-pages/man2/io_uring_setup.2.html
+- https://man7.org/linux/man-pages/man3/io_uring_register_buf_ring.3.html
+*/
+static bool uringInit(UringThread &ut)
+{
+	struct io_uring_params params;
+	struct io_uring_buf_reg reg;
+	void *pMem;
+
+	memset(&params, 0, sizeof(params));
+
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = 4 * CONFIG_PROC_URING_NUM_ENTRIES;
+
+	ut.fd = (int)::syscall(__NR_io_uring_setup, CONFIG_PROC_URING_NUM_ENTRIES, &params);
+	if (ut.fd < 0)
+		return false;
+
+	ut.sizeRingSq = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	ut.sizeRingCq = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (ut.sizeRingCq > ut.sizeRingSq)
+			ut.sizeRingSq = ut.sizeRingCq;
+		ut.sizeRingCq = ut.sizeRingSq;
+	}
+
+	pMem = ::mmap(NULL, ut.sizeRingSq, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_POPULATE, ut.fd, IORING_OFF_SQ_RING);
+	if (pMem == MAP_FAILED)
+		return false;
+
+	ut.pRingSq = pMem;
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		ut.pRingCq = ut.pRingSq;
+	else
+	{
+		pMem = ::mmap(NULL, ut.sizeRingCq, PROT_READ | PROT_WRITE,
+						MAP_SHARED | MAP_POPULATE, ut.fd, IORING_OFF_CQ_RING);
+		if (pMem == MAP_FAILED)
+			return false;
+
+		ut.pRingCq = pMem;
+	}
+
+	ut.sizeSqes = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	pMem = ::mmap(NULL, ut.sizeSqes, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_POPULATE, ut.fd, IORING_OFF_SQES);
+	if (pMem == MAP_FAILED)
+		return false;
+
+	ut.pSqes = (struct io_uring_sqe *)pMem;
+
+	uint8_t *pSq = (uint8_t *)ut.pRingSq;
+	uint8_t *pCq = (uint8_t *)ut.pRingCq;
+
+	ut.pSqHead = (uint32_t *)(pSq + params.sq_off.head);
+	ut.pSqTail = (uint32_t *)(pSq + params.sq_off.tail);
+	ut.pSqFlags = (uint32_t *)(pSq + params.sq_off.flags);
+	ut.pSqArray = (uint32_t *)(pSq + params.sq_off.array);
+	ut.sqMask = *(uint32_t *)(pSq + params.sq_off.ring_mask);
+	ut.sqEntries = params.sq_entries;
+	ut.sqTail = *ut.pSqTail;
+	ut.sqTailSubmitted = ut.sqTail;
+
+	ut.pCqHead = (uint32_t *)(pCq + params.cq_off.head);
+	ut.pCqTail = (uint32_t *)(pCq + params.cq_off.tail);
+	ut.pCqes = (struct io_uring_cqe *)(pCq + params.cq_off.cqes);
+	ut.cqMask = *(uint32_t *)(pCq + params.cq_off.ring_mask);
+
+	// Provided buffers for multishot receive
+	ut.sizeBufRing = CONFIG_PROC_URING_NUM_BUFFERS * sizeof(struct io_uring_buf);
+
+	pMem = ::mmap(NULL, ut.sizeBufRing, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pMem == MAP_FAILED)
+		return false;
+
+	// struct io_uring_buf_ring has a different layout in C++
+	ut.pBufRing = (struct io_uring_buf *)pMem;
+
+	ut.pBufs = new (nothrow) uint8_t[(size_t)CONFIG_PROC_URING_NUM_BUFFERS *
+										CONFIG_PROC_URING_SIZE_BUFFER];
+	if (!ut.pBufs)
+		return false;
+
+	memset(&reg, 0, sizeof(reg));
+
+	reg.ring_addr = (uint64_t)(uintptr_t)ut.pBufRing;
+	reg.ring_entries = CONFIG_PROC_URING_NUM_BUFFERS;
+	reg.bgid = cIdBufGroup;
+
+	if (::syscall(__NR_io_uring_register, ut.fd, IORING_REGISTER_PBUF_RING, &reg, 1))
+		return false;
+
+	for (uint16_t idBuf = 0; idBuf < CONFIG_PROC_URING_NUM_BUFFERS; ++idBuf)
+		bufferRecycle(ut, idBuf);
+
+	return true;
+}
+
+static bool uringGet(UringThread *&pUt)
+{
+	UringThread &ut = uringThread;
+
+	pUt = &ut;
+
+	if (!ut.initDone)
+	{
+		ut.initDone = true;
+
+		if (!uringInit(ut) && ut.fd >= 0)
+		{
+			::close(ut.fd);
+			ut.fd = -1;
+		}
+	}
+
+	return ut.fd >= 0;
+}
+
+static void uringSubmit(UringThread &ut)
+{
+	uint32_t numSubmit = ut.sqTail - ut.sqTailSubmitted;
+	uint32_t flags = 0;
+	int res;
+
+	if (!numSubmit)
+		return;
+
+	__atomic_store_n(ut.pSqTail, ut.sqTail, __ATOMIC_RELEASE);
+
+	if (*ut.pSqFlags & IORING_SQ_CQ_OVERFLOW)
+		flags |= IORING_ENTER_GETEVENTS;
+
+	res = uringEnter(ut, numSubmit, flags);
+	if (res < 0)
+		return;
+
+	ut.sqTailSubmitted += res;
+}
+
+static struct io_uring_sqe *sqeGet(UringThread &ut)
+{
+	uint32_t head = __atomic_load_n(ut.pSqHead, __ATOMIC_ACQUIRE);
+	struct io_uring_sqe *pSqe;
+	uint32_t idx;
+
+	if (ut.sqTail - head >= ut.sqEntries)
+	{
+		uringSubmit(ut);
+
+		head = __atomic_load_n(ut.pSqHead, __ATOMIC_ACQUIRE);
+		if (ut.sqTail - head >= ut.sqEntries)
+			return NULL;
+	}
+
+	idx = ut.sqTail & ut.sqMask;
+	pSqe = &ut.pSqes[idx];
+
+	memset(pSqe, 0, sizeof(*pSqe));
+	ut.pSqArray[idx] = idx;
+	++ut.sqTail;
+
+	return pSqe;
+}
+
+static uint32_t sqFree(UringThread &ut)
+{
+	uint32_t head = __atomic_load_n(ut.pSqHead, __ATOMIC_ACQUIRE);
+
+	return ut.sqEntries - (ut.sqTail - head);
+}
+
+static uint64_t userDataGet(UringSlot *pSlot, UringOp op)
+{
+	return (uint64_t)(uintptr_t)pSlot | op;
+}
+
+static bool multishotArm(UringThread &ut, UringSlot *pSlot)
+{
+	struct io_uring_sqe *pSqe = sqeGet(ut);
+
+	if (!pSqe)
+		return false;
+
+	pSqe->fd = pSlot->fd;
+
+	if (pSlot->listening)
+	{
+		pSqe->opcode = IORING_OP_ACCEPT;
+		pSqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		pSqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+		pSqe->user_data = userDataGet(pSlot, OpAccept);
+	}
+	else
+	{
+		pSqe->opcode = IORING_OP_RECV;
+		pSqe->ioprio = IORING_RECV_MULTISHOT;
+		pSqe->flags = IOSQE_BUFFER_SELECT;
+		pSqe->buf_group = cIdBufGroup;
+		pSqe->user_data = userDataGet(pSlot, OpRecv);
+	}
+
+	pSlot->armed = true;
+	++pSlot->numOps;
+
+	return true;
+}
+
+static void multishotCancel(UringThread &ut, UringSlot *pSlot)
+{
+	struct io_uring_sqe *pSqe;
+
+	if (!pSlot->armed || pSlot->paused)
+		return;
+
+	pSqe = sqeGet(ut);
+	if (!pSqe)
+		return;
+
+	pSqe->opcode = IORING_OP_ASYNC_CANCEL;
+	pSqe->addr = userDataGet(pSlot, pSlot->listening ? OpAccept : OpRecv);
+
+	pSlot->paused = true;
+}
+
+/*
+ * Queued data is sent as one chain of linked sends. The next
+ * chain starts after the previous one completed. Otherwise
+ * the kernel could reorder the data of concurrent sends
+ * - Entries of a chain are reserved up front. A submit
+ *   in between would cut the chain in two
+ * - Buffers which don't fit are sent with the next chain
+ */
+static void sendChainSubmit(UringThread &ut, UringSlot *pSlot)
+{
+	struct io_uring_sqe *pSqe;
+	size_t numBufs;
+
+	if (pSlot->bufsInFlight.size() || !pSlot->bufsSend.size())
+		return;
+
+	if (sqFree(ut) < pSlot->bufsSend.size())
+		uringSubmit(ut);
+
+	numBufs = sqFree(ut);
+	if (numBufs > pSlot->bufsSend.size())
+		numBufs = pSlot->bufsSend.size();
+
+	for (size_t idx = 0; idx < numBufs; ++idx)
+	{
+		pSlot->bufsInFlight.push_back(vector<uint8_t>());
+		pSlot->bufsInFlight.back().swap(pSlot->bufsSend.front());
+		pSlot->bufsSend.pop_front();
+
+		vector<uint8_t> &buf = pSlot->bufsInFlight.back();
+
+		pSqe = sqeGet(ut);
+
+		pSqe->opcode = IORING_OP_SEND;
+		pSqe->fd = pSlot->fd;
+		pSqe->addr = (uint64_t)(uintptr_t)buf.data();
+		pSqe->len = (uint32_t)buf.size();
+		pSqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+		pSqe->user_data = userDataGet(pSlot, OpSend);
+
+		if (idx + 1 < numBufs)
+			pSqe->flags |= IOSQE_IO_LINK;
+
+		++pSlot->numOps;
+	}
+}
+
+/*
+ * The rest of a chain fails with ECANCELED
+ */
+static void sendsCancel(UringThread &ut, UringSlot *pSlot)
+{
+	struct io_uring_sqe *pSqe;
+
+	if (!pSlot->bufsInFlight.size())
+		return;
+
+	pSqe = sqeGet(ut);
+	if (!pSqe)
+		return;
+
+	pSqe->opcode = IORING_OP_ASYNC_CANCEL;
+	pSqe->addr = userDataGet(pSlot, OpSend);
+	pSqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+}
+
+// The socket is closed only now. No operation can reach a reused descriptor
+static void slotDelete(UringSlot *pSlot)
+{
+	while (pSlot->fdsReaped.size())
+	{
+		::close(pSlot->fdsReaped.front());
+		pSlot->fdsReaped.pop_front();
+	}
+
+	::close(pSlot->fd);
+
+	delete pSlot;
+}
+
+static void cqeProcess(UringThread &ut, const struct io_uring_cqe *pCqe)
+{
+	UringSlot *pSlot = (UringSlot *)(uintptr_t)(pCqe->user_data & ~(uint64_t)OpMask);
+	UringOp op = (UringOp)(pCqe->user_data & OpMask);
+	bool more = pCqe->flags & IORING_CQE_F_MORE;
+	int res = pCqe->res;
+
+	if (op == OpNone)
+		return;
+
+	if (op == OpAccept)
+	{
+		if (res >= 0 && pSlot->released)
+			::close(res);
+		else
+		if (res >= 0)
+			pSlot->fdsReaped.push_back(res);
+	}
+
+	if (op == OpRecv)
+	{
+		if (pCqe->flags & IORING_CQE_F_BUFFER)
+		{
+			uint16_t idBuf = pCqe->flags >> IORING_CQE_BUFFER_SHIFT;
+			const uint8_t *pBuf = ut.pBufs + (size_t)idBuf * CONFIG_PROC_URING_SIZE_BUFFER;
+
+			if (res > 0 && !pSlot->released)
+				pSlot->dataReaped.insert(pSlot->dataReaped.end(), pBuf, pBuf + res);
+
+			bufferRecycle(ut, idBuf);
+		}
+
+		if (!res)
+			pSlot->eofReaped = true;
+		else
+		if (res < 0 && res != -ENOBUFS && res != -ECANCELED && !pSlot->errReaped)
+			pSlot->errReaped = -res;
+
+		// Owner does not keep up
+		if (more && pSlot->dataReaped.size() > CONFIG_PROC_URING_SIZE_RECV_MAX)
+			multishotCancel(ut, pSlot);
+	}
+
+	if (op == OpSend)
+	{
+		pSlot->numBytesSentReaped += pSlot->bufsInFlight.front().size();
+		pSlot->bufsInFlight.pop_front();
+
+		if (res < 0 && !pSlot->errReaped)
+			pSlot->errReaped = -res;
+	}
+
+	if (more)
+		return;
+
+	if (op != OpSend)
+	{
+		pSlot->armed = false;
+		pSlot->paused = false;
+	}
+
+	--pSlot->numOps;
+
+	if (pSlot->released && !pSlot->numOps)
+		slotDelete(pSlot);
+}
+
+static void uringReap(UringThread &ut)
+{
+	uint32_t head = *ut.pCqHead;
+	uint32_t tail = __atomic_load_n(ut.pCqTail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; ++head)
+		cqeProcess(ut, &ut.pCqes[head & ut.cqMask]);
+
+	__atomic_store_n(ut.pCqHead, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * Queued data is dropped and sends in flight are
+ * canceled. The slot is deleted after its last
+ * operation completed
+ */
+static void slotRelease(UringThread &ut, UringSlot *pSlot)
+{
+	pSlot->released = true;
+	pSlot->dataReaped.clear();
+	pSlot->bufsSend.clear();
+
+	multishotCancel(ut, pSlot);
+	sendsCancel(ut, pSlot);
+	uringSubmit(ut);
+
+	if (!pSlot->numOps)
+		slotDelete(pSlot);
+}
+
+static void slotsRemovedProcess(UringThread &ut)
+{
+	vector<UringSlot *> slots;
+
+	// Cheap check. Called on every update
+	if (!ut.numSlotsRemoved.load())
+		return;
+	{
+#if CONFIG_PROC_HAVE_DRIVERS
+		Guard lock(ut.mtxRemoved);
+#endif
+		slots.swap(ut.slotsRemoved);
+		ut.numSlotsRemoved = 0;
+	}
+
+	vector<UringSlot *>::iterator iter;
+
+	for (iter = slots.begin(); iter != slots.end(); ++iter)
+		slotRelease(ut, *iter);
+}
+
+static UringSlot *slotCreate(int fd, bool listening)
+{
+	UringThread *pUt;
+	UringSlot *pSlot;
+
+	if (fd < 0 || !uringEnabled || !uringGet(pUt))
+		return NULL;
+
+	pSlot = new (nothrow) UringSlot;
+	if (!pSlot)
+		return NULL;
+
+	pSlot->fd = fd;
+	pSlot->listening = listening;
+	pSlot->idPoll = pUt->idPoll;
+	pSlot->pRing = pUt;
+
+	if (!multishotArm(*pUt, pSlot))
+	{
+		delete pSlot;
+		return NULL;
+	}
+
+	return pSlot;
+}
+#endif
+
+void Uring::enabledSet(bool enabled)
+{
+#if CONFIG_PROC_HAVE_IO_URING
+	uringEnabled = enabled;
+#else
+	(void)enabled;
+#endif
+}
+
+bool Uring::enabled()
+{
+#if CONFIG_PROC_HAVE_IO_URING
+	UringThread *pUt;
+
+	if (!uringEnabled)
+		return false;
+
+	return uringGet(pUt);
+#else
+	return false;
+#endif
+}
+
+/*
+Literature
+- https://man7.org/linux/man-pages/man3/io_uring_prep_multishot_accept.3.html
+- https://man7.org/linux/man-pages/man3/io_uring_prep_recv_multishot.3.html
+- https://man7.org/linux/man-pages/man3/io_uring_buf_ring_add.3.html
+*/
+UringSlot *Uring::acceptStart(int fdLst)
+{
+#if CONFIG_PROC_HAVE_IO_URING
+	return slotCreate(fdLst, true);
+#else
+	(void)fdLst;
+	return NULL;
+#endif
+}
+
+UringSlot *Uring::recvStart(int fd)
+{
+#if CONFIG_PROC_HAVE_IO_URING
+	return slotCreate(fd, false);
+#else
+	(void)fd;
+	return NULL;
+#endif
+}
+
+/*
+ * The slot takes over the socket and closes it after its
+ * last operation completed. Returns true in this case and
+ * the owner must not close the socket itself
+ * - Queued data is dropped, all operations are canceled
+ * - Other threads hand the slot over to the thread of the
+ *   ring. It is released with the next update() there
+ */
+bool Uring::slotRemove(UringSlot *&pSlot)
+{
+#if CONFIG_PROC_HAVE_IO_URING
+	if (!pSlot)
+		return false;
+
+	UringThread *pUt = pSlot->pRing;
+
+	pSlot->removed = true;
+	pSlot->dataRecv.clear();
+	pSlot->idxRecv = 0;
+
+	while (pSlot->fdsAccepted.size())
+	{
+		::close(pSlot->fdsAccepted.front());
+		pSlot->fdsAccepted.pop_front();
+	}
+
+	if (pUt == &uringThread)
+		slotRelease(*pUt, pSlot);
+	else
+	{
+#if CONFIG_PROC_HAVE_DRIVERS
+		Guard lock(pUt->mtxRemoved);
+#endif
+		pUt->slotsRemoved.push_back(pSlot);
+		++pUt->numSlotsRemoved;
+	}
+
+	pSlot = NULL;
+
+	return true;
+#else
+	pSlot = NULL;
+
+	return false;
+#endif
+}
+
+/*
+ * Must be called once per tick by the owner with its lock
+ * held. Like the reactor the first slot which already knows
+ * the latest completions submits the queued entries of this
+ * thread and reaps the completion queue. Entries queued in
+ * this tick are submitted with the next one. No system call
+ * is made while idle, unless completions overflowed
+ * - Slots removed by other threads are released on every
+ *   call. The ring of a thread must therefore be ticked as
+ *   long as slots of it may be removed elsewhere. Without
+ *   slots of its own a thread calls update(NULL)
+ */
+void Uring::update(UringSlot *pSlot)
+{
+#if CONFIG_PROC_HAVE_IO_URING
+	UringThread &ut = uringThread;
+
+	if (ut.fd < 0)
+		return;
+
+	slotsRemovedProcess(ut);
+
+	if (pSlot && (pSlot->removed || pSlot->pRing != &ut))
+		return;
+
+	if (!pSlot || pSlot->idPoll == ut.idPoll)
+	{
+		uringSubmit(ut);
+		uringReap(ut);
+
+		// Kernel moves overflowed completions to the ring on enter only
+		if (*ut.pSqFlags & IORING_SQ_CQ_OVERFLOW)
+		{
+			uringEnter(ut, 0, IORING_ENTER_GETEVENTS);
+			uringReap(ut);
+		}
+
+		++ut.idPoll;
+	}
+
+	if (!pSlot)
+		return;
+
+	pSlot->idPoll = ut.idPoll;
+
+	// Hand over to the owner
+	pSlot->fdsAccepted.insert(pSlot->fdsAccepted.end(),
+				pSlot->fdsReaped.begin(), pSlot->fdsReaped.end());
+	pSlot->fdsReaped.clear();
+
+	if (pSlot->idxRecv == pSlot->dataRecv.size())
+	{
+		pSlot->dataRecv.swap(pSlot->dataReaped);
+		pSlot->idxRecv = 0;
+	}
+	else
+		pSlot->dataRecv.insert(pSlot->dataRecv.end(),
+				pSlot->dataReaped.begin(), pSlot->dataReaped.end());
+	pSlot->dataReaped.clear();
+
+	pSlot->numBytesSend -= pSlot->numBytesSentReaped;
+	pSlot->numBytesSentReaped = 0;
+
+	pSlot->eof = pSlot->eof || pSlot->eofReaped;
+
+	if (!pSlot->err)
+		pSlot->err = pSlot->errReaped;
+
+	// Receiving pauses until the owner caught up
+	bool full = !pSlot->listening &&
+			pSlot->dataRecv.size() - pSlot->idxRecv > CONFIG_PROC_URING_SIZE_RECV_MAX;
+
+	if (full)
+		multishotCancel(ut, pSlot);
+	else
+	if (!pSlot->armed && !pSlot->eof && !pSlot->err)
+		multishotArm(ut, pSlot);
+
+	sendChainSubmit(ut, pSlot);
+#else
+	(void)pSlot;
+#endif
+}
+
+bool Uring::pending(const UringSlot *pSlot)
+{
+	if (!pSlot)
+		return false;
+
+	return pSlot->fdsAccepted.size() ||
+			pSlot->dataRecv.size() > pSlot->idxRecv ||
+			pSlot->eof || pSlot->err;
+}
+
+int Uring::fdAcceptedGet(UringSlot *pSlot)
+{
+	int fd;
+
+	if (!pSlot || !pSlot->fdsAccepted.size())
+		return -1;
+
+	fd = pSlot->fdsAccepted.front();
+	pSlot->fdsAccepted.pop_front();
+
+	return fd;
+}
+
+size_t Uring::dataGet(UringSlot *pSlot, void *pBuf, size_t lenReq)
+{
+	size_t lenAvail;
+
+	if (!pSlot)
+		return 0;
+
+	lenAvail = pSlot->dataRecv.size() - pSlot->idxRecv;
+	if (lenReq > lenAvail)
+		lenReq = lenAvail;
+
+	if (!lenReq)
+		return 0;
+
+	memcpy(pBuf, pSlot->dataRecv.data() + pSlot->idxRecv, lenReq);
+	pSlot->idxRecv += lenReq;
+
+	if (pSlot->idxRecv == pSlot->dataRecv.size())
+	{
+		pSlot->dataRecv.clear();
+		pSlot->idxRecv = 0;
+	}
+
+	return lenReq;
+}
+
+size_t Uring::recvQueueBytes(const UringSlot *pSlot)
+{
+	if (!pSlot)
+		return 0;
+
+	return pSlot->dataRecv.size() - pSlot->idxRecv;
+}
+
+/*
+ * The data is copied and submitted with the next update()
+ */
+ssize_t Uring::send(UringSlot *pSlot, const void *pData, size_t lenReq)
+{
+	if (!pSlot || pSlot->removed || pSlot->err)
+		return -1;
+
+	if (!lenReq)
+		return 0;
+
+	const uint8_t *pStart = (const uint8_t *)pData;
+
+	pSlot->bufsSend.push_back(vector<uint8_t>(pStart, pStart + lenReq));
+	pSlot->numBytesSend += lenReq;
+
+	return (ssize_t)lenReq;
+}
+
+// Queued and in flight
+size_t Uring::sendQueueBytes(const UringSlot *pSlot)
+{
+	if (!pSlot)
+		return 0;
+
+	return pSlot->numBytesSend;
+}
+
+uint32_t Uring::numEntersGet()
+{
+#if CONFIG_PROC_HAVE_IO_URING
+	return uringThread.numEnters;
+#else
+	return 0;
+#endif
+}
+
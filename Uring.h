@@ -0,0 +1,170 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  File created on 19.10.2026
+
+  Copyright (C) 2026, Johannes Natter
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+#include "Processing.h"
+
+/*
+ * Optional io_uring backend for the socket processes. Linux only
+ * - Needs kernel 6.0 or newer for multishot receive
+ * - Selected at build time with CONFIG_PROC_HAVE_IO_URING and
+ *   at run time with Uring::enabledSet(). Otherwise and if the
+ *   setup fails the reactor (epoll) is used
+ */
+#ifndef CONFIG_PROC_HAVE_IO_URING
+#define CONFIG_PROC_HAVE_IO_URING		0
+#endif
+
+#ifndef CONFIG_PROC_URING_NUM_ENTRIES
+#define CONFIG_PROC_URING_NUM_ENTRIES		256
+#endif
+
+#ifndef CONFIG_PROC_URING_NUM_BUFFERS
+#define CONFIG_PROC_URING_NUM_BUFFERS		256
+#endif
+
+#ifndef CONFIG_PROC_URING_SIZE_BUFFER
+#define CONFIG_PROC_URING_SIZE_BUFFER		4096
+#endif
+
+// Receiving pauses while more data is waiting for the owner
+#ifndef CONFIG_PROC_URING_SIZE_RECV_MAX
+#define CONFIG_PROC_URING_SIZE_RECV_MAX		(64 * 1024)
+#endif
+
+struct UringThread;
+
+/*
+ * Socket state kept by the io_uring of the current thread
+ * - Created by Uring. Owners must not delete it but call
+ *   Uring::slotRemove(). The slot then owns the socket
+ * - The slot is freed and the socket closed after its
+ *   last operation completed
+ * - Completions are collected by the thread of the ring and
+ *   handed over to the owner in update(). Owners protect
+ *   their side with the same lock they use for the socket
+ */
+struct UringSlot
+{
+	UringSlot()
+		: fd(-1)
+		, listening(false)
+		, removed(false)
+		, idPoll(0)
+		, fdsAccepted()
+		, dataRecv()
+		, idxRecv(0)
+		, bufsSend()
+		, numBytesSend(0)
+		, eof(false)
+		, err(0)
+		, pRing(NULL)
+		, released(false)
+		, armed(false)
+		, paused(false)
+		, numOps(0)
+		, fdsReaped()
+		, dataReaped()
+		, bufsInFlight()
+		, numBytesSentReaped(0)
+		, eofReaped(false)
+		, errReaped(0)
+	{}
+
+	int fd;
+	bool listening;
+	bool removed;
+	uint32_t idPoll;
+
+	// owner side
+	std::deque<int> fdsAccepted;
+	std::vector<uint8_t> dataRecv;
+	size_t idxRecv;
+	std::deque<std::vector<uint8_t> > bufsSend;
+	size_t numBytesSend;
+	bool eof;
+	int err;
+
+	// ring side
+	UringThread *pRing;
+	bool released;
+	bool armed;
+	bool paused;
+	uint32_t numOps;
+	std::deque<int> fdsReaped;
+	std::vector<uint8_t> dataReaped;
+	std::deque<std::vector<uint8_t> > bufsInFlight;
+	size_t numBytesSentReaped;
+	bool eofReaped;
+	int errReaped;
+};
+
+class Uring
+{
+
+public:
+
+	static void enabledSet(bool enabled);
+	static bool enabled();
+
+	static UringSlot *acceptStart(int fdLst);
+	static UringSlot *recvStart(int fd);
+	static bool slotRemove(UringSlot *&pSlot);
+
+	static void update(UringSlot *pSlot);
+	static bool pending(const UringSlot *pSlot);
+
+	static int fdAcceptedGet(UringSlot *pSlot);
+	static size_t dataGet(UringSlot *pSlot, void *pBuf, size_t lenReq);
+	static size_t recvQueueBytes(const UringSlot *pSlot);
+	static ssize_t send(UringSlot *pSlot, const void *pData, size_t lenReq);
+	static size_t sendQueueBytes(const UringSlot *pSlot);
+
+	static uint32_t numEntersGet();
+
+private:
+
+	Uring() {}
+	Uring(const Uring &) {}
+	Uring &operator=(const Uring &)
+	{
+		return *this;
+	}
+
+};
+
+#endif
+
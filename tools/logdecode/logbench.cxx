@@ -0,0 +1,91 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  Copyright (C) 2026, Johannes Natter
+*/
+
+/*
+ * Compares the throughput of the text path of entryLogCreate()
+ * with the binary mode and with disabled entries
+ *
+ * usage: logbench [number of entries] [binary output file]
+ */
+
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Processing.h"
+
+using namespace std;
+using namespace chrono;
+
+static FILE *pFileBinary = NULL;
+
+static void binaryWrite(const void *pData, size_t len)
+{
+	fwrite(pData, 1, len, pFileBinary);
+}
+
+static double entriesCreate(size_t numEntries)
+{
+	steady_clock::time_point tStart = steady_clock::now();
+
+	for (size_t i = 0; i < numEntries; ++i)
+	{
+		genericLog(3, NULL, 0, "entry %zu of %zu, state %s, ratio %.3f",
+				i, numEntries, "main", double(i) / numEntries);
+	}
+
+	nanoseconds dur = steady_clock::now() - tStart;
+
+	return double(dur.count()) / numEntries;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t numEntries = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+	const char *pFileNameBinary = argc > 2 ? argv[2] : "/dev/null";
+
+	if (!numEntries)
+		numEntries = 1;
+
+	// Measure formatting, not the terminal
+	if (!freopen("/dev/null", "w", stdout))
+	{
+		cerr << "could not redirect stdout" << endl;
+		return 1;
+	}
+
+	pFileBinary = fopen(pFileNameBinary, "wb");
+	if (!pFileBinary)
+	{
+		cerr << "could not open " << pFileNameBinary << endl;
+		return 1;
+	}
+
+	levelLogSet(3);
+	double nsText = entriesCreate(numEntries);
+
+	logBinaryWriteSet(binaryWrite);
+	double nsBinary = entriesCreate(numEntries);
+	logBinaryWriteSet(NULL);
+
+	levelLogSet(2);
+	double nsDisabled = entriesCreate(numEntries);
+
+	fclose(pFileBinary);
+
+	cerr << "entries     " << numEntries << endl;
+	cerr << "text        " << nsText << " ns/entry" << endl;
+	cerr << "binary      " << nsBinary << " ns/entry" << endl;
+	cerr << "disabled    " << nsDisabled << " ns/entry" << endl;
+
+	return 0;
+}
+
@@ -0,0 +1,453 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  Copyright (C) 2026, Johannes Natter
+*/
+
+/*
+ * Decodes binary log streams created with logBinaryWriteSet()
+ * and prints them in the text layout of entryLogCreate()
+ *
+ * Records: u8 type, u16 len, payload. Little endian
+ *   0xB0 .. Header:  "PLOG", u8 version
+ *   0xB1 .. String:  u32 ID, characters
+ *   0xB2 .. Entry:   u64 time [us] since epoch, u8 severity, u8 flags,
+ *                    [i8 width counter time, u32 counter time],
+ *                    u64 process, u32 ID format, u32 ID file,
+ *                    u32 ID function, u32 line, i16 code, arguments
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <map>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <cinttypes>
+#include <ctime>
+
+using namespace std;
+
+const size_t cLogEntryBufferSize = 512;
+const int cDiffSecMax = 9;
+const int cDiffMsMax = 999;
+const int cLenPrefix2 = 73;
+
+struct Reader
+{
+	const uint8_t *pData;
+	const uint8_t *pEnd;
+
+	bool get(uint64_t &val, size_t len)
+	{
+		if ((size_t)(pEnd - pData) < len)
+			return false;
+
+		val = 0;
+		for (size_t i = 0; i < len; ++i)
+			val |= (uint64_t)*pData++ << (8 * i);
+
+		return true;
+	}
+
+	bool bytesGet(string &str, size_t len)
+	{
+		if ((size_t)(pEnd - pData) < len)
+			return false;
+
+		str.assign((const char *)pData, len);
+		pData += len;
+
+		return true;
+	}
+};
+
+static map<uint32_t, string> strings;
+static uint64_t tOldUs = 0;
+static bool colored = false;
+
+static const char *severityToStr(int severity)
+{
+	switch (severity)
+	{
+	case 1: return "ERR";
+	case 2: return "WRN";
+	case 3: return "INF";
+	case 4: return "DBG";
+	case 5: return "COR";
+	default: break;
+	}
+	return "INV";
+}
+
+static const char *stringGet(uint32_t id)
+{
+	map<uint32_t, string>::iterator iter = strings.find(id);
+
+	if (iter == strings.end())
+		return "<unknown>";
+
+	return iter->second.c_str();
+}
+
+static void strAppend(string &str, const char *pFmt, ...)
+{
+	char buf[cLogEntryBufferSize];
+	va_list args;
+
+	va_start(args, pFmt);
+	vsnprintf(buf, sizeof(buf), pFmt, args);
+	va_end(args);
+
+	str += buf;
+}
+
+static void prefixCreate(string &str, uint64_t tUs, int severity,
+				bool hasCntTime, int widthCntTime, uint32_t cntTime,
+				uint64_t pProc, const char *filename, const char *function,
+				uint32_t line)
+{
+	// Same layout and quirks as entryPrefixCreate() in Log.cpp
+	int64_t tDiff = ((int64_t)tUs - (int64_t)tOldUs) / 1000;
+	int tDiffSec = int(tDiff / 1000);
+	int tDiffMs = int(tDiff % 1000);
+	bool diffMaxed = false;
+
+	if (tDiffSec > cDiffSecMax)
+	{
+		tDiffSec = cDiffSecMax;
+		tDiffMs = cDiffMsMax;
+
+		diffMaxed = true;
+	}
+
+	time_t tTt = (time_t)(tUs / 1000000);
+	char timeBuf[32];
+	tm tTm {};
+
+	localtime_r(&tTt, &tTm);
+	strftime(timeBuf, sizeof(timeBuf), "%Y-%m-%d", &tTm);
+
+	uint64_t tDayMs = (tUs / 1000) % (24ULL * 3600 * 1000);
+
+	strAppend(str, "%s  %02d:%02d:%02d.%03d %c%d.%03d  ",
+				timeBuf,
+				int(tDayMs / 3600000), int(tDayMs / 60000 % 60),
+				int(tDayMs / 1000 % 60), int(tDayMs % 1000),
+				diffMaxed ? '>' : '+', tDiffSec, tDiffMs);
+
+	if (hasCntTime)
+		strAppend(str, "%*" PRIu32 "  ", widthCntTime, cntTime);
+
+	string segment;
+
+	if (pProc)
+	{
+		strAppend(segment, "%s  %-20s  %p %s:%-4d  ",
+					severityToStr(severity), function,
+					(void *)(uintptr_t)pProc, filename, (int)line);
+	}
+	else
+	{
+		strAppend(segment, "%s  %-20s  %s:%-4d  ",
+					severityToStr(severity), function,
+					filename, (int)line);
+	}
+
+	if (segment.size() < (size_t)cLenPrefix2)
+		segment.append(cLenPrefix2 - segment.size(), ' ');
+
+	str += segment;
+}
+
+/*
+ * Must parse the format string exactly like argsBinaryPut() in Log.cpp
+ */
+static void msgCreate(string &str, const char *pFmt, Reader &rd)
+{
+	string spec;
+	uint64_t val;
+
+	while (*pFmt)
+	{
+		if (*pFmt != '%')
+		{
+			str += *pFmt++;
+			continue;
+		}
+
+		++pFmt;
+
+		if (*pFmt == '%')
+		{
+			str += '%';
+			++pFmt;
+			continue;
+		}
+
+		spec = "%";
+
+		// flags
+		while (*pFmt && strchr("-+ #0'", *pFmt))
+			spec += *pFmt++;
+
+		// width
+		if (*pFmt == '*')
+		{
+			if (!rd.get(val, 8))
+				return;
+			spec += to_string((int64_t)val);
+			++pFmt;
+		}
+
+		while (*pFmt >= '0' && *pFmt <= '9')
+			spec += *pFmt++;
+
+		// precision
+		if (*pFmt == '.')
+		{
+			++pFmt;
+
+			if (*pFmt == '*')
+			{
+				if (!rd.get(val, 8))
+					return;
+				if ((int64_t)val >= 0)
+					spec += "." + to_string((int64_t)val);
+				++pFmt;
+			}
+			else
+				spec += '.';
+
+			while (*pFmt >= '0' && *pFmt <= '9')
+				spec += *pFmt++;
+		}
+
+		// length modifier. Values are stored with 64 bits
+		while (*pFmt && strchr("hlqjztL", *pFmt))
+			++pFmt;
+
+		switch (*pFmt)
+		{
+		case 'd':
+		case 'i':
+			if (!rd.get(val, 8))
+				return;
+			strAppend(str, (spec + "lld").c_str(), (long long)val);
+			break;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+			if (!rd.get(val, 8))
+				return;
+			strAppend(str, (spec + "ll" + *pFmt).c_str(), (unsigned long long)val);
+			break;
+		case 'c':
+			if (!rd.get(val, 8))
+				return;
+			strAppend(str, (spec + "c").c_str(), (int)val);
+			break;
+		case 'e':
+		case 'E':
+		case 'f':
+		case 'F':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+		{
+			double valDbl;
+
+			if (!rd.get(val, 8))
+				return;
+
+			memcpy(&valDbl, &val, sizeof(valDbl));
+			strAppend(str, (spec + *pFmt).c_str(), valDbl);
+			break;
+		}
+		case 's':
+		{
+			string arg;
+
+			if (!rd.get(val, 2) || !rd.bytesGet(arg, val))
+				return;
+
+			strAppend(str, (spec + "s").c_str(), arg.c_str());
+			break;
+		}
+		case 'p':
+			if (!rd.get(val, 8))
+				return;
+			strAppend(str, (spec + "p").c_str(), (void *)(uintptr_t)val);
+			break;
+		case 'n':
+			break;
+		default:
+			// Same as in Log.cpp: Arguments unknown from here
+			str += spec;
+			str += pFmt;
+			return;
+		}
+
+		if (*pFmt)
+			++pFmt;
+	}
+}
+
+static void entryPrint(int severity, const string &str)
+{
+	FILE *pStream = severity < 3 ? stderr : stdout;
+
+	if (!colored)
+	{
+		fprintf(pStream, "%s\n", str.c_str());
+		return;
+	}
+
+	const char *pColor = "\033[39m";
+
+	if (severity == 1)
+		pColor = "\033[0;31m";
+	else
+	if (severity == 2)
+		pColor = "\033[0;33m";
+	else
+	if (severity >= 4)
+		pColor = "\033[0;36m";
+
+	fprintf(pStream, "%s%s\033[39m\n", pColor, str.c_str());
+}
+
+static bool entryDecode(Reader &rd)
+{
+	uint64_t tUs, severity, flags, pProc;
+	uint64_t idFmt, idFile, idFunc, line, code;
+	uint64_t widthCntTime = 0, cntTime = 0;
+
+	if (!rd.get(tUs, 8) || !rd.get(severity, 1) || !rd.get(flags, 1))
+		return false;
+
+	if ((flags & 1) && (!rd.get(widthCntTime, 1) || !rd.get(cntTime, 4)))
+		return false;
+
+	if (!rd.get(pProc, 8) ||
+			!rd.get(idFmt, 4) || !rd.get(idFile, 4) || !rd.get(idFunc, 4) ||
+			!rd.get(line, 4) || !rd.get(code, 2))
+		return false;
+
+	string str;
+
+	prefixCreate(str, tUs, (int)severity,
+			flags & 1, (int8_t)widthCntTime, (uint32_t)cntTime,
+			pProc, stringGet(idFile), stringGet(idFunc), (uint32_t)line);
+
+	msgCreate(str, stringGet(idFmt), rd);
+
+	if (str.size() > cLogEntryBufferSize - 1)
+		str.resize(cLogEntryBufferSize - 1);
+
+	tOldUs = tUs;
+	entryPrint((int)severity, str);
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *pFileName = NULL;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-c"))
+		{
+			colored = true;
+			continue;
+		}
+
+		if (pFileName)
+		{
+			cerr << "usage: logdecode [-c] [input file]" << endl;
+			return 1;
+		}
+
+		pFileName = argv[i];
+	}
+
+	ifstream fIn;
+	istream *pIn = &cin;
+
+	if (pFileName)
+	{
+		fIn.open(pFileName, ios::binary);
+		if (!fIn)
+		{
+			cerr << "could not open " << pFileName << endl;
+			return 1;
+		}
+
+		pIn = &fIn;
+	}
+
+	uint8_t hdr[3];
+	string payload;
+	uint64_t val;
+	size_t len;
+
+	while (pIn->read((char *)hdr, sizeof(hdr)))
+	{
+		len = hdr[1] | (hdr[2] << 8);
+
+		payload.resize(len);
+		if (len && !pIn->read(&payload[0], len))
+		{
+			cerr << "stream truncated" << endl;
+			return 1;
+		}
+
+		Reader rd = { (const uint8_t *)payload.data(),
+					(const uint8_t *)payload.data() + payload.size() };
+
+		if (hdr[0] == 0xB0)
+		{
+			string magic;
+
+			if (!rd.bytesGet(magic, 4) || magic != "PLOG" ||
+					!rd.get(val, 1) || val != 1)
+			{
+				cerr << "unsupported stream" << endl;
+				return 1;
+			}
+
+			strings.clear();
+			tOldUs = 0;
+			continue;
+		}
+
+		if (hdr[0] == 0xB1)
+		{
+			if (!rd.get(val, 4))
+				continue;
+
+			rd.bytesGet(strings[(uint32_t)val], rd.pEnd - rd.pData);
+			continue;
+		}
+
+		if (hdr[0] == 0xB2)
+		{
+			if (!entryDecode(rd))
+				cerr << "invalid entry record" << endl;
+			continue;
+		}
+
+		// Unknown records are skipped
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,245 @@
+/*
+  This file is part of the DSP-Crowd project
+  https://www.dsp-crowd.com
+
+  Author(s):
+      - Johannes Natter, office@dsp-crowd.com
+
+  Copyright (C) 2026, Johannes Natter
+*/
+
+/*
+ * Compares send() with sendZeroCopy() and fileSend() for
+ * large payloads. A sink thread reads and discards the
+ * data on a loopback connection
+ *
+ * On loopback the kernel always copies MSG_ZEROCOPY data.
+ * Use a real interface for meaningful zero-copy numbers
+ *
+ * usage: sendbench [payload size MB] [number of payloads] [port]
+ */
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "TcpListening.h"
+#include "TcpTransfering.h"
+
+using namespace std;
+using namespace chrono;
+
+enum SendMode
+{
+	ModeCopy = 0,
+	ModeZeroCopy,
+	ModeFile,
+	ModeEnd,
+};
+
+static const char *modeToStr(int mode)
+{
+	switch (mode)
+	{
+	case ModeCopy: return "send()";
+	case ModeZeroCopy: return "sendZeroCopy()";
+	case ModeFile: return "fileSend()";
+	default: break;
+	}
+	return "<unknown>";
+}
+
+static size_t sizePayload = 1 << 20;
+static size_t numPayloads = 256;
+static uint16_t port = 4090;
+
+static atomic<bool> sinkDone(false);
+
+static void sinkRun()
+{
+	struct sockaddr_in addr;
+	vector<char> buf(1 << 20);
+	size_t numTotal = sizePayload * numPayloads;
+	size_t numRead = 0;
+	ssize_t res;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	while (connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+		this_thread::sleep_for(milliseconds(10));
+
+	while (numRead < numTotal)
+	{
+		res = read(fd, &buf[0], buf.size());
+		if (res <= 0)
+			break;
+
+		numRead += res;
+	}
+
+	close(fd);
+	sinkDone = true;
+}
+
+class SendBenching : public Processing
+{
+
+public:
+
+	SendBenching()
+		: Processing("SendBenching")
+		, mMode(ModeCopy)
+		, mpLst(NULL)
+		, mpTrans(NULL)
+		, mNumQueued(0)
+		, mFdFile(-1)
+		, mSink()
+		, mStart()
+	{}
+
+private:
+
+	Success process()
+	{
+		SOCKET fd;
+
+		if (!mpLst)
+		{
+			mpLst = TcpListening::create();
+			mpLst->portSet(port, true);
+			start(mpLst);
+
+			fileCreate();
+			runStart();
+		}
+
+		if (!mpTrans)
+		{
+			fd = mpLst->nextPeerFd();
+			if (fd == INVALID_SOCKET)
+				return Pending;
+
+			mpTrans = TcpTransfering::create(fd);
+			start(mpTrans);
+		}
+
+		while (mNumQueued < numPayloads && payloadSend() > 0)
+			++mNumQueued;
+
+		if (!sinkDone)
+			return Pending;
+
+		resultPrint();
+
+		mSink.join();
+		repel(mpTrans);
+		mpTrans = NULL;
+
+		++mMode;
+		if (mMode == ModeEnd)
+		{
+			close(mFdFile);
+			return Positive;
+		}
+
+		runStart();
+
+		return Pending;
+	}
+
+	ssize_t payloadSend()
+	{
+		if (mMode == ModeCopy)
+			return mpTrans->send(&mPayload[0], sizePayload);
+
+		if (mMode == ModeZeroCopy)
+		{
+			// Buffer is taken over
+			if (mPayloadZc.size() != sizePayload)
+				mPayloadZc = mPayload;
+
+			return mpTrans->sendZeroCopy(mPayloadZc);
+		}
+
+		return mpTrans->fileSend(mFdFile, 0, sizePayload);
+	}
+
+	void runStart()
+	{
+		mNumQueued = 0;
+		sinkDone = false;
+		mStart = steady_clock::now();
+		mSink = thread(sinkRun);
+	}
+
+	void fileCreate()
+	{
+		char nameFile[] = "/tmp/sendbenchXXXXXX";
+
+		mPayload.assign(sizePayload, 'x');
+
+		mFdFile = mkstemp(nameFile);
+		unlink(nameFile);
+
+		if (write(mFdFile, &mPayload[0], sizePayload) != (ssize_t)sizePayload)
+			cerr << "could not create payload file" << endl;
+	}
+
+	void resultPrint()
+	{
+		double durSec = duration<double>(steady_clock::now() - mStart).count();
+		double sizeMb = (double)sizePayload * numPayloads / (1 << 20);
+
+		printf("%-16s  %8.1f MB  %8.3f s  %8.1f MB/s\n",
+				modeToStr(mMode), sizeMb, durSec, sizeMb / durSec);
+	}
+
+	int mMode;
+	TcpListening *mpLst;
+	TcpTransfering *mpTrans;
+	size_t mNumQueued;
+	int mFdFile;
+	VecByte mPayload;
+	VecByte mPayloadZc;
+	thread mSink;
+	steady_clock::time_point mStart;
+};
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1)
+		sizePayload = (size_t)strtoul(argv[1], NULL, 10) << 20;
+
+	if (argc > 2)
+		numPayloads = strtoul(argv[2], NULL, 10);
+
+	if (argc > 3)
+		port = (uint16_t)strtoul(argv[3], NULL, 10);
+
+	if (!sizePayload || !numPayloads)
+	{
+		cerr << "usage: sendbench [payload size MB] [number of payloads] [port]" << endl;
+		return 1;
+	}
+
+	SendBenching *pApp = new SendBenching;
+
+	while (pApp->success() == Pending)
+		pApp->treeTick();
+
+	Processing::destroy(pApp);
+
+	return 0;
+}